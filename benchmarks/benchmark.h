@@ -0,0 +1,58 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Shared scaffolding for the benchmark drivers: an allocation counter, the
+// peak resident set size, and a uniform machine-readable report line. Each
+// line is a space-separated list of key=value pairs, one per configuration,
+// so per-commit metrics can be diffed or fed into a plotting script without
+// any parsing beyond splitting on whitespace.
+//
+// Every benchmark is a single translation unit, so the replacements of
+// operator new and operator delete are defined right in this header.
+
+#ifndef BENCHMARKS_BENCHMARK_H_
+#define BENCHMARKS_BENCHMARK_H_
+
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <new>
+#include <string>
+
+namespace benchmark {
+
+extern std::size_t n_allocs;
+
+// The peak resident set size of the process so far. Linux reports kibibytes;
+// note that getrusage() on other systems may use different units.
+inline std::size_t peak_rss_kib() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return static_cast<std::size_t>(ru.ru_maxrss);
+}
+
+inline void Report(const char* name, const std::string& params, std::size_t ops, double secs) {
+  std::printf("bench=%s %s ops=%zu secs=%.6f ops_per_sec=%.1f allocs=%zu peak_rss_kib=%zu\n",
+              name, params.c_str(), ops, secs, secs > 0.0 ? ops / secs : 0.0, n_allocs, peak_rss_kib());
+  std::fflush(stdout);
+}
+
+}  // namespace benchmark
+
+std::size_t benchmark::n_allocs = 0;
+
+void* operator new(std::size_t n) {
+  ++benchmark::n_allocs;
+  void* p = std::malloc(n);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+#endif  // BENCHMARKS_BENCHMARK_H_
@@ -0,0 +1,57 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Plays full minesweeper games through the example agent for several grid
+// sizes and belief levels. The ops and secs columns count the IsMine()
+// queries and the time spent inside them (measured by the knowledge base's
+// own timer), so ops_per_sec is the Solver::Entails()/Determines() query
+// throughput rather than the cost of the surrounding game bookkeeping.
+
+#include <cstddef>
+
+#include <sstream>
+#include <string>
+
+#include "benchmark.h"
+
+#include "minesweeper/agent.h"
+#include "minesweeper/game.h"
+#include "minesweeper/kb.h"
+
+namespace {
+
+struct SilentLogger {
+  void explored(Point, int) const {}
+  void flagged(Point, int) const {}
+};
+
+struct Config {
+  std::size_t width;
+  std::size_t height;
+  std::size_t n_mines;
+};
+
+}  // namespace
+
+int main() {
+  constexpr Config configs[] = {{6, 6, 6}, {8, 8, 10}, {10, 10, 16}};
+  constexpr std::size_t seed = 0;
+  for (const Config& c : configs) {
+    for (std::size_t k = 0; k <= 2; ++k) {
+      Game g(c.width, c.height, c.n_mines, seed);
+      KnowledgeBase kb(&g, k);
+      Agent<SilentLogger> agent(&g, &kb);
+      benchmark::n_allocs = 0;
+      std::size_t turns = 0;
+      do {
+        agent.Explore();
+        ++turns;
+      } while (!g.hit_mine() && !g.all_explored());
+      std::stringstream params;
+      params << "width=" << c.width << " height=" << c.height << " mines=" << c.n_mines
+             << " k=" << k << " turns=" << turns << " won=" << !g.hit_mine();
+      benchmark::Report("minesweeper", params.str(), kb.timer().rounds(), kb.timer().duration());
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Solves sudokus of increasing difficulty through the example agent for
+// several belief levels. As in the minesweeper benchmark, ops and secs count
+// the Val() queries and the time spent inside them, so ops_per_sec reflects
+// the Solver::Entails()/Determines() query throughput.
+
+#include <cstddef>
+
+#include <sstream>
+#include <string>
+
+#include "benchmark.h"
+
+#include "sudoku/agent.h"
+#include "sudoku/game.h"
+#include "sudoku/kb.h"
+
+namespace {
+
+// The first configurations from sudokus.txt.
+constexpr const char* kSudokus[] = {
+  "5.1.8...4.42.6.718..742..5..159...6.32..1.47..7.3.41.......834729..47...7....5..9",  // NYTimes grade easy
+  "...7.2....86...542291.8.6...1.2748..46..5.......81..93..7543..61.9....746.4..725.",  // NYTimes grade easy
+};
+
+}  // namespace
+
+int main() {
+  for (std::size_t i = 0; i < sizeof(kSudokus) / sizeof(kSudokus[0]); ++i) {
+    for (int k = 0; k <= 1; ++k) {
+      Game g(kSudokus[i]);
+      KnowledgeBase kb(&g, k);
+      KnowledgeBaseAgent agent(&g, &kb);
+      benchmark::n_allocs = 0;
+      std::size_t turns = 0;
+      limbo::internal::Maybe<Agent::Result> r;
+      do {
+        r = agent.Explore();
+        ++turns;
+      } while (!g.solved() && g.legal() && r);
+      std::stringstream params;
+      params << "sudoku=" << i << " k=" << k << " turns=" << turns << " solved=" << g.solved();
+      benchmark::Report("sudoku", params.str(), kb.timer().rounds(), kb.timer().duration());
+    }
+  }
+  return 0;
+}
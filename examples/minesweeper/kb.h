@@ -125,10 +125,15 @@ class KnowledgeBase {
 #else
     limbo::Formula::Ref yes_mine = limbo::Formula::Factory::Atomic(limbo::Clause{MineLit(true, p)});
     limbo::Formula::Ref no_mine = limbo::Formula::Factory::Atomic(limbo::Clause{MineLit(false, p)});
-    if (solver().Entails(k, *yes_mine, limbo::Solver::kNoConsistencyGuarantee)) {
+    // Both queries mention the same term, so one grounding pass serves both
+    // and the answers are those of the individual Entails() calls.
+    const limbo::Formula* queries[] = {yes_mine.get(), no_mine.get()};
+    const std::vector<bool> entailed =
+        solver().EntailsAll(k, queries, queries + 2, limbo::Solver::kNoConsistencyGuarantee);
+    if (entailed[0]) {
       assert(g_->mine(p));
       r = limbo::internal::Just(true);
-    } else if (solver().Entails(k, *no_mine, limbo::Solver::kNoConsistencyGuarantee)) {
+    } else if (entailed[1]) {
       assert(!g_->mine(p));
       r = limbo::internal::Just(false);
     }
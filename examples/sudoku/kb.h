@@ -99,6 +99,7 @@ class KnowledgeBase {
              limbo::Formula::Ref f = limbo::Formula::Factory::Atomic(limbo::Clause{limbo::Literal::Eq(val(p), n(i))});
              return solver().Entails(k, *f) == (r && r.val == n(i));
            }));
+    t_.stop();
     if (r) {
       assert(!r.val.null());
       for (std::size_t i = 1; i <= 9; ++i) {
@@ -107,7 +108,6 @@ class KnowledgeBase {
         }
       }
     }
-    t_.stop();
     return limbo::internal::Nothing;
   }
 
@@ -15,6 +15,7 @@
 #include <limbo/term.h>
 
 #include <limbo/internal/iter.h>
+#include <limbo/internal/stats.h>
 
 namespace limbo {
 
@@ -34,12 +35,14 @@ class ActionTheory {
       return false;
     }
     defs_.push_back(Def(a, alpha.Clone()));
+    regression_cache_.clear();
     return true;
   }
 
   void AddSenseFunction(Symbol::Sort sort, Symbol fun) {
     assert(fun.arity() == 1);
     sense_funs_.insert(sort, fun);
+    regression_cache_.clear();
   }
 
   bool Add(const Term t, Literal a, const Formula& alpha) {
@@ -50,6 +53,7 @@ class ActionTheory {
     assert(alpha.objective());
     assert(!alpha.dynamic());
     ssas_.push_back(SSA(t, a, alpha.Clone()));
+    regression_cache_.clear();
     return true;
   }
 
@@ -57,6 +61,8 @@ class ActionTheory {
 
   Formula::Ref Rewrite(const Formula& alpha) { return Rewrite({}, alpha); }
 
+  const internal::Stats& stats() const { return internal::Stats::Local(); }
+
  private:
   struct Def {
     Def(Literal a, Formula::Ref psi) : a(a), psi(std::move(psi)) {}
@@ -71,12 +77,20 @@ class ActionTheory {
     Formula::Ref psi;
   };
 
+  struct RegressionCacheEntry {
+    RegressionCacheEntry(Term::Vector z, Formula::Ref alpha, Formula::Ref reg)
+        : z(std::move(z)), alpha(std::move(alpha)), reg(std::move(reg)) {}
+    Term::Vector z;
+    Formula::Ref alpha;
+    Formula::Ref reg;
+  };
+
   typedef internal::IntMultiMap<Symbol::Sort, Symbol> SenseFunctionMap;
   typedef std::vector<internal::Maybe<Symbol>> LongSymbol;
 
   struct HashLongSymbol {
-    internal::hash32_t operator()(const LongSymbol& symbols) const {
-      internal::hash32_t h = 0;
+    internal::hash64_t operator()(const LongSymbol& symbols) const {
+      internal::hash64_t h = 0;
       for (internal::Maybe<Symbol> ms : symbols) {
         h ^= ms ? ms.val.hash() : 0;
       }
@@ -191,7 +205,37 @@ class ActionTheory {
                                       std::move(t_conse)))));
   }
 
+  // Memoizing front-end of the regression rewriting. Projection queries
+  // regress the same successor-state axioms under the same action sequences
+  // over and over, so every (z, alpha) pair is looked up before RegressRec()
+  // recurses. The cache key combines the formulas' structural hashes with the
+  // action sequence, and collisions are resolved by comparing both. Adding a
+  // definition, SSA or sense function invalidates the cache.
   Formula::Ref Regress(const Term::Vector& z, const Formula& alpha) const {
+    const internal::hash64_t h = RegressionCacheKey(z, alpha);
+    const auto r = regression_cache_.equal_range(h);
+    for (auto it = r.first; it != r.second; ++it) {
+      const RegressionCacheEntry& e = it->second;
+      if (e.z == z && *e.alpha == alpha) {
+        LIMBO_STATS_DO(++internal::Stats::Local().regression_cache_hits);
+        return e.reg->Clone();
+      }
+    }
+    LIMBO_STATS_DO(++internal::Stats::Local().regression_cache_misses);
+    Formula::Ref reg = RegressRec(z, alpha);
+    regression_cache_.emplace(h, RegressionCacheEntry(z, alpha.Clone(), reg->Clone()));
+    return reg;
+  }
+
+  static internal::hash64_t RegressionCacheKey(const Term::Vector& z, const Formula& alpha) {
+    internal::hash64_t h = alpha.hash();
+    for (const Term t : z) {
+      h = internal::splitmix64_hash(h ^ t.hash());
+    }
+    return h;
+  }
+
+  Formula::Ref RegressRec(const Term::Vector& z, const Formula& alpha) const {
     switch (alpha.type()) {
       case Formula::kAtomic: {
         const Clause& c = alpha.as_atomic().arg();
@@ -362,6 +406,8 @@ class ActionTheory {
 
   std::unordered_map<LongSymbol, Symbol, HashLongSymbol> merged_;
   std::unordered_map<Symbol, LongSymbol> merged_reverse_;
+
+  mutable std::unordered_multimap<internal::hash64_t, RegressionCacheEntry> regression_cache_;
 };
 
 }  // namespace limbo
@@ -20,6 +20,12 @@
 // storing these values in Bloom filters, we can (hopefully often) detect early
 // that unit propagation or subsumption won't work early (in a sound but
 // incomplete way).
+//
+// Literals beyond the inline array are stored in an overflow block. These
+// blocks are carved from a thread-local free-list pool instead of the heap:
+// grounding and copying wide clauses is frequent enough that the per-clause
+// allocation shows up in profiles. Freed blocks go back to the pool and are
+// reused by later allocations of the same capacity.
 
 #ifndef LIMBO_CLAUSE_H_
 #define LIMBO_CLAUSE_H_
@@ -30,7 +36,6 @@
 #include <algorithm>
 #include <functional>
 #include <memory>
-#include <unordered_set>
 #include <utility>
 
 #include <limbo/literal.h>
@@ -39,6 +44,8 @@
 #include <limbo/internal/ints.h>
 #include <limbo/internal/iter.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/memory.h>
+#include <limbo/internal/stats.h>
 #include <limbo/internal/traits.h>
 
 namespace limbo {
@@ -54,9 +61,7 @@ class Clause {
 
   explicit Clause(const Literal a) : size_(!a.unsatisfiable() ? 1 : 0) {
     lits1_[0] = a;
-#ifdef BLOOM
     InitBloom();
-#endif
   }
 
   Clause(std::initializer_list<Literal> lits) : Clause(lits.size(), lits.begin(), lits.end()) {}
@@ -74,9 +79,7 @@ class Clause {
       lits2_[i++] = *it++;
     }
     Normalize();
-#ifdef BLOOM
     InitBloom();
-#endif
   }
 
   Clause(const Clause& c) : Clause(c.size_) {
@@ -84,26 +87,22 @@ class Clause {
     if (size2() > 0) {
       std::memcpy(lits2_.get(), c.lits2_.get(), size2() * sizeof(Literal));
     }
-#ifdef BLOOM
     lhs_bloom_ = c.lhs_bloom_;
-#endif
     assert(!any([](Literal a) { return a.unsatisfiable(); }));
     assert(*this == c);
   }
 
   Clause& operator=(const Clause& c) {
-    const size_t old_size = c.size_;
+    const size_t old_size = size_;
     size_ = c.size_;
     std::memcpy(lits1_, c.lits1_, size1() * sizeof(Literal));
     if (size_ > kArraySize) {
       if (size_ > old_size) {
-        lits2_ = std::unique_ptr<Literal[]>(new Literal[size2()]);
+        lits2_ = Lits(Pool::Allocate(size2()));
       }
       std::memcpy(lits2_.get(), c.lits2_.get(), size2() * sizeof(Literal));
     }
-#ifdef BLOOM
     lhs_bloom_ = c.lhs_bloom_;
-#endif
     assert(!any([](Literal a) { return a.unsatisfiable(); }));
     return *this;
   }
@@ -113,16 +112,14 @@ class Clause {
 
   bool operator==(const Clause& c) const {
     return size() == c.size() &&
-#ifdef BLOOM
            lhs_bloom_ == c.lhs_bloom_ &&
-#endif
            std::memcmp(lits1_, c.lits1_, size1() * sizeof(Literal)) == 0 &&
            (size2() == 0 || std::memcmp(lits2_.get(), c.lits2_.get(), size2() * sizeof(Literal)) == 0);
   }
   bool operator!=(const Clause& c) const { return !(*this == c); }
 
-  internal::hash32_t hash() const {
-    internal::hash32_t h = 0;
+  internal::hash64_t hash() const {
+    internal::hash64_t h = 0;
     for (size_t i = 0; i < size(); ++i) {
       h ^= (*this)[i].hash();
     }
@@ -167,15 +164,12 @@ class Clause {
   static bool Subsumes(const Literal a, const Clause c) {
     assert(a.primitive());
     assert(c.primitive());
-#ifdef BLOOM
+    LIMBO_STATS_DO(++internal::Stats::Local().subsumption_tests);
     if (!c.lhs_bloom_.PossiblyContains(a.lhs())) {
+      LIMBO_STATS_DO(++internal::Stats::Local().bloom_rejections);
       return false;
     }
-#endif
-    size_t i = 0;
-    for (; i < c.size() && a.lhs() > c[i].lhs(); ++i) {
-    }
-    for (; i < c.size() && a.lhs() == c[i].lhs(); ++i) {
+    for (size_t i = c.FindLhs(0, a.lhs()); i < c.size() && a.lhs() == c[i].lhs(); ++i) {
       if (a.Subsumes(c[i])) {
         return true;
       }
@@ -186,14 +180,12 @@ class Clause {
   static bool Subsumes(const Literal a, const Literal b, const Clause c) {
     assert(a < b);
     assert(c.primitive());
-#ifdef BLOOM
+    LIMBO_STATS_DO(++internal::Stats::Local().subsumption_tests);
     if (!c.lhs_bloom_.PossiblyContains(a.lhs()) || !c.lhs_bloom_.PossiblyContains(b.lhs())) {
+      LIMBO_STATS_DO(++internal::Stats::Local().bloom_rejections);
       return false;
     }
-#endif
-    size_t i = 0;
-    for (; i < c.size() && a.lhs() > c[i].lhs(); ++i) {
-    }
+    size_t i = c.FindLhs(0, a.lhs());
     for (; i < c.size() && a.lhs() == c[i].lhs(); ++i) {
       if (a.Subsumes(c[i])) {
         goto next;
@@ -201,9 +193,7 @@ class Clause {
     }
     return false;
 next:
-    for (; i < c.size() && b.lhs() > c[i].lhs(); ++i) {
-    }
-    for (; i < c.size() && b.lhs() == c[i].lhs(); ++i) {
+    for (i = c.FindLhs(i, b.lhs()); i < c.size() && b.lhs() == c[i].lhs(); ++i) {
       if (b.Subsumes(c[i])) {
         return true;
       }
@@ -214,16 +204,14 @@ next:
   static bool Subsumes(const Clause& c, const Clause& d) {
     assert(c.primitive());
     assert(d.primitive());
-#ifdef BLOOM
+    LIMBO_STATS_DO(++internal::Stats::Local().subsumption_tests);
     if (!c.lhs_bloom_.PossiblySubsetOf(d.lhs_bloom_)) {
+      LIMBO_STATS_DO(++internal::Stats::Local().bloom_rejections);
       return false;
     }
-#endif
-    size_t i = 0;
     size_t j = 0;
-    for (; i < c.size(); ++i) {
-      for (; j < d.size() && c[i].lhs() > d[j].lhs(); ++j) {
-      }
+    for (size_t i = 0; i < c.size(); ++i) {
+      j = d.FindLhs(j, c[i].lhs());
       for (size_t k = j; k < d.size() && c[i].lhs() == d[k].lhs(); ++k) {
         if (c[i].Subsumes(d[k])) {
           goto next;
@@ -246,12 +234,11 @@ next:
     assert(!valid());
     assert(!a.valid() && !a.unsatisfiable());
     size_t n_nulls = 0;
-#ifdef BLOOM
     if (!lhs_bloom_.PossiblyContains(a.lhs())) {
+      LIMBO_STATS_DO(++internal::Stats::Local().bloom_rejections);
       return kUnchanged;
     }
-#endif
-    for (size_t i = 0; i < size(); ++i) {
+    for (size_t i = FindLhs(0, a.lhs()); i < size() && a.lhs() == (*this)[i].lhs(); ++i) {
       const Literal b = (*this)[i];
       if (a.Subsumes(b)) {
         if (n_nulls > 0) {
@@ -302,32 +289,29 @@ next:
     return n_nulls > 0 ? kPropagated : kUnchanged;
   }
 
-  Result PropagateUnits(const std::unordered_set<Literal, Literal::LhsHash>& units) {
+  Result PropagateUnits(const Literal::LhsSet& units) {
     assert(primitive());
     assert(!valid());
-    assert(std::all_of(units.begin(), units.end(), [](Literal a) { return a.primitive(); }));
-    assert(std::all_of(units.begin(), units.end(), [](Literal a) { return !a.valid() && !a.unsatisfiable(); }));
     size_t n_nulls = 0;
     for (size_t i = 0; i < size(); ++i) {
       const Literal b = (*this)[i];
-      if (units.bucket_count() > 0) {
-        auto bucket = units.bucket(b);
-        bool complementary = false;
-        for (auto it = units.begin(bucket), end = units.end(bucket); it != end; ++it) {
-          const Literal a = *it;
-          if (a.Subsumes(b)) {
-            if (n_nulls > 0) {
-              RemoveNulls();
-            }
-            return kSubsumed;
-          } else if (Literal::Complementary(b, a)) {
-            complementary = true;
-          }
-        }
-        if (complementary) {
-          Nullify(i);
-          ++n_nulls;
+      bool subsumed = false;
+      bool complementary = false;
+      units.AnyWithLhs(b.lhs(), [b, &subsumed, &complementary](const Literal a) {
+        assert(a.primitive() && !a.valid() && !a.unsatisfiable());
+        subsumed = a.Subsumes(b);
+        complementary |= Literal::Complementary(b, a);
+        return subsumed;
+      });
+      if (subsumed) {
+        if (n_nulls > 0) {
+          RemoveNulls();
         }
+        return kSubsumed;
+      }
+      if (complementary) {
+        Nullify(i);
+        ++n_nulls;
       }
     }
     if (n_nulls > 0) {
@@ -342,18 +326,14 @@ next:
 
   bool Mentions(const Literal a) const {
     return
-#ifdef BLOOM
         lhs_bloom_.PossiblyContains(a.lhs()) &&
-#endif
-        any([a](Literal b) { return a == b; });
+        Find(0, a) < size();
   }
 
   bool MentionsLhs(Term t) const {
     return
-#ifdef BLOOM
         lhs_bloom_.PossiblyContains(t) &&
-#endif
-        any([t](Literal a) { return a.lhs() == t; });
+        FindLhs(0, t) < size();
   }
 
   template<typename UnaryPredicate>
@@ -384,6 +364,49 @@ next:
     return Clause(size(), r.begin(), r.end());
   }
 
+  // SubstitutesNormally() holds when every instance of this clause obtained by
+  // substituting names for variables is normalized up to the order of its
+  // literals: every literal is quasi-primitive with matching sorts, so no
+  // instance literal is valid or unsatisfiable, and the lhs head symbols are
+  // pairwise distinct, so no two instance literals share a lhs and hence none
+  // subsumes another. Instantiating such a clause only needs to sort, which is
+  // what SubstituteNormally() does.
+  bool SubstitutesNormally() const {
+    const Clause& c = *this;
+    for (size_t i = 0; i < size(); ++i) {
+      if (!c[i].quasi_primitive() || c[i].lhs().sort() != c[i].rhs().sort()) {
+        return false;
+      }
+      for (size_t j = i + 1; j < size(); ++j) {
+        if (c[i].lhs().symbol() == c[j].lhs().symbol()) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Like Substitute(), but skips the quadratic part of Normalize(), which is
+  // sound only for substitutions of names for variables in clauses that
+  // satisfy SubstitutesNormally(). Instances of a sorted clause tend to be
+  // nearly sorted already, so the insertion sort is close to linear.
+  template<typename UnaryFunction>
+  Clause SubstituteNormally(UnaryFunction theta, Term::Factory* tf) const {
+    assert(SubstitutesNormally());
+    Clause c(size_);
+    for (size_t i = 0; i < size(); ++i) {
+      const Literal a = (*this)[i].Substitute(theta, tf);
+      size_t k = i;
+      for (; k > 0 && a < c[k - 1]; --k) {
+        c[k] = c[k - 1];
+      }
+      c[k] = a;
+    }
+    c.InitBloom();
+    assert(c == Clause(c.size(), c.cbegin(), c.cend()));
+    return c;
+  }
+
   template<typename UnaryFunction>
   typename internal::if_arg<UnaryFunction, Term>::type Traverse(UnaryFunction f) const {
     for (size_t i = 0; i < size(); ++i) {
@@ -403,15 +426,112 @@ next:
   typedef internal::array_iterator<Clause, Literal> iterator;
   static constexpr size_t kArraySize = 5;
 
+  // A thread-local free-list pool for the overflow blocks. Capacities are
+  // rounded up to powers of two and stored in a header word in front of the
+  // literals, so a block can be returned to its bucket even after the clause
+  // has shrunk by unit propagation. Blocks beyond kMaxPooled literals are rare
+  // and go straight to the heap.
+  class Pool {
+   public:
+    static Literal* Allocate(size_t n) {
+      const size_t cap = Capacity(n);
+      void* block;
+      if (cap <= kMaxPooled && free_list(cap) != nullptr) {
+        block = free_list(cap);
+        free_list(cap) = *reinterpret_cast<void**>(block);
+      } else {
+        block = ::operator new(sizeof(size_t) + cap * sizeof(Literal));
+        LIMBO_MEMORY_DO(internal::Memory::Local().clause_bytes_allocated += sizeof(size_t) + cap * sizeof(Literal));
+      }
+      *reinterpret_cast<size_t*>(block) = cap;
+      return reinterpret_cast<Literal*>(reinterpret_cast<size_t*>(block) + 1);
+    }
+
+    static void Free(Literal* lits) {
+      void* block = reinterpret_cast<size_t*>(lits) - 1;
+      const size_t cap = *reinterpret_cast<size_t*>(block);
+      if (cap <= kMaxPooled) {
+        *reinterpret_cast<void**>(block) = free_list(cap);
+        free_list(cap) = block;
+      } else {
+        LIMBO_MEMORY_DO(internal::Memory::Local().clause_bytes_freed += sizeof(size_t) + cap * sizeof(Literal));
+        ::operator delete(block);
+      }
+    }
+
+   private:
+    static constexpr size_t kMaxPooled = 64;
+
+    static size_t Capacity(size_t n) {
+      size_t cap = 1;
+      while (cap < n) {
+        cap *= 2;
+      }
+      return cap;
+    }
+
+    static void*& free_list(size_t cap) {
+      static thread_local void* lists[8] = {};
+      size_t b = 0;
+      while ((size_t(1) << b) < cap) {
+        ++b;
+      }
+      assert(b < 8);
+      return lists[b];
+    }
+  };
+
+  struct PoolFree {
+    void operator()(Literal* lits) const { Pool::Free(lits); }
+  };
+
+  typedef std::unique_ptr<Literal[], PoolFree> Lits;
+
   explicit Clause(size_t size) : size_(size) {
     if (size2() > 0) {
-      lits2_ = std::unique_ptr<Literal[]>(new Literal[size2()]);
+      lits2_ = Lits(Pool::Allocate(size2()));
     }
   }
 
   size_t size1() const { return size_ < kArraySize ? size_ : kArraySize; }
   size_t size2() const { return size_ < kArraySize ? 0 : (size_ - kArraySize); }
 
+  // FindLhs() and Find() return the least index >= i whose literal has lhs t
+  // or is a, respectively, or size() if there is none. They delegate to the
+  // (potentially vectorized) id searches from the Literal class, once per
+  // literal array.
+  size_t FindLhs(size_t i, Term t) const {
+    const size_t s1 = size1();
+    if (i < s1) {
+      const size_t j = Literal::FindLhs(lits1_, i, s1, t);
+      if (j < s1) {
+        return j;
+      }
+      i = s1;
+    }
+    const size_t s2 = size2();
+    if (s2 > 0) {
+      return kArraySize + Literal::FindLhs(lits2_.get(), i - kArraySize, s2, t);
+    }
+    return size();
+  }
+
+  size_t Find(size_t i, Literal a) const {
+    const size_t s1 = size1();
+    if (i < s1) {
+      const size_t j = Literal::Find(lits1_, i, s1, a);
+      if (j < s1) {
+        return j;
+      }
+      i = s1;
+    }
+    const size_t s2 = size2();
+    if (s2 > 0) {
+      return kArraySize + Literal::Find(lits2_.get(), i - kArraySize, s2, a);
+    }
+    return size();
+  }
+
   Literal& operator[](size_t i) {
     assert(i <= size_);
     return i < kArraySize ? lits1_[i] : lits2_[i - kArraySize];
@@ -428,9 +548,7 @@ next:
   void RemoveNulls() {
     iterator new_end = std::remove_if(begin(), end(), [](const Literal a) { return a.null(); });
     size_ = new_end - begin();
-#ifdef BLOOM
     InitBloom();
-#endif
     assert(!any([](Literal a) { return a.null(); }));
   }
 
@@ -470,21 +588,19 @@ skip:
     size_ = j;
   }
 
-#ifdef BLOOM
   void InitBloom() {
     lhs_bloom_.Clear();
     for (size_t i = 0; i < size(); ++i) {
       lhs_bloom_.Add((*this)[i].lhs());
     }
   }
-#endif
 
   size_t size_ = 0;
-#ifdef BLOOM
   internal::BloomSet<Term> lhs_bloom_;
-#endif
-  Literal lits1_[kArraySize];
-  std::unique_ptr<Literal[]> lits2_;
+  // Zero-initialized so that copying or moving a clause whose tail slots were
+  // never written reads no indeterminate values; null literals have id 0.
+  Literal lits1_[kArraySize] = {};
+  Lits lits2_;
 };
 
 }  // namespace limbo
@@ -494,7 +610,7 @@ namespace std {
 
 template<>
 struct hash<limbo::Clause> {
-  limbo::internal::hash32_t operator()(const limbo::Clause& a) const { return a.hash(); }
+  limbo::internal::hash64_t operator()(const limbo::Clause& a) const { return a.hash(); }
 };
 
 template<>
@@ -76,6 +76,11 @@ struct DefaultLogger {
     const Formula::Ref phi;
   };
 
+  struct RegisterQueryTemplateData : public RegisterData {
+    RegisterQueryTemplateData(const std::string& id, const Formula& phi) : RegisterData(id), phi(phi.Clone()) {}
+    const Formula::Ref phi;
+  };
+
   struct UnregisterData : public LogData {
     explicit UnregisterData(const std::string& id) : id(id) {}
     const std::string id;
@@ -145,6 +150,7 @@ class Context {
   bool IsRegisteredFunction(const std::string& id) const { return funs_.Registered(id); }
   bool IsRegisteredMetaVariable(const std::string& id) const { return meta_vars_.Registered(id); }
   bool IsRegisteredFormula(const std::string& id) const { return formulas_.Registered(id); }
+  bool IsRegisteredQueryTemplate(const std::string& id) const { return templates_.Registered(id); }
   bool IsRegisteredTerm(const std::string& id) const {
     return IsRegisteredVariable(id) || IsRegisteredName(id) || IsRegisteredFunction(id) || IsRegisteredMetaVariable(id);
   }
@@ -217,6 +223,31 @@ class Context {
     logger_(DefaultLogger::RegisterFormulaData(id, phi));
   }
 
+  // Registers phi as a query template whose holes are the registered
+  // variables named by hole_ids. The formula is parsed and resolved only
+  // once; ExecuteQueryTemplate() fills the holes with ground terms and
+  // queries the knowledge base without going through the lexer or parser.
+  void RegisterQueryTemplate(const std::string& id, const Formula& phi, const std::vector<std::string>& hole_ids) {
+    std::vector<Term> holes;
+    holes.reserve(hole_ids.size());
+    for (const std::string& hole_id : hole_ids) {
+      if (!IsRegisteredVariable(hole_id)) {
+        throw std::domain_error(hole_id);
+      }
+      holes.push_back(LookupVariable(hole_id));
+    }
+    templates_.Register(id, QueryTemplate(phi.Clone(), std::move(holes)));
+    logger_(DefaultLogger::RegisterQueryTemplateData(id, phi));
+  }
+
+  bool ExecuteQueryTemplate(const std::string& id, const std::vector<Term>& args) {
+    if (!IsRegisteredQueryTemplate(id)) {
+      throw std::domain_error(id);
+    }
+    const QueryTemplate& temp = templates_.Find(id);
+    return Query(*temp.Instantiate(args, tf()));
+  }
+
   void UnregisterMetaVariable(const std::string& id) {
     if (!IsRegisteredMetaVariable(id))
       throw std::domain_error(id);
@@ -273,6 +304,28 @@ class Context {
         Callback& callback()       { return callback_; }
 
  private:
+  class QueryTemplate {
+   public:
+    QueryTemplate(Formula::Ref phi, std::vector<Term> holes) : phi_(std::move(phi)), holes_(std::move(holes)) {}
+
+    Formula::Ref Instantiate(const std::vector<Term>& args, Term::Factory* tf) const {
+      if (args.size() != holes_.size()) {
+        throw std::domain_error("wrong number of arguments for query template");
+      }
+      Term::Substitution sub;
+      for (size_t i = 0; i < holes_.size(); ++i) {
+        sub.Add(holes_[i], args[i]);
+      }
+      Formula::Ref phi = phi_->Clone();
+      phi->SubstituteFree(sub, tf);
+      return phi;
+    }
+
+   private:
+    Formula::Ref phi_;
+    std::vector<Term> holes_;
+  };
+
   template<typename T>
   class Registry {
    public:
@@ -293,6 +346,7 @@ class Context {
   Registry<Symbol>       funs_;
   Registry<Term>         meta_vars_;
   Registry<Formula::Ref> formulas_;
+  Registry<QueryTemplate> templates_;
   KnowledgeBase          kb_;
   ActionTheory           at_;
   bool                   distribute_ = true;
@@ -2,20 +2,19 @@
 // Copyright 2016-2017 Christoph Schwering
 // Licensed under the MIT license. See LICENSE file in the project root.
 //
-// Max-munch lexer for the problem description language.
+// Single-pass lexer for the problem description language.
 //
-// The compuational complexity is pretty bad (O(n^2)), but we don't expect very
-// long tokens, so parsing shouldn't be the bottleneck.
+// Every character is inspected once: tokens are classified by their first
+// character, scanned to their end, and keywords are told apart from
+// identifiers by a single table lookup. The iterator memoizes the scanned
+// token, so the parser's repeated lookaheads at the same position cost
+// nothing beyond the first scan.
 
 #ifndef LIMBO_FORMAT_PDL_LEXER_H_
 #define LIMBO_FORMAT_PDL_LEXER_H_
 
-#include <cassert>
-
-#include <algorithm>
-#include <functional>
-#include <list>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 #include <limbo/internal/iter.h>
@@ -33,7 +32,7 @@ class Token {
 
   Token() : id_(kError) {}
   explicit Token(Id id) : id_(id) {}
-  Token(Id id, const std::string& str) : id_(id), str_(str) {}
+  Token(Id id, std::string str) : id_(id), str_(std::move(str)) {}
 
   Id id() const { return id_; }
   const std::string& str() const { return str_; }
@@ -47,22 +46,7 @@ class Token {
 
 template<typename ForwardIt>
 class Lexer {
- private:
-  class Word {
-   public:
-    Word(ForwardIt begin, ForwardIt end) : begin_(begin), end_(end) {}
-    ForwardIt begin() const { return begin_; }
-    ForwardIt end() const { return end_; }
-    std::string str() const { return std::string(begin_, end_); }
-   private:
-    ForwardIt begin_;
-    ForwardIt end_;
-  };
-
  public:
-  enum Match { kMismatch, kPrefixMatch, kFullMatch };
-  typedef std::list<std::pair<Token::Id, std::function<Match(Word)>>> LexemeVector;
-
   struct iterator {
     typedef std::ptrdiff_t difference_type;
     typedef Token value_type;
@@ -72,22 +56,20 @@ class Lexer {
     typedef limbo::internal::iterator_proxy<iterator> proxy;
 
     iterator() = default;
-    iterator(const LexemeVector* lexemes, ForwardIt it, ForwardIt end) : lexemes_(lexemes), it_(it), end_(end) {
+    iterator(ForwardIt it, ForwardIt end) : it_(it), end_(end) {
       SkipToNext();
+      Scan();
     }
 
     bool operator==(const iterator& it) const { return it_ == it.it_ && end_ == it.end_; }
     bool operator!=(const iterator& it) const { return !(*this == it); }
 
-    reference operator*() const {
-      const Word w = CurrentWord();
-      const std::pair<Match, Token::Id> m = LexemeMatch(w);
-      return Token(m.second, w.str());
-    }
+    reference operator*() const { return tok_; }
 
     iterator& operator++() {
-      it_ = CurrentWord().end();
+      it_ = tok_end_;
       SkipToNext();
+      Scan();
       return *this;
     }
 
@@ -105,138 +87,120 @@ class Lexer {
 
     void SkipToNext() {
       SkipWhile([](char c) { return IsWhitespace(c); });
-      while (it_ != end_ && LexemeMatch(CurrentWord()).second == Token::kComment) {
+      while (it_ != end_ && *it_ == '/' && std::next(it_) != end_ && *std::next(it_) == '/') {
         SkipWhile([](char c) { return !IsNewLine(c); });
         SkipWhile([](char c) { return IsWhitespace(c); });
       }
     }
 
-    Word CurrentWord() const {
-      // Max-munch lexer
-      assert(it_ != end_);
-      ForwardIt it = it_;
-      ForwardIt jt;
-      std::pair<Match, Token::Id> m;
-      for (jt = it; jt != end_; ++jt) {
-        m = LexemeMatch(Word(it, std::next(jt)));
-        if (m.first == kMismatch) {
-          break;
-        }
+    // Munches [it_, jt) into tok_ and remembers the token's end, so that
+    // dereferencing twice or continuing with operator++() does not re-scan.
+    void Scan() {
+      tok_end_ = it_;
+      if (it_ == end_) {
+        tok_ = Token();
+        return;
       }
-      assert(it != jt);
-      return Word(it, jt);
-    }
-
-    std::pair<Match, Token::Id> LexemeMatch(Word w) const {
-      Match best_match = kMismatch;
-      Token::Id best_token = Token::kError;
-      for (auto& p : *lexemes_) {
-        const Match m = p.second(w);
-        if ((best_match == kMismatch && m == kPrefixMatch) || (best_match != kFullMatch && m == kFullMatch)) {
-          best_match = m;
-          best_token = p.first;
+      ForwardIt jt = it_;
+      const char c = *jt;
+      ++jt;
+      Token::Id id;
+      if (IsDigit(c)) {
+        // No leading zeros: "0123" lexes as "0" followed by "123".
+        if (c != '0') {
+          for (; jt != end_ && IsDigit(*jt); ++jt) {
+          }
+        }
+        id = Token::kUint;
+      } else if (IsAlpha(c)) {
+        for (; jt != end_ && IsAlnum(*jt); ++jt) {
+        }
+        id = Token::kError;  // keywords are told apart from identifiers below
+      } else if (c == '"' || c == '\'') {
+        for (; jt != end_ && *jt != c; ++jt) {
         }
+        id = jt != end_ ? (++jt, Token::kString) : Token::kError;
+      } else {
+        const auto munch = [this, &jt](char c) { return jt != end_ && *jt == c && (++jt, true); };
+        switch (c) {
+          case '/': id = munch('=') ? Token::kInequality : Token::kSlash; break;
+          case ':': id = munch('=') ? Token::kAssign : Token::kColon; break;
+          case ',': id = Token::kComma; break;
+          case '<': id = munch('-') ? (munch('>'), Token::kLRArrow) : Token::kLess; break;
+          case '>': id = Token::kGreater; break;
+          case '=': id = munch('=') ? (munch('>') ? Token::kDoubleRArrow : Token::kEquality) : Token::kEquality; break;
+          case '!': id = munch('=') ? Token::kInequality : Token::kNot; break;
+          case '~': id = Token::kNot; break;
+          case '|': munch('|'); id = Token::kOr; break;
+          case '&': munch('&'); id = Token::kAnd; break;
+          case '^': id = Token::kAnd; break;
+          case '-': id = munch('>') ? Token::kRArrow : Token::kError; break;
+          case '(': id = Token::kLParen; break;
+          case ')': id = Token::kRParen; break;
+          case '[': id = munch(']') ? Token::kBox : Token::kLBracket; break;
+          case ']': id = Token::kRBracket; break;
+          case '{': id = Token::kBegin; break;
+          case '}': id = Token::kEnd; break;
+          default:  id = Token::kError; break;
+        }
+      }
+      std::string str(it_, jt);
+      if (IsAlpha(c)) {
+        id = KeywordOrIdentifier(str);
       }
-      return std::make_pair(best_match, best_token);
+      tok_ = Token(id, std::move(str));
+      tok_end_ = jt;
     }
 
-    const LexemeVector* lexemes_;
     ForwardIt it_;
     ForwardIt end_;
+    Token tok_;
+    ForwardIt tok_end_;
   };
 
-  Lexer(ForwardIt begin, ForwardIt end) : begin_(begin), end_(end) {
-    lexemes_.emplace_back(Token::kRigid,        [](Word w) { return IsPrefix(w, {"Rigid", "rigid"}); });
-    lexemes_.emplace_back(Token::kSort,         [](Word w) { return IsPrefix(w, {"Sort", "sort"}); });
-    lexemes_.emplace_back(Token::kVar,          [](Word w) { return IsPrefix(w, {"Var", "Variable", "var", "variable"}); });  // NOLINT
-    lexemes_.emplace_back(Token::kName,         [](Word w) { return IsPrefix(w, {"Name", "name"}); });
-    lexemes_.emplace_back(Token::kFun,          [](Word w) { return IsPrefix(w, {"Fun", "fun", "Function", "function"}); });  // NOLINT
-    lexemes_.emplace_back(Token::kSlash,        [](Word w) { return IsPrefix(w, "/"); });
-    lexemes_.emplace_back(Token::kSensor,       [](Word w) { return IsPrefix(w, {"Sensor", "sensor"}); });
-    lexemes_.emplace_back(Token::kReal,         [](Word w) { return IsPrefix(w, {"Real", "real"}); });
-    lexemes_.emplace_back(Token::kKB,           [](Word w) { return IsPrefix(w, {"KB", "Kb", "kb"}); });
-    lexemes_.emplace_back(Token::kLet,          [](Word w) { return IsPrefix(w, {"Let", "let"}); });
-    lexemes_.emplace_back(Token::kQuery,        [](Word w) { return IsPrefix(w, {"Query", "query"}); });
-    lexemes_.emplace_back(Token::kAssert,       [](Word w) { return IsPrefix(w, {"Assert", "assert"}); });
-    lexemes_.emplace_back(Token::kRefute,       [](Word w) { return IsPrefix(w, {"Refute", "refute"}); });
-    lexemes_.emplace_back(Token::kColon,        [](Word w) { return IsPrefix(w, ":"); });
-    lexemes_.emplace_back(Token::kComma,        [](Word w) { return IsPrefix(w, ","); });
-    lexemes_.emplace_back(Token::kLess,         [](Word w) { return IsPrefix(w, "<"); });
-    lexemes_.emplace_back(Token::kGreater,      [](Word w) { return IsPrefix(w, ">"); });
-    lexemes_.emplace_back(Token::kEquality,     [](Word w) { return IsPrefix(w, {"==", "="}); });
-    lexemes_.emplace_back(Token::kInequality,   [](Word w) { return IsPrefix(w, {"!=", "/="}); });
-    lexemes_.emplace_back(Token::kNot,          [](Word w) { return IsPrefix(w, {"!", "~"}); });
-    lexemes_.emplace_back(Token::kOr,           [](Word w) { return IsPrefix(w, {"||", "|", "v"}); });
-    lexemes_.emplace_back(Token::kAnd,          [](Word w) { return IsPrefix(w, {"&&", "&", "^"}); });
-    lexemes_.emplace_back(Token::kForall,       [](Word w) { return IsPrefix(w, {"Fa", "fa"}); });
-    lexemes_.emplace_back(Token::kExists,       [](Word w) { return IsPrefix(w, {"Ex", "ex"}); });
-    lexemes_.emplace_back(Token::kRArrow,       [](Word w) { return IsPrefix(w, "->"); });
-    lexemes_.emplace_back(Token::kLRArrow,      [](Word w) { return IsPrefix(w, "<->"); });
-    lexemes_.emplace_back(Token::kDoubleRArrow, [](Word w) { return IsPrefix(w, "==>"); });
-    lexemes_.emplace_back(Token::kLParen,       [](Word w) { return IsPrefix(w, "("); });
-    lexemes_.emplace_back(Token::kRParen,       [](Word w) { return IsPrefix(w, ")"); });
-    lexemes_.emplace_back(Token::kLBracket,     [](Word w) { return IsPrefix(w, "["); });
-    lexemes_.emplace_back(Token::kRBracket,     [](Word w) { return IsPrefix(w, "]"); });
-    lexemes_.emplace_back(Token::kBox,          [](Word w) { return IsPrefix(w, "[]"); });
-    lexemes_.emplace_back(Token::kKnow,         [](Word w) { return IsPrefix(w, {"K", "Know", "know"}); });
-    lexemes_.emplace_back(Token::kCons,         [](Word w) { return IsPrefix(w, {"M", "Cons", "cons"}); });
-    lexemes_.emplace_back(Token::kBel,          [](Word w) { return IsPrefix(w, {"B", "Bel", "bel"}); });
-    lexemes_.emplace_back(Token::kGuarantee,    [](Word w) { return IsPrefix(w, {"G", "Gua", "gua"}); });
-    lexemes_.emplace_back(Token::kRegress,      [](Word w) { return IsPrefix(w, {"REG", "Reg", "reg", "Regress", "regress"}); });  // NOLINT
-    lexemes_.emplace_back(Token::kAssign,       [](Word w) { return IsPrefix(w, ":="); });
-    lexemes_.emplace_back(Token::kIf,           [](Word w) { return IsPrefix(w, {"If", "if"}); });
-    lexemes_.emplace_back(Token::kElse,         [](Word w) { return IsPrefix(w, {"Else", "else"}); });
-    lexemes_.emplace_back(Token::kWhile,        [](Word w) { return IsPrefix(w, {"While", "while"}); });
-    lexemes_.emplace_back(Token::kFor,          [](Word w) { return IsPrefix(w, {"For", "for"}); });
-    lexemes_.emplace_back(Token::kIn,           [](Word w) { return IsPrefix(w, {"In", "in"}); });
-    lexemes_.emplace_back(Token::kBegin,        [](Word w) { return IsPrefix(w, {"Begin", "begin", "{"}); });
-    lexemes_.emplace_back(Token::kEnd,          [](Word w) { return IsPrefix(w, {"End", "end", "}"}); });
-    lexemes_.emplace_back(Token::kCall,         [](Word w) { return IsPrefix(w, {"Call", "call"}); });
-    lexemes_.emplace_back(Token::kComment,      [](Word w) { return IsPrefix(w, "//"); });
-    lexemes_.emplace_back(Token::kUint,
-                          [](Word w) { return w.begin() == w.end()
-                                                  ? kPrefixMatch :
-                                              (*w.begin() != '0' || std::next(w.begin()) == w.end()) &&
-                                               std::all_of(w.begin(), w.end(), [](char c) { return IsDigit(c); })
-                                                  ? kFullMatch
-                                                  : kMismatch; });
-    lexemes_.emplace_back(Token::kString,
-                          [](Word w) { return w.begin() == w.end()
-                                                  ? kPrefixMatch :
-                                              *w.begin() == '"' || *w.begin() == '\''
-                                                  ? (*w.begin() == *w.end() ? kFullMatch : kPrefixMatch)
-                                                  : kMismatch; });
-    lexemes_.emplace_back(Token::kIdentifier,
-                          [](Word w) { return w.begin() == w.end()
-                                                  ? kPrefixMatch :
-                                              IsAlpha(*w.begin()) &&
-                                              std::all_of(w.begin(), w.end(), [](char c) { return IsAlnum(c); })
-                                                  ? kFullMatch
-                                                  : kMismatch; });
-  }
+  Lexer(ForwardIt begin, ForwardIt end) : begin_(begin), end_(end) {}
 
-  iterator begin() const { return iterator(&lexemes_, begin_, end_); }
-  iterator end()   const { return iterator(&lexemes_, end_, end_); }
+  iterator begin() const { return iterator(begin_, end_); }
+  iterator end()   const { return iterator(end_, end_); }
 
  private:
   static_assert(std::is_convertible<typename ForwardIt::iterator_category, std::forward_iterator_tag>::value,
                 "ForwardIt has wrong iterator category");
 
-  static Match IsPrefix(Word w, const std::string& s) {
-    size_t len = std::distance(w.begin(), w.end());
-    if (len > s.length() || std::mismatch(w.begin(), w.end(), s.begin()).first != w.end()) {
-      return kMismatch;
-    } else {
-      return len < s.length() ? kPrefixMatch : kFullMatch;
-    }
-  }
-
-  static Match IsPrefix(Word w, const std::initializer_list<std::string>& sentences) {
-    Match m = kMismatch;
-    for (const auto& sentence : sentences) {
-      m = std::max(m, IsPrefix(w, sentence));
-    }
-    return m;
+  static Token::Id KeywordOrIdentifier(const std::string& s) {
+    static const std::unordered_map<std::string, Token::Id> kKeywords{
+      {"Rigid", Token::kRigid}, {"rigid", Token::kRigid},
+      {"Sort", Token::kSort}, {"sort", Token::kSort},
+      {"Var", Token::kVar}, {"Variable", Token::kVar}, {"var", Token::kVar}, {"variable", Token::kVar},
+      {"Name", Token::kName}, {"name", Token::kName},
+      {"Fun", Token::kFun}, {"fun", Token::kFun}, {"Function", Token::kFun}, {"function", Token::kFun},
+      {"Sensor", Token::kSensor}, {"sensor", Token::kSensor},
+      {"Real", Token::kReal}, {"real", Token::kReal},
+      {"KB", Token::kKB}, {"Kb", Token::kKB}, {"kb", Token::kKB},
+      {"Let", Token::kLet}, {"let", Token::kLet},
+      {"Query", Token::kQuery}, {"query", Token::kQuery},
+      {"Assert", Token::kAssert}, {"assert", Token::kAssert},
+      {"Refute", Token::kRefute}, {"refute", Token::kRefute},
+      {"v", Token::kOr},
+      {"Fa", Token::kForall}, {"fa", Token::kForall},
+      {"Ex", Token::kExists}, {"ex", Token::kExists},
+      {"K", Token::kKnow}, {"Know", Token::kKnow}, {"know", Token::kKnow},
+      {"M", Token::kCons}, {"Cons", Token::kCons}, {"cons", Token::kCons},
+      {"B", Token::kBel}, {"Bel", Token::kBel}, {"bel", Token::kBel},
+      {"G", Token::kGuarantee}, {"Gua", Token::kGuarantee}, {"gua", Token::kGuarantee},
+      {"REG", Token::kRegress}, {"Reg", Token::kRegress}, {"reg", Token::kRegress},
+      {"Regress", Token::kRegress}, {"regress", Token::kRegress},
+      {"If", Token::kIf}, {"if", Token::kIf},
+      {"Else", Token::kElse}, {"else", Token::kElse},
+      {"While", Token::kWhile}, {"while", Token::kWhile},
+      {"For", Token::kFor}, {"for", Token::kFor},
+      {"In", Token::kIn}, {"in", Token::kIn},
+      {"Begin", Token::kBegin}, {"begin", Token::kBegin},
+      {"End", Token::kEnd}, {"end", Token::kEnd},
+      {"Call", Token::kCall}, {"call", Token::kCall},
+    };
+    const auto it = kKeywords.find(s);
+    return it != kKeywords.end() ? it->second : Token::kIdentifier;
   }
 
   static bool IsNewLine(char c) { return c == '\r' || c == '\n'; }
@@ -245,7 +209,6 @@ class Lexer {
   static bool IsAlpha(char c) { return ('A' <= c && c <= 'Z') || ('a' <= c && c <= 'z') || c == '_'; }
   static bool IsAlnum(char c) { return IsAlpha(c) || IsDigit(c) || c == '-' || c == '\''; }
 
-  LexemeVector lexemes_;
   ForwardIt begin_;
   ForwardIt end_;
 };
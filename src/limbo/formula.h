@@ -28,6 +28,7 @@
 
 #include <limbo/clause.h>
 
+#include <limbo/internal/hash.h>
 #include <limbo/internal/iter.h>
 #include <limbo/internal/intmap.h>
 #include <limbo/internal/ints.h>
@@ -208,10 +209,30 @@ class Formula {
 
   virtual ~Formula() {}
 
-  virtual bool operator==(const Formula&) const = 0;
+  // Structural equality; the memoized hash serves as a cheap reject, so
+  // comparing two unequal formulas usually does not recurse at all.
+  bool operator==(const Formula& that) const {
+    return this == &that || (hash() == that.hash() && Equals(that));
+  }
   bool operator!=(const Formula& that) const { return !(*this == that); }
 
-  virtual Ref Clone() const = 0;
+  // A structural hash; equal formulas have equal hashes. Like free_vars(),
+  // the hash is computed once and invalidated when a substitution mutates
+  // the formula.
+  internal::hash64_t hash() const {
+    if (!hash_) {
+      hash_ = internal::Just(Hash());
+    }
+    return hash_.val;
+  }
+
+  // Clone() preserves the normal-form flag (see NF()); the subclasses
+  // override DoClone() and rebuild through the Factory.
+  Ref Clone() const {
+    Ref alpha = DoClone();
+    alpha->normal_ = normal_;
+    return alpha;
+  }
 
   Type type() const { return type_; }
 
@@ -246,6 +267,33 @@ class Formula {
     ISubstitute(FreeSubstitution(theta), tf);
   }
 
+  // Single-pair substitutions -- the pattern of the quantifier instantiation
+  // loops, which substitute one variable with one name per iteration -- go
+  // through Term::Factory's substitution memo, which shares the rebuilt term
+  // DAG across the iterations instead of re-traversing every term once per
+  // name. The single pair is substituted in a whole term at once, which is
+  // sound because the bound variables cannot change within a term; if the
+  // substituted term itself is bound by a quantifier in scope, the
+  // substitution is the identity on the terms in its scope.
+  void SubstituteFree(const Term::Substitution& theta, Term::Factory* tf) {
+    if (theta.subs_.size() != 1) {
+      SubstituteFree([&theta](Term t) { return theta(t); }, tf);
+      return;
+    }
+    class SingleSubstitution : public ISubstitution {
+     public:
+      SingleSubstitution(Term x, Term n, Term::Factory* tf) : x_(x), n_(n), tf_(tf) {}
+      Maybe<Term> operator()(Term t) const override {
+        return !bound(x_) ? internal::Just(tf_->Substitute(t, x_, n_)) : internal::Nothing;
+      }
+     private:
+      Term x_;
+      Term n_;
+      Term::Factory* tf_;
+    };
+    ISubstitute(SingleSubstitution(theta.subs_[0].first, theta.subs_[0].second, tf), tf);
+  }
+
   template<typename UnaryFunction>
   void Traverse(UnaryFunction f) const {
     typedef typename internal::remove_const_ref<typename internal::arg<UnaryFunction>::template type<0>>::type arg_type;
@@ -260,6 +308,16 @@ class Formula {
   }
 
   Ref NF(Symbol::Factory* sf, Term::Factory* tf, bool distribute = true) const {
+    // Formulas that NF() produced itself, or that the Factory recognized as
+    // normal on construction, carry a flag (memoized like free_vars_) and
+    // are just cloned: re-normalizing would rebuild the whole tree with
+    // fresh variables through the factories for no semantic gain. The flag
+    // is per distribution mode, since the two modes normalize differently,
+    // and a substitution clears it.
+    const internal::u8 normal = distribute ? kNormalDistributed : kNormalUndistributed;
+    if ((normal_ & normal) != 0) {
+      return Clone();
+    }
     Ref alpha = Rectify(sf, tf);
     alpha = alpha->Normalize(distribute);
     alpha = alpha->Flatten(0, sf, tf);
@@ -267,6 +325,7 @@ class Formula {
     // for x and eliminate the quantifier and t = x literal provided that x does
     // not occur within a belief modality.
     alpha = alpha->Normalize(distribute);
+    alpha->normal_ |= normal;
     return Ref(std::move(alpha));
   }
 
@@ -330,9 +389,25 @@ class Formula {
 
   explicit Formula(Type type) : type_(type) {}
 
+  virtual bool Equals(const Formula&) const = 0;
+
+  virtual Ref DoClone() const = 0;
+
+  virtual internal::hash64_t Hash() const = 0;
+
   virtual SortedTermSet FreeVars() const = 0;
 
-  virtual void ISubstitute(const ISubstitution&, Term::Factory*) = 0;
+  // The non-virtual wrapper drops the memoized hash and free variables of
+  // every node the substitution descends into; the recursive calls in the
+  // DoISubstitute() overrides go through the wrapper again.
+  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) {
+    DoISubstitute(theta, tf);
+    hash_ = internal::Nothing;
+    free_vars_ = internal::Nothing;
+    normal_ = 0;
+  }
+
+  virtual void DoISubstitute(const ISubstitution&, Term::Factory*) = 0;
   virtual void ITraverse(const ITraversal<Term>&)    const = 0;
   virtual void ITraverse(const ITraversal<Literal>&) const = 0;
   virtual void ITraverse(const ITraversal<Clause>&)  const = 0;
@@ -383,8 +458,13 @@ class Formula {
   }
 
  private:
+  static constexpr internal::u8 kNormalDistributed = 1;    // in the normal form of NF() with distribute
+  static constexpr internal::u8 kNormalUndistributed = 2;  // in the normal form of NF() without distribute
+
   Type type_;
   mutable Maybe<SortedTermSet> free_vars_ = internal::Nothing;
+  mutable Maybe<internal::hash64_t> hash_ = internal::Nothing;
+  internal::u8 normal_ = 0;
 };
 
 Formula::Ref Formula::QuantifierPrefix::PrependTo(Ref alpha) const {
@@ -401,9 +481,11 @@ Formula::Ref Formula::QuantifierPrefix::PrependTo(Ref alpha) const {
 
 class Formula::Atomic : public Formula {
  public:
-  bool operator==(const Formula& that) const override { return type() == that.type() && c_ == that.as_atomic().c_; }
+  bool Equals(const Formula& that) const override { return type() == that.type() && c_ == that.as_atomic().c_; }
+
+  internal::hash64_t Hash() const override { return internal::splitmix64_hash(type()) ^ c_.hash(); }
 
-  Ref Clone() const override { return Factory::Atomic(c_); }
+  Ref DoClone() const override { return Factory::Atomic(c_); }
 
   const Clause& arg() const { return c_; }
 
@@ -436,7 +518,7 @@ class Formula::Atomic : public Formula {
     return ts;
   }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
     c_ = c_.Substitute([&theta](Term t) { return theta(t); }, tf);
   }
   void ITraverse(const ITraversal<Term>& f)    const override { c_.Traverse([&f](Term t) { return f(t); }); }
@@ -506,11 +588,15 @@ class Formula::Atomic : public Formula {
 
 class Formula::Or : public Formula {
  public:
-  bool operator==(const Formula& that) const override {
+  bool Equals(const Formula& that) const override {
     return type() == that.type() && *alpha_ == *that.as_or().alpha_ && *beta_ == *that.as_or().beta_;
   }
 
-  Ref Clone() const override { return Factory::Or(alpha_->Clone(), beta_->Clone()); }
+  internal::hash64_t Hash() const override {
+    return internal::splitmix64_hash(type()) ^ alpha_->hash() ^ internal::splitmix64_hash(beta_->hash());
+  }
+
+  Ref DoClone() const override { return Factory::Or(alpha_->Clone(), beta_->Clone()); }
 
   const Formula& lhs() const { return *alpha_; }
   const Formula& rhs() const { return *beta_; }
@@ -548,7 +634,7 @@ class Formula::Or : public Formula {
     return ts;
   }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
     alpha_->ISubstitute(theta, tf);
     beta_->ISubstitute(theta, tf);
   }
@@ -626,11 +712,15 @@ class Formula::Or : public Formula {
 
 class Formula::Exists : public Formula {
  public:
-  bool operator==(const Formula& that) const override {
+  bool Equals(const Formula& that) const override {
     return type() == that.type() && x_ == that.as_exists().x_ && *alpha_ == *that.as_exists().alpha_;
   }
 
-  Ref Clone() const override { return Factory::Exists(x_, alpha_->Clone()); }
+  internal::hash64_t Hash() const override {
+    return internal::splitmix64_hash(type()) ^ x_.hash() ^ alpha_->hash();
+  }
+
+  Ref DoClone() const override { return Factory::Exists(x_, alpha_->Clone()); }
 
   Term x() const { return x_; }
   const Formula& arg() const { return *alpha_; }
@@ -652,7 +742,7 @@ class Formula::Exists : public Formula {
 
   SortedTermSet FreeVars() const override { SortedTermSet ts = alpha_->free_vars(); ts.erase(x_); return ts; }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
     theta.Bind(x_);
     alpha_->ISubstitute(theta, tf);
     theta.Unbind(x_);
@@ -737,11 +827,13 @@ class Formula::Exists : public Formula {
 
 class Formula::Not : public Formula {
  public:
-  bool operator==(const Formula& that) const override {
+  bool Equals(const Formula& that) const override {
     return type() == that.type() && *alpha_ == *that.as_not().alpha_;
   }
 
-  Ref Clone() const override { return Factory::Not(alpha_->Clone()); }
+  internal::hash64_t Hash() const override { return internal::splitmix64_hash(type()) ^ alpha_->hash(); }
+
+  Ref DoClone() const override { return Factory::Not(alpha_->Clone()); }
 
   const Formula& arg() const { return *alpha_; }
 
@@ -762,7 +854,7 @@ class Formula::Not : public Formula {
 
   SortedTermSet FreeVars() const override { return alpha_->free_vars(); }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override { alpha_->ISubstitute(theta, tf); }
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override { alpha_->ISubstitute(theta, tf); }
   void ITraverse(const ITraversal<Term>& f)    const override { alpha_->ITraverse(f); }
   void ITraverse(const ITraversal<Literal>& f) const override { alpha_->ITraverse(f); }
   void ITraverse(const ITraversal<Clause>& f)  const override { alpha_->ITraverse(f); }
@@ -831,11 +923,15 @@ class Formula::Not : public Formula {
 
 class Formula::Know : public Formula {
  public:
-  bool operator==(const Formula& that) const override {
-    return type() == that.type() && *alpha_ == *that.as_know().alpha_;
+  bool Equals(const Formula& that) const override {
+    return type() == that.type() && k_ == that.as_know().k_ && *alpha_ == *that.as_know().alpha_;
+  }
+
+  internal::hash64_t Hash() const override {
+    return internal::splitmix64_hash(type()) ^ internal::splitmix64_hash(k_) ^ alpha_->hash();
   }
 
-  Ref Clone() const override { return Factory::Know(k_, alpha_->Clone()); }
+  Ref DoClone() const override { return Factory::Know(k_, alpha_->Clone()); }
 
   belief_level k() const { return k_; }
   const Formula& arg() const { return *alpha_; }
@@ -857,7 +953,7 @@ class Formula::Know : public Formula {
 
   SortedTermSet FreeVars() const override { return alpha_->free_vars(); }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override { alpha_->ISubstitute(theta, tf); }
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override { alpha_->ISubstitute(theta, tf); }
   void ITraverse(const ITraversal<Term>& f)    const override { alpha_->ITraverse(f); }
   void ITraverse(const ITraversal<Literal>& f) const override { alpha_->ITraverse(f); }
   void ITraverse(const ITraversal<Clause>& f)  const override { alpha_->ITraverse(f); }
@@ -947,11 +1043,15 @@ class Formula::Know : public Formula {
 
 class Formula::Cons : public Formula {
  public:
-  bool operator==(const Formula& that) const override {
-    return type() == that.type() && *alpha_ == *that.as_cons().alpha_;
+  bool Equals(const Formula& that) const override {
+    return type() == that.type() && k_ == that.as_cons().k_ && *alpha_ == *that.as_cons().alpha_;
   }
 
-  Ref Clone() const override { return Factory::Cons(k_, alpha_->Clone()); }
+  internal::hash64_t Hash() const override {
+    return internal::splitmix64_hash(type()) ^ internal::splitmix64_hash(k_) ^ alpha_->hash();
+  }
+
+  Ref DoClone() const override { return Factory::Cons(k_, alpha_->Clone()); }
 
   belief_level k() const { return k_; }
   const Formula& arg() const { return *alpha_; }
@@ -973,7 +1073,7 @@ class Formula::Cons : public Formula {
 
   SortedTermSet FreeVars() const override { return alpha_->free_vars(); }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override { alpha_->ISubstitute(theta, tf); }
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override { alpha_->ISubstitute(theta, tf); }
   void ITraverse(const ITraversal<Term>& f)    const override { alpha_->ITraverse(f); }
   void ITraverse(const ITraversal<Literal>& f) const override { alpha_->ITraverse(f); }
   void ITraverse(const ITraversal<Clause>& f)  const override { alpha_->ITraverse(f); }
@@ -1056,13 +1156,20 @@ class Formula::Cons : public Formula {
 
 class Formula::Bel : public Formula {
  public:
-  bool operator==(const Formula& that) const override {
+  bool Equals(const Formula& that) const override {
     return type() == that.type() &&
+        k_ == that.as_bel().k_ &&
+        l_ == that.as_bel().l_ &&
         *ante_ == *that.as_bel().ante_ &&
         *not_ante_or_conse_ == *that.as_bel().not_ante_or_conse_;
   }
 
-  Ref Clone() const override {
+  internal::hash64_t Hash() const override {
+    return internal::splitmix64_hash(type()) ^ internal::splitmix64_hash(k_) ^ internal::splitmix64_hash(l_ + 1) ^
+        ante_->hash() ^ internal::splitmix64_hash(not_ante_or_conse_->hash());
+  }
+
+  Ref DoClone() const override {
     return Factory::Bel(k_, l_, ante_->Clone(), conse_->Clone(), not_ante_or_conse_->Clone());
   }
 
@@ -1095,7 +1202,7 @@ class Formula::Bel : public Formula {
 
   SortedTermSet FreeVars() const override { return not_ante_or_conse_->free_vars(); }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
     ante_->ISubstitute(theta, tf);
     conse_->ISubstitute(theta, tf);
     not_ante_or_conse_->ISubstitute(theta, tf);
@@ -1161,11 +1268,13 @@ class Formula::Bel : public Formula {
 
 class Formula::Guarantee : public Formula {
  public:
-  bool operator==(const Formula& that) const override {
+  bool Equals(const Formula& that) const override {
     return type() == that.type() && *alpha_ == *that.as_guarantee().alpha_;
   }
 
-  Ref Clone() const override { return Factory::Guarantee(alpha_->Clone()); }
+  internal::hash64_t Hash() const override { return internal::splitmix64_hash(type()) ^ alpha_->hash(); }
+
+  Ref DoClone() const override { return Factory::Guarantee(alpha_->Clone()); }
 
   const Formula& arg() const { return *alpha_; }
 
@@ -1188,7 +1297,7 @@ class Formula::Guarantee : public Formula {
 
   SortedTermSet FreeVars() const override { return alpha_->free_vars(); }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override { alpha_->ISubstitute(theta, tf); }
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override { alpha_->ISubstitute(theta, tf); }
   void ITraverse(const ITraversal<Term>& f)    const override { alpha_->ITraverse(f); }
   void ITraverse(const ITraversal<Literal>& f) const override { alpha_->ITraverse(f); }
   void ITraverse(const ITraversal<Clause>& f)  const override { alpha_->ITraverse(f); }
@@ -1225,11 +1334,15 @@ class Formula::Guarantee : public Formula {
 
 class Formula::Action : public Formula {
  public:
-  bool operator==(const Formula& that) const override {
+  bool Equals(const Formula& that) const override {
     return type() == that.type() && t_ == that.as_action().t_ && *alpha_ == *that.as_action().alpha_;
   }
 
-  Ref Clone() const override { return Factory::Action(t_, alpha_->Clone()); }
+  internal::hash64_t Hash() const override {
+    return internal::splitmix64_hash(type()) ^ t_.hash() ^ alpha_->hash();
+  }
+
+  Ref DoClone() const override { return Factory::Action(t_, alpha_->Clone()); }
 
   Term t() const { return t_; }
   const Formula& arg() const { return *alpha_; }
@@ -1265,7 +1378,7 @@ class Formula::Action : public Formula {
     return ts;
   }
 
-  void ISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
+  void DoISubstitute(const ISubstitution& theta, Term::Factory* tf) override {
     t_ = t_.Substitute([&theta](Term t) { return theta(t); }, tf);
     alpha_->ISubstitute(theta, tf);
   }
@@ -1352,7 +1465,16 @@ class Formula::Action : public Formula {
   Ref alpha_;
 };
 
-Formula::Ref Formula::Factory::Atomic(const Clause& c) { return Ref(new class Atomic(c)); }
+Formula::Ref Formula::Factory::Atomic(const Clause& c) {
+  Ref alpha = Ref(new class Atomic(c));
+  // A clause of primitive or trivial literals is rectified and flat already,
+  // so NF() is a no-op on it under either distribution mode. This covers the
+  // clauses programmatically built queries are made of.
+  if (c.all([](const Literal a) { return a.primitive() || a.trivial(); })) {
+    alpha->normal_ = kNormalDistributed | kNormalUndistributed;
+  }
+  return alpha;
+}
 Formula::Ref Formula::Factory::Not(Ref alpha)          { return Ref(new class Not(std::move(alpha))); }
 Formula::Ref Formula::Factory::Or(Ref lhs, Ref rhs)    { return Ref(new class Or(std::move(lhs), std::move(rhs))); }
 Formula::Ref Formula::Factory::Exists(Term x, Ref alpha) { return Ref(new class Exists(x, std::move(alpha))); }
@@ -1465,5 +1587,20 @@ inline const class Formula::Action& Formula::as_action() const {
 
 }  // namespace limbo
 
+
+namespace std {
+
+template<>
+struct hash<limbo::Formula> {
+  limbo::internal::hash64_t operator()(const limbo::Formula& alpha) const { return alpha.hash(); }
+};
+
+template<>
+struct equal_to<limbo::Formula> {
+  bool operator()(const limbo::Formula& alpha, const limbo::Formula& beta) const { return alpha == beta; }
+};
+
+}  // namespace std
+
 #endif  // LIMBO_FORMULA_H_
 
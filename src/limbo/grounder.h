@@ -18,6 +18,36 @@
 // Grounder uses a temporary NamePool where names can be returned for later
 // re-use. This NamePool is public for it can also be used to handle free
 // variables in the representation theorem.
+//
+// When more than one thread is configured with set_n_threads(), the ground
+// instances of the added clauses are constructed on a pool of worker threads,
+// for the instances are independent of each other and the term factory is
+// internally synchronized. The instances are added to the setup in a single
+// sequential phase afterwards, which keeps the setup single-threaded and the
+// insertion order deterministic.
+//
+// Regrounding an added clause caches its ground instances under the clause,
+// the substitution, and the current universe of names. The cache survives
+// UndoLast(), so when successive queries mention the same terms -- and hence
+// re-create the same names -- the already-normalized instances are reused
+// rather than re-derived by substitution.
+//
+// The terms and names eligible for splitting are materialized per ply-epoch,
+// so the solver's split recursion scans contiguous candidate vectors instead
+// of re-joining the per-ply indices at every level.
+//
+// Query relevance is tracked by a union-find index over the lhs terms of the
+// ground clauses, merged incrementally as the clauses are added and rolled
+// back through the same journal mechanism as the plies themselves. The
+// clauses connected to the query terms are thus found without any graph
+// traversal, at the price of a slight over-approximation: the components
+// never split when a unit clause severs a term, which only costs filter
+// precision, not correctness.
+//
+// In lazy mode (set_lazy()), added clauses are held back symbolically and
+// only ground when a query first needs them. Under a consistency guarantee
+// only the clauses connected to the query by shared function symbols are
+// flushed; the rest stays pending and costs neither time nor memory.
 
 
 #ifndef LIMBO_GROUNDER_H_
@@ -26,6 +56,7 @@
 #include <cassert>
 
 #include <algorithm>
+#include <atomic>
 #include <list>
 #include <memory>
 #include <unordered_map>
@@ -42,6 +73,9 @@
 #include <limbo/internal/ints.h>
 #include <limbo/internal/iter.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/memory.h>
+#include <limbo/internal/threadpool.h>
+#include <limbo/internal/timers.h>
 
 namespace limbo {
 
@@ -49,6 +83,7 @@ class Grounder {
  public:
   typedef internal::size_t size_t;
   typedef Setup::ClauseRange::Index ClauseIndex;
+  typedef std::unordered_set<Symbol> SymbolSet;
 
   template<Symbol (Symbol::Factory::*CreateSymbol)(Symbol::Sort)>
   class Pool {
@@ -71,6 +106,21 @@ class Grounder {
 
     void Return(Term t) { terms_[t.sort()].push_back(t); }
 
+    // Drops the pooled terms the mark does not cover. Must run before
+    // Term::Factory::Backtrack() releases those terms, for otherwise the
+    // pool would hand out dangling ids afterwards.
+    void Backtrack(const Term::Factory::Mark& mark) {
+      for (Term::Vector& ts : terms_) {
+        ts.erase(std::remove_if(ts.begin(), ts.end(),
+                                [&mark](const Term t) { return !mark.covers(t); }),
+                 ts.end());
+      }
+    }
+
+    // Pre-grows the per-sort table to cover n_sorts sorts, so that handing
+    // out the first term of each sort does not resize it key by key.
+    void Reserve(size_t n_sorts) { terms_.FitForKeys(n_sorts); }
+
     Term Get(Symbol::Sort sort, size_t i) {
       Term::Vector& ts = terms_[sort];
       while (i < ts.size()) {
@@ -93,7 +143,7 @@ class Grounder {
   template<typename T>
   struct Ungrounded {
     typedef T value_type;
-    struct Hash { internal::hash32_t operator()(const Ungrounded<T>& u) const { return u.val.hash(); } };
+    struct Hash { internal::hash64_t operator()(const Ungrounded<T>& u) const { return u.val.hash(); } };
     typedef std::vector<Ungrounded> Vector;
     typedef std::unordered_set<Ungrounded, Hash> Set;
 
@@ -125,7 +175,6 @@ class Grounder {
     struct {
       Ungrounded<Clause>::Vector ungrounded;
       Setup::ShallowCopy shallow_setup;
-      std::unordered_map<Term, std::unordered_set<ClauseIndex>> with_term;
     } clauses;
     struct {
       SortedTermSet mentioned;       // names mentioned in clause or prepared-for query (but are not plus-names)
@@ -141,7 +190,7 @@ class Grounder {
       bool filter = false;  // enabled after consistency guarantee
       Ungrounded<Term>::Set ungrounded;
       std::unordered_set<Term> query_terms;
-      std::unordered_map<ClauseIndex, bool> clauses;  // (i,true) means i is relevant until a later ply has (i,false)
+      size_t mark = 0;  // relevance-index journal position at ply creation
     } relevant;
     bool do_not_add_if_inconsistent = false;  // enabled for fix-literals
 
@@ -149,6 +198,24 @@ class Grounder {
     friend class Grounder;
 
     Ply() = default;
+
+    // Returns the ply to its freshly constructed state but keeps the
+    // capacity of its containers, so a recycled ply allocates nothing.
+    void Reset() {
+      clauses.ungrounded.clear();
+      clauses.shallow_setup.Kill();
+      names.mentioned.clear();
+      names.plus_max.clear();
+      names.plus_new.clear();
+      names.plus_mentioned.clear();
+      lhs_rhs.ungrounded.clear();
+      lhs_rhs.map.clear();
+      relevant.filter = false;
+      relevant.ungrounded.clear();
+      relevant.query_terms.clear();
+      relevant.mark = 0;
+      do_not_add_if_inconsistent = false;
+    }
   };
 
   struct Plies {
@@ -186,139 +253,52 @@ class Grounder {
     const Plies::Policy policy;
   };
 
-  struct LhsTerms {
-    struct First { Term operator()(const std::pair<Term, std::unordered_set<Term>>& p) const { return p.first; } };
-    typedef std::unordered_map<Term, std::unordered_set<Term>>::const_iterator pair_iterator;
-    typedef internal::transform_iterator<pair_iterator, First> term_iterator;
-
-    struct New {
-      New() = default;
-      New(Plies::iterator begin, Plies::iterator end) : begin(begin), end(end) {}
-      bool operator()(Term t) const {
-        for (auto it = begin; it != end; ++it) {
-          auto& m = it->lhs_rhs.map;
-          if (m.count(t) > 0) {
-            return false;
-          }
-        }
-        return true;
-      }
-     private:
-      Plies::iterator begin;
-      Plies::iterator end;
-    };
-
-    typedef internal::filter_iterator<term_iterator, New> unique_term_iterator;
+  // The split-term and split-name candidates handed out by lhs_terms() and
+  // rhs_names() are materialized as flat, deduplicated vectors; see the
+  // candidate cache for details. The vectors are shared so that they survive
+  // the cache refreshes triggered by later ply pushes and pops.
+  typedef std::shared_ptr<const Term::Vector> CandidateVector;
 
-    struct Begin {
-      explicit Begin(const Plies* plies) : plies(plies) {}
-      unique_term_iterator operator()(const Plies::iterator it) const {
-        term_iterator b = term_iterator(it->lhs_rhs.map.begin(), First());
-        term_iterator e = term_iterator(it->lhs_rhs.map.end(), First());
-        return unique_term_iterator(b, e, New(plies->begin(), it));
-      }
-     private:
-      const Plies* plies;
-    };
-
-    struct End {
-      explicit End(const Plies* plies) : plies(plies) {}
-      unique_term_iterator operator()(const Plies::iterator it) const {
-        term_iterator e = term_iterator(it->lhs_rhs.map.end(), First());
-        return unique_term_iterator(e, e, New(plies->begin(), it));
-      }
-     private:
-      const Plies* plies;
-    };
-
-    struct IsRelevant {
-      explicit IsRelevant(const Grounder* owner) : owner(owner) {}
-      bool operator()(const Term t) const { return owner->IsRelevantTerm(t); }
-     private:
-      const Grounder* owner;
-    };
-
-    typedef internal::flatten_iterator<Plies::iterator, unique_term_iterator, Begin, End> flat_iterator;
-    typedef internal::filter_iterator<flat_iterator, IsRelevant> iterator;
-
-    iterator begin() const {
-      auto b = flat_iterator(plies.begin(), plies.end(), Begin(&plies), End(&plies));
-      auto e = flat_iterator(plies.end(), plies.end(), Begin(&plies), End(&plies));
-      return iterator(b, e, is_relevant);
-    }
+  struct LhsTerms {
+    typedef Term::Vector::const_iterator iterator;
 
-    iterator end() const {
-      auto e = flat_iterator(plies.end(), plies.end(), Begin(&plies), End(&plies));
-      return iterator(e, e, is_relevant);
-    }
+    iterator begin() const { return ts->begin(); }
+    iterator end()   const { return ts->end(); }
 
    private:
     friend class Grounder;
 
-    LhsTerms(const Grounder* owner, Plies::Policy policy)
-        : is_relevant(owner), plies(owner, policy) {}
+    explicit LhsTerms(CandidateVector ts) : ts(std::move(ts)) {}
 
-    const IsRelevant is_relevant;
-    const Plies plies;
+    const CandidateVector ts;
   };
 
   struct RhsNames {
-    typedef std::unordered_set<Term>::const_iterator name_iterator;
-
-    struct Begin {
-      Begin(Term t, name_iterator end) : t(t), end(end) {}
-      name_iterator operator()(const Ply& p) const {
-        auto it = p.lhs_rhs.map.find(t);
-        return it != p.lhs_rhs.map.end() ? it->second.begin() : end;
-      }
-     private:
-      Term t;
-      name_iterator end;
-    };
-
-    struct End {
-      End(Term t, name_iterator end) : t(t), end(end) {}
-      name_iterator operator()(const Ply& p) const {
-        auto it = p.lhs_rhs.map.find(t);
-        return it != p.lhs_rhs.map.end() ? it->second.end() : end;
-      }
-     private:
-      Term t;
-      name_iterator end;
-    };
-
-    typedef internal::flatten_iterator<Plies::iterator, name_iterator, Begin, End> flat_iterator;
+    typedef Term::Vector::const_iterator name_iterator;
     typedef internal::singleton_iterator<Term> plus_iterator;
-    typedef internal::joined_iterator<flat_iterator, plus_iterator> iterator;
+    typedef internal::joined_iterator<name_iterator, plus_iterator> iterator;
 
     ~RhsNames() { if (!n_it->null()) { owner->name_pool_.Return(*n_it); } }
 
     iterator begin() const {
-      flat_iterator b = flat_iterator(plies.begin(), plies.end(), Begin(t, ts.end()), End(t, ts.end()));
-      flat_iterator e = flat_iterator(plies.end(),   plies.end(), Begin(t, ts.end()), End(t, ts.end()));
       if (n_it->null()) {
         n_it = plus_iterator(owner->name_pool_.Create(t.sort()));
       }
-      return iterator(b, e, n_it);
+      return iterator(ns->begin(), ns->end(), n_it);
     }
 
-    iterator end() const {
-      flat_iterator b = flat_iterator(plies.end(), plies.end(), Begin(t, ts.end()), End(t, ts.end()));
-      flat_iterator e = flat_iterator(plies.end(), plies.end(), Begin(t, ts.end()), End(t, ts.end()));
-      return iterator(b, e, plus_iterator());
-    }
+    iterator end() const { return iterator(ns->end(), ns->end(), plus_iterator()); }
 
    private:
     friend class Grounder;
 
-    RhsNames(Grounder* owner, Term t, Plies::Policy policy)
-        : owner(owner), plies(owner, policy), t(t), n_it(Term()) { assert(n_it->null()); }
+    RhsNames(Grounder* owner, Term t, CandidateVector ns)
+        : owner(owner), t(t), ns(std::move(ns)), n_it(Term()) { assert(n_it->null()); }
 
     Grounder* const owner;
-    const Plies plies;
     const Term t;
+    const CandidateVector ns;
     mutable plus_iterator n_it;
-    const std::unordered_set<Term> ts = {};
   };
 
   struct Names {
@@ -359,73 +339,21 @@ class Grounder {
     const Plies plies;
   };
 
-  struct ClausesWithTerm {
-    typedef std::unordered_set<ClauseIndex>::const_iterator clause_iterator;
-
-    struct Begin {
-      Begin(Term t, clause_iterator end) : t(t), end(end) {}
-      clause_iterator operator()(const Ply& p) const {
-        auto it = p.clauses.with_term.find(t);
-        return it != p.clauses.with_term.end() ? it->second.begin() : end;
-      }
-     private:
-      Term t;
-      clause_iterator end;
-    };
-
-    struct End {
-      End(Term t, clause_iterator end) : t(t), end(end) {}
-      clause_iterator operator()(const Ply& p) const {
-        auto it = p.clauses.with_term.find(t);
-        return it != p.clauses.with_term.end() ? it->second.end() : end;
-      }
-     private:
-      Term t;
-      clause_iterator end;
-    };
-
-    typedef internal::flatten_iterator<Plies::iterator, clause_iterator, Begin, End> iterator;
-
-    ClausesWithTerm(const Grounder* owner, Term t, Plies::Policy policy) : owner(owner), plies(owner, policy), t(t) {}
-
-    iterator begin() const { return iterator(plies.begin(), plies.end(), Begin(t, cs.end()), End(t, cs.end())); }
-    iterator end()   const { return iterator(plies.end(), plies.end(), Begin(t, cs.end()), End(t, cs.end())); }
-
-   private:
-    const Grounder* const owner;
-    const Plies plies;
-    const Term t;
-    const std::unordered_set<ClauseIndex> cs = {};
-  };
-
+  // The clauses the relevance filter retains, that is, the clauses in the
+  // components the query terms touch; see the relevance index for details.
+  // Like the split candidates, the vector is an immutable shared snapshot.
   struct RelevantClauses {
-    struct First { ClauseIndex operator()(const std::pair<ClauseIndex, bool> p) const { return p.first; } };
-    struct Second { bool operator()(const std::pair<ClauseIndex, bool> p) const { return p.second; } };
-    typedef internal::filter_iterator<std::unordered_map<ClauseIndex, bool>::const_iterator, Second> pair_iterator;
-    typedef internal::transform_iterator<pair_iterator, First> clause_iterator;
+    typedef std::vector<ClauseIndex>::const_iterator iterator;
 
-    struct Begin {
-      clause_iterator operator()(const Ply& p) const {
-        return clause_iterator(pair_iterator(p.relevant.clauses.begin(), p.relevant.clauses.end()));
-      }
-    };
-    struct End {
-      clause_iterator operator()(const Ply& p) const {
-        return clause_iterator(pair_iterator(p.relevant.clauses.end(), p.relevant.clauses.end()));
-      }
-    };
-
-    typedef internal::flatten_iterator<Plies::iterator, clause_iterator, Begin, End> iterator;
-
-    iterator begin() const { return iterator(plies.begin(), plies.end()); }
-    iterator end()   const { return iterator(plies.end(), plies.end()); }
+    iterator begin() const { return is->begin(); }
+    iterator end()   const { return is->end(); }
 
    private:
     friend class Grounder;
 
-    RelevantClauses(const Grounder* owner, Plies::Policy policy) : plies(owner, policy) {}
+    explicit RelevantClauses(std::shared_ptr<const std::vector<ClauseIndex>> is) : is(std::move(is)) {}
 
-    const Plies plies;
+    const std::shared_ptr<const std::vector<ClauseIndex>> is;
   };
 
   class Undo {
@@ -466,6 +394,64 @@ class Grounder {
 
   const Setup& setup() const { return *setup_; }
 
+  // Pre-sizes the setup and the pools for a theory with n_sorts sorts whose
+  // grounding is expected to contribute n_clauses clauses with n_literals
+  // literals to the setup. The ply containers and the grounding caches are
+  // sized by the queries, not by the theory, and are left to grow on demand.
+  void Reserve(size_t n_sorts, size_t n_clauses, size_t n_literals) {
+    name_pool_.Reserve(n_sorts);
+    var_pool_.Reserve(n_sorts);
+    pending_.reserve(pending_.size() + n_clauses);
+    setup_->Reserve(n_clauses, n_literals);
+  }
+
+  // The bytes held by the ply containers, the grounding caches, and the
+  // relevance index (see internal/memory.h for the accounting overview).
+  // The setup is reported separately by Setup::memory_bytes(); the name and
+  // variable pools are noise and not counted.
+  internal::u64 memory_bytes() const {
+    internal::u64 n = 0;
+    for (const Ply::List* plies : {&plies_, &free_plies_}) {
+      for (const Ply& p : *plies) {
+        n += p.clauses.ungrounded.capacity() * sizeof(Ungrounded<Clause>);
+        n += internal::unordered_memory_bytes(p.lhs_rhs.ungrounded);
+        n += internal::unordered_memory_bytes(p.lhs_rhs.map);
+        for (const auto& q : p.lhs_rhs.map) {
+          n += internal::unordered_memory_bytes(q.second);
+        }
+        n += internal::unordered_memory_bytes(p.relevant.ungrounded);
+        n += internal::unordered_memory_bytes(p.relevant.query_terms);
+      }
+    }
+    n += pending_.capacity() * sizeof(Clause);
+    n += internal::unordered_memory_bytes(instance_cache_);
+    for (const auto& p : instance_cache_) {
+      n += p.second.capacity() * sizeof(Clause);
+    }
+    for (const CandidateCache::RhsEntry& e : candidate_cache_.rhs) {
+      n += internal::unordered_memory_bytes(e.map);
+    }
+    n += relevance_.memory_bytes();
+    return n;
+  }
+
+  bool lazy() const { return lazy_; }
+
+  // In lazy mode, AddClause() and AddClauses() hold the clauses back
+  // symbolically; they are ground on demand when a query first needs them.
+  // Under a consistency guarantee only the clauses that are connected to the
+  // query by shared function symbols are flushed, the rest stays pending.
+  void set_lazy(bool lazy) { lazy_ = lazy; }
+
+  size_t n_threads() const { return n_threads_; }
+
+  void set_n_threads(size_t n) {
+    n_threads_ = n > 0 ? n : 1;
+    if (pool_ && pool_->size() != n_threads_) {
+      pool_ = nullptr;
+    }
+  }
+
   // 1. AddClause(c):
   // New ply.
   // Add c to ungrounded_clauses.
@@ -521,39 +507,14 @@ class Grounder {
                            InputIt last,
                            Undo* undo = nullptr,
                            const bool do_not_add_if_inconsistent = false) {
-    // Add c to ungrounded_clauses.
-    // Add new names in c to names.
-    // Add variables to vars, generate plus-names.
-    // Re-ground.
-    Ply& p = new_ply();
-    for (; first != last; ++first) {
-      Ungrounded<Clause> uc(*first);
-      assert(uc.val.well_formed());
-      uc.val.Traverse([this, &p, &uc](Term t) {
-        if (t.variable()) {
-          uc.vars.insert(t);
-        }
-        if (t.name()) {
-          if (!IsOccurringName(t)) {
-            if (IsPlusName(t)) {
-              p.names.plus_mentioned.insert(t);
-            } else {
-              p.names.mentioned.insert(t);
-            }
-          }
-        }
-        return true;
-      });
-      CreateMaxPlusNames(uc.vars, 1);
-      p.clauses.ungrounded.push_back(std::move(uc));
+    if (lazy_ && undo == nullptr && !do_not_add_if_inconsistent) {
+      // In lazy mode the clauses are held back symbolically and only ground
+      // when a query first needs them; kOk only means the clauses were
+      // accepted, any inconsistency surfaces when they are flushed.
+      pending_.insert(pending_.end(), first, last);
+      return Setup::kOk;
     }
-    CreateNewPlusNames(p.names.plus_mentioned);
-    p.do_not_add_if_inconsistent = do_not_add_if_inconsistent;
-    const Setup::Result r = Reground();
-    if (undo) {
-      *undo = Undo(this);
-    }
-    return r;
+    return GroundClauses(first, last, undo, do_not_add_if_inconsistent);
   }
 
   void PrepareForQuery(const Term t, Undo* undo = nullptr) {
@@ -565,11 +526,13 @@ class Grounder {
   }
 
   void PrepareForQuery(const Formula& phi, Undo* undo = nullptr) {
+    LIMBO_TIMERS_SCOPE(internal::Timers::kGround);
     // New ply.
     // Add new names in phi to names.
     // Add variables to vars, generate plus-names.
     // Re-ground.
     // Add f(.)=n, f(.)/=n pairs from grounded phi to lhs_rhs.
+    FlushPending(FunctionSymbolsOf(phi), relevance_filter());
     Ply& p = new_ply();
     phi.Traverse([this, &p](const Literal a) {
       Ungrounded<Literal> ua(a.pos() ? a : a.flip());
@@ -601,6 +564,7 @@ class Grounder {
   }
 
   void GuaranteeConsistency(const Formula& alpha, Undo* undo = nullptr) {
+    FlushPending(FunctionSymbolsOf(alpha), true);
     Ply& p = new_ply();
     p.relevant.filter = true;
     alpha.Traverse([this, &p](const Term t) {
@@ -616,7 +580,6 @@ class Grounder {
         p.relevant.query_terms.insert(g);
       }
     }
-    CloseRelevance();
     if (undo) {
       *undo = Undo(this);
     }
@@ -624,11 +587,13 @@ class Grounder {
 
   void GuaranteeConsistency(Term t, Undo* undo) {
     assert(t.primitive());
+    SymbolSet seed;
+    t.Traverse([&seed](const Term s) { if (s.function()) { seed.insert(s.symbol()); } return true; });
+    FlushPending(std::move(seed), true);
     Ply& p = new_ply();
     p.relevant.filter = true;
     p.relevant.ungrounded.insert(Ungrounded<Term>(t));
     p.relevant.query_terms.insert(t);
-    CloseRelevance();
     if (undo) {
       *undo = Undo(this);
     }
@@ -638,6 +603,37 @@ class Grounder {
 
   void Consolidate() { MergePlies(); }
 
+  // Releases this grounder's grip on the terms interned after the mark was
+  // taken, in preparation for Term::Factory::Backtrack(): the pooled names
+  // and variables the mark does not cover are dropped, and the instance
+  // cache is cleared wholesale, for its clauses were built from such terms
+  // (it refills on demand). Only legal once every query ply has been undone
+  // and no lazy clauses are pending; the remaining plies then reference only
+  // terms the mark covers.
+  void BacktrackTerms(const Term::Factory::Mark& mark) {
+    assert(pending_.empty());
+    name_pool_.Backtrack(mark);
+    var_pool_.Backtrack(mark);
+    instance_cache_.clear();
+    ++ply_epoch_;
+  }
+
+  // Calls f for every clause that was added with AddClause() or AddClauses()
+  // and has not been undone, in the order the clauses were added. The clauses
+  // are the original, possibly ungrounded ones, so feeding them to another
+  // Grounder reproduces this Grounder's setup up to the choice of plus-names.
+  template<typename UnaryFunction>
+  void TraverseClauses(UnaryFunction f) const {
+    for (const Ply& p : plies_) {
+      for (const Ungrounded<Clause>& u : p.clauses.ungrounded) {
+        f(u.val);
+      }
+    }
+    for (const Clause& c : pending_) {
+      f(c);
+    }
+  }
+
   Literal Variablify(Literal a) {
     assert(a.ground());
     Term::Vector ns;
@@ -653,17 +649,29 @@ class Grounder {
     }, tf_);
   }
 
-  LhsTerms lhs_terms(Plies::Policy policy = Plies::kAll) const { return LhsTerms(this, policy); }
+  LhsTerms lhs_terms(Plies::Policy policy = Plies::kAll) const { return LhsTerms(lhs_term_candidates(policy)); }
   // The additional name must not be used after RhsName's death.
-  RhsNames rhs_names(Term t, Plies::Policy policy = Plies::kAll) { return RhsNames(this, t, policy); }
-  Names names(Symbol::Sort sort, Plies::Policy policy = Plies::kAll) const { return Names(this, sort, policy); }
-
-  ClausesWithTerm clauses_with_term(Term t, Plies::Policy policy = Plies::kAll) const {
-    return ClausesWithTerm(this, t, policy);
+  RhsNames rhs_names(Term t, Plies::Policy policy = Plies::kAll) {
+    return RhsNames(this, t, rhs_name_candidates(t, policy));
   }
+  Names names(Symbol::Sort sort, Plies::Policy policy = Plies::kAll) const { return Names(this, sort, policy); }
 
   bool relevance_filter() const { return !plies_.empty() && last_ply().relevant.filter; }
-  RelevantClauses relevant_clauses(Plies::Policy policy = Plies::kAll) const { return RelevantClauses(this, policy); }
+  RelevantClauses relevant_clauses() const { return RelevantClauses(RelevantComponents().clauses); }
+
+  // The root of the connected component t belongs to, or Nothing if t does
+  // not occur in any non-unit clause (see the relevance index below).
+  internal::Maybe<size_t> component_of(Term t) const { return relevance_.Find(t); }
+
+  // Calls f once per connected component the query terms touch, with the
+  // component's root and its clause indices. Unit clauses are not indexed;
+  // they are in Setup::units().
+  template<typename UnaryFunction>
+  void TraverseRelevantComponents(UnaryFunction f) const {
+    for (const size_t r : RelevantComponents().roots) {
+      f(r, relevance_.clauses(r));
+    }
+  }
 
  private:
   template<typename T>
@@ -717,16 +725,32 @@ class Grounder {
     };
 
     struct Ground {
-      Ground(Term::Factory* tf, const T* obj, Term x, Term n) : tf_(tf), obj(obj), x(x), n(n) {}
+      Ground(Term::Factory* tf, const T* obj, Term x, Term n)
+          : tf_(tf), obj(obj), x(x), n(n), normal(SubstitutesNormally(obj)) {}
       T operator()(const typename Assignments::iterator::value_type& assignment) const {
         auto substitution = [this, &assignment](Term y) { return x == y ? internal::Just(n) : assignment(y); };
-        return obj->Substitute(substitution, tf_);
+        return normal ? SubstituteNormally(obj, substitution, tf_) : obj->Substitute(substitution, tf_);
       }
      private:
+      // Clause templates whose instances normalize by sorting alone bypass the
+      // quadratic part of Clause::Normalize(); see Clause::SubstitutesNormally().
+      // The check runs once per template, not once per instance.
+      static bool SubstitutesNormally(const Clause* c) { return c->SubstitutesNormally(); }
+      template<typename U>
+      static bool SubstitutesNormally(const U*) { return false; }
+      template<typename UnaryFunction>
+      static Clause SubstituteNormally(const Clause* c, UnaryFunction theta, Term::Factory* tf) {
+        return c->SubstituteNormally(theta, tf);
+      }
+      template<typename U, typename UnaryFunction>
+      static U SubstituteNormally(const U* o, UnaryFunction theta, Term::Factory* tf) {
+        return o->Substitute(theta, tf);
+      }
       Term::Factory* const tf_;
       const T* const obj;
       const Term x;
       const Term n;
+      const bool normal;
     };
 
     typedef internal::transform_iterator<typename Assignments::iterator, Ground> iterator;
@@ -755,12 +779,173 @@ class Grounder {
     return Groundings<T>(this, o, vars, x, n, policy);
   }
 
+  // The relevance index maintains the connected components of the ground
+  // clauses in the setup: the lhs terms of every non-unit clause are merged
+  // in a disjoint-set forest as the clause is added, and every root carries
+  // the list of clauses in its component. "Clauses connected to the query
+  // terms" is hence answered by Find() plus a walk of the component lists,
+  // with no graph traversal. Union() works by rank and does not compress
+  // paths, for compression could not be undone; instead, every change is
+  // logged in a journal so that Backtrack() restores the state at the mark
+  // taken when the ply being popped was created.
+  class RelevanceIndex {
+   public:
+    typedef size_t Root;
+
+    size_t mark() const { return journal_.size(); }
+
+    void Backtrack(size_t mark) {
+      while (journal_.size() > mark) {
+        const Entry e = journal_.back();
+        journal_.pop_back();
+        Node& p = nodes_[e.parent];
+        if (e.child == e.parent) {
+          p.clauses.pop_back();
+        } else {
+          Node& c = nodes_[e.child];
+          c.parent = e.child;
+          p.rank -= e.rank_bump;
+          p.clauses.resize(p.clauses.size() - c.clauses.size());
+        }
+      }
+    }
+
+    void AddClause(const Clause& c, ClauseIndex i) {
+      if (c.unit()) {
+        // Units may be relevant themselves, but they do not connect their
+        // neighbours, just as in the closure this index replaces.
+        return;
+      }
+      auto it = c.begin();
+      const Root r0 = NodeOf(it->lhs());
+      for (++it; it != c.end(); ++it) {
+        Union(r0, NodeOf(it->lhs()));
+      }
+      const Root r = Find(r0);
+      nodes_[r].clauses.push_back(i);
+      journal_.push_back(Entry{r, r, 0});
+    }
+
+    internal::Maybe<Root> Find(Term t) const {
+      const auto it = index_.find(t);
+      return it != index_.end() ? internal::Just(Find(it->second)) : internal::Nothing;
+    }
+
+    const std::vector<ClauseIndex>& clauses(Root r) const { return nodes_[r].clauses; }
+
+    internal::u64 memory_bytes() const {
+      internal::u64 n = internal::unordered_memory_bytes(index_);
+      n += nodes_.capacity() * sizeof(Node);
+      for (const Node& node : nodes_) {
+        n += node.clauses.capacity() * sizeof(ClauseIndex);
+      }
+      n += journal_.capacity() * sizeof(Entry);
+      return n;
+    }
+
+   private:
+    struct Node {
+      Root parent;
+      size_t rank = 0;
+      std::vector<ClauseIndex> clauses;
+    };
+    struct Entry {
+      Root parent;
+      Root child;  // == parent for a clause append
+      size_t rank_bump;
+    };
+
+    Root NodeOf(Term t) {
+      const auto p = index_.insert(std::make_pair(t, nodes_.size()));
+      if (p.second) {
+        nodes_.push_back(Node());
+        nodes_.back().parent = nodes_.size() - 1;
+      }
+      return p.first->second;
+    }
+
+    Root Find(Root r) const {
+      while (nodes_[r].parent != r) {
+        r = nodes_[r].parent;
+      }
+      return r;
+    }
+
+    void Union(Root a, Root b) {
+      a = Find(a);
+      b = Find(b);
+      if (a == b) {
+        return;
+      }
+      if (nodes_[a].rank < nodes_[b].rank) {
+        std::swap(a, b);
+      }
+      const size_t bump = nodes_[a].rank == nodes_[b].rank ? 1 : 0;
+      nodes_[b].parent = a;
+      nodes_[a].rank += bump;
+      nodes_[a].clauses.insert(nodes_[a].clauses.end(), nodes_[b].clauses.begin(), nodes_[b].clauses.end());
+      journal_.push_back(Entry{a, b, bump});
+    }
+
+    std::unordered_map<Term, Root> index_;
+    std::vector<Node> nodes_;
+    std::vector<Entry> journal_;
+  };
+
+  struct RelevanceCache {
+    size_t epoch = 0;
+    size_t mark = 0;
+    size_t n_query_terms = 0;
+    std::unordered_set<RelevanceIndex::Root> roots;
+    std::shared_ptr<const std::vector<ClauseIndex>> clauses;
+  };
+
+  // The components the query terms of all consistency-guarantee plies touch,
+  // together with the flattened list of their clauses. The result is cached
+  // and re-used until a ply push or pop, a newly indexed clause, or a new
+  // query term invalidates it.
+  const RelevanceCache& RelevantComponents() const {
+    size_t n_query_terms = 0;
+    for (auto it = plies_.rbegin(); it != plies_.rend() && it->relevant.filter; ++it) {
+      n_query_terms += it->relevant.query_terms.size();
+    }
+    RelevanceCache& c = relevance_cache_;
+    if (c.epoch != ply_epoch_ || c.mark != relevance_.mark() || c.n_query_terms != n_query_terms || !c.clauses) {
+      c.roots.clear();
+      const auto is = std::make_shared<std::vector<ClauseIndex>>();
+      for (auto it = plies_.rbegin(); it != plies_.rend() && it->relevant.filter; ++it) {
+        for (const Term t : it->relevant.query_terms) {
+          const internal::Maybe<RelevanceIndex::Root> r = relevance_.Find(t);
+          if (r && c.roots.insert(r.val).second) {
+            const std::vector<ClauseIndex>& is2 = relevance_.clauses(r.val);
+            is->insert(is->end(), is2.begin(), is2.end());
+          }
+        }
+      }
+      c.clauses = is;
+      c.epoch = ply_epoch_;
+      c.mark = relevance_.mark();
+      c.n_query_terms = n_query_terms;
+    }
+    return c;
+  }
+
+  // Plies are recycled through free_plies_, like the name pool recycles
+  // names: a popped ply keeps its containers' capacity, so a steady-state
+  // query/undo cycle does not touch the allocator. std::list::splice moves
+  // the nodes without allocating.
   Ply& new_ply() {
+    ++ply_epoch_;
     const bool filter = relevance_filter();
-    plies_.push_back(Ply());
+    if (free_plies_.empty()) {
+      plies_.push_back(Ply());
+    } else {
+      plies_.splice(plies_.end(), free_plies_, free_plies_.begin());
+    }
     Ply& p = plies_.back();
     p.clauses.shallow_setup = setup_->shallow_copy();
     p.relevant.filter = filter;
+    p.relevant.mark = relevance_.mark();
     return p;
   }
 
@@ -771,14 +956,68 @@ class Grounder {
 
   void pop_ply() {
     assert(!plies_.empty());
+    ++ply_epoch_;
     Ply& p = last_ply();
+    relevance_.Backtrack(p.relevant.mark);
     for (const Term n : p.names.plus_max) {
       name_pool_.Return(n);
     }
     for (const Term n : p.names.plus_new) {
       name_pool_.Return(n);
     }
-    plies_.pop_back();
+    p.Reset();
+    free_plies_.splice(free_plies_.begin(), plies_, std::prev(plies_.end()));
+  }
+
+  // The solver's split recursion walks the split-term and split-name
+  // candidates at every level, so the per-ply lhs-rhs maps are flattened and
+  // deduplicated into plain vectors once per (policy, ply-epoch) -- the epoch
+  // changes when a ply is pushed, popped, or merged -- and each recursion
+  // level then scans a contiguous array. Since a split pushes plies, and thus
+  // refreshes the cache while outer levels still iterate, the vectors are
+  // immutable and shared rather than rebuilt in place.
+  CandidateVector lhs_term_candidates(Plies::Policy policy) const {
+    CandidateCache::LhsEntry& c = candidate_cache_.lhs[policy];
+    if (c.epoch != ply_epoch_) {
+      const auto ts = std::make_shared<Term::Vector>();
+      std::unordered_set<Term> seen;
+      for (const Ply& p : plies(policy)) {
+        for (const auto& lhs_rhs : p.lhs_rhs.map) {
+          const Term t = lhs_rhs.first;
+          if (IsRelevantTerm(t) && seen.insert(t).second) {
+            ts->push_back(t);
+          }
+        }
+      }
+      c.terms = ts;
+      c.epoch = ply_epoch_;
+    }
+    return c.terms;
+  }
+
+  CandidateVector rhs_name_candidates(Term t, Plies::Policy policy) const {
+    CandidateCache::RhsEntry& c = candidate_cache_.rhs[policy];
+    if (c.epoch != ply_epoch_) {
+      c.map.clear();
+      c.epoch = ply_epoch_;
+    }
+    auto it = c.map.find(t);
+    if (it == c.map.end()) {
+      const auto ns = std::make_shared<Term::Vector>();
+      std::unordered_set<Term> seen;
+      for (const Ply& p : plies(policy)) {
+        const auto jt = p.lhs_rhs.map.find(t);
+        if (jt != p.lhs_rhs.map.end()) {
+          for (const Term n : jt->second) {
+            if (seen.insert(n).second) {
+              ns->push_back(n);
+            }
+          }
+        }
+      }
+      it = c.map.insert(std::make_pair(t, CandidateVector(ns))).first;
+    }
+    return it->second;
   }
 
   bool IsUngroundedLhsRhs(const Ungrounded<Literal>& ua, Plies::Policy policy) const {
@@ -824,46 +1063,10 @@ class Grounder {
     if (!relevance_filter()) {
       return true;
     }
-    const Setup& s = *setup_;
-    for (const ClauseIndex i : clauses_with_term(t)) {
-      const internal::Maybe<Clause> c = s.clause(i);
-      if (c && c.val.MentionsLhs(t) && IsRelevantClause(i)) {
-        return true;
-      }
-    }
-    return false;
-  }
-
-  bool IsImmediatelyRelevantClause(const Clause& c) const {
-    if (!relevance_filter()) {
-      return true;
-    }
-    for (const Literal a : c) {
-      if (IsImmediatelyRelevantTerm(a.lhs())) {
-        return true;
-      }
-    }
-    return false;
+    const internal::Maybe<RelevanceIndex::Root> r = relevance_.Find(t);
+    return r && RelevantComponents().roots.count(r.val) > 0;
   }
 
-  bool IsRelevantClause(ClauseIndex i) const {
-    if (!relevance_filter()) {
-      return true;
-    }
-    for (auto it = plies_.rbegin(); it != plies_.rend(); ++it) {
-      const Ply& p = *it;
-      if (!p.relevant.filter) {
-        return false;
-      }
-      auto jt = p.relevant.clauses.find(i);
-      if (jt != p.relevant.clauses.end()) {
-        return jt->second;
-      }
-    }
-    return false;
-  }
-
-
   size_t nMaxPlusNames(Symbol::Sort sort) const {
     size_t n_names = 0;
     for (const Ply& p : plies_) {
@@ -892,6 +1095,19 @@ class Grounder {
     return false;
   }
 
+  // True iff the last ply added no name to the universe. Re-grounding the
+  // old plies only ever instantiates their variables with the new names, so
+  // in this case the old plies need not be revisited at all. Ground queries
+  // and clauses over already-occurring names hit this fast path -- always in
+  // the propositional case, where every function is 0-ary and all clauses
+  // and queries are ground -- and then a query costs time proportional to
+  // the query rather than to the knowledge base.
+  bool NoNewNames() const {
+    const Ply& p = last_ply();
+    return p.names.mentioned.all_empty() && p.names.plus_max.all_empty() &&
+           p.names.plus_new.all_empty() && p.names.plus_mentioned.all_empty();
+  }
+
   void CreateMaxPlusNames(const Formula::SortCount& sc) {
     Ply& p = last_ply();
     for (const Symbol::Sort sort : sc.keys()) {
@@ -929,15 +1145,10 @@ class Grounder {
     }
   }
 
-  void UpdateWithTerm(const Clause& c, ClauseIndex i) {
+  void UpdateRelevance(const Clause& c, ClauseIndex i) {
     assert(c.ground());
     assert(c.primitive());
-    Ply& p = last_ply();
-    for (const Literal a : c) {
-      const Term t = a.lhs();
-      assert(t.primitive());
-      p.clauses.with_term[t].insert(i);
-    }
+    relevance_.AddClause(c, i);
   }
 
   void UpdateLhsRhs(Literal a) {
@@ -965,130 +1176,6 @@ class Grounder {
     }
   }
 
-  template<typename UnaryPredicate>
-  void TraverseConnected(const ClauseIndex i, UnaryPredicate visit) const {
-    std::unordered_map<ClauseIndex, internal::Maybe<Clause>> q;
-    const Setup& s = *setup_;
-    {
-      const internal::Maybe<Clause> c = s.clause(i);
-      if (c) {
-        q[i] = c;
-      }
-    }
-    while (!q.empty()) {
-      const auto p = *q.begin();
-      q.erase(q.begin());
-      const ClauseIndex i = p.first;
-      const internal::Maybe<Clause>& c = p.second;
-      if (visit(i, c)) {
-        for (const Literal a : c.val) {
-          const Term t = a.lhs();
-          for (const ClauseIndex j : clauses_with_term(t)) {
-            if (c && q.count(j) == 0 && c.val.MentionsLhs(t)) {
-              q[j] = s.clause(j);
-            }
-          }
-        }
-      }
-    }
-  }
-
-  void MarkAsRelevant(const ClauseIndex i) {
-    std::unordered_set<ClauseIndex> connected;
-    bool relevant = true;
-    TraverseConnected(i, [this, &connected, &relevant](const ClauseIndex i, const internal::Maybe<Clause>& c) {
-      if (!c || c.val.unit() || connected.count(i) > 0) {
-        return false;
-      }
-      if (c && IsRelevantClause(i)) {
-        return false;
-      }
-      connected.insert(i);
-      return true;
-    });
-    Ply& p = last_ply();
-    for (const ClauseIndex i : connected) {
-      p.relevant.clauses[i] = true;
-    }
-  }
-
-  void MarkIfRelevant(const ClauseIndex i) {
-    std::unordered_set<ClauseIndex> connected;
-    bool relevant = false;
-    TraverseConnected(i, [this, &connected, &relevant](const ClauseIndex i, const internal::Maybe<Clause>& c) {
-      if (!c || c.val.unit() || connected.count(i) > 0) {
-        return false;
-      }
-      if (c && IsRelevantClause(i)) {
-        relevant = true;
-        return false;
-      }
-      connected.insert(i);
-      return true;
-    });
-    if (relevant) {
-      Ply& p = last_ply();
-      for (const ClauseIndex i : connected) {
-        p.relevant.clauses[i] = true;
-      }
-    }
-  }
-
-  void MarkIfIrrelevant(const ClauseIndex i) {
-    std::unordered_set<ClauseIndex> connected;
-    bool relevant = false;
-    TraverseConnected(i, [this, &connected, &relevant](const ClauseIndex i, const internal::Maybe<Clause>& c) {
-      if (connected.count(i) > 0) {
-        return false;
-      }
-      if (c && IsImmediatelyRelevantClause(c.val)) {
-        relevant = true;
-        return false;
-      }
-      connected.insert(i);
-      return true;
-    });
-    if (!relevant) {
-      Ply& p = last_ply();
-      for (const ClauseIndex i : connected) {
-        p.relevant.clauses[i] = false;
-      }
-    }
-  }
-
-  void CloseRelevance() {
-    Ply& p = last_ply();
-    assert(p.relevant.filter);
-    const Setup& s = *setup_;
-    // When there are new relevant terms or new clauses, we need to explore
-    // their neighborhood and look for a relevant clause among the connected
-    // ones.
-    for (Term t : p.relevant.query_terms) {
-      for (ClauseIndex i : clauses_with_term(t)) {
-        if (!IsRelevantClause(i)) {
-          MarkAsRelevant(i);
-        }
-      }
-    }
-    for (ClauseIndex i : p.clauses.shallow_setup.new_clauses()) {
-      if (!IsRelevantClause(i)) {
-        MarkIfRelevant(i);
-      }
-    }
-    // When there are new unit clauses, we have to check all clauses that
-    // previously contained one of the unit terms for irrelevance.
-    for (ClauseIndex i : p.clauses.shallow_setup.new_units()) {
-      const internal::Maybe<Clause> c = s.clause(i);
-      assert(!c || c.val.unit());
-      if (c) {
-        const Term t = c.val.first().lhs();
-        for (ClauseIndex i : clauses_with_term(t)) {
-          MarkIfIrrelevant(i);
-        }
-      }
-    }
-  }
-
   bool InconsistencyCheck(const Ply& p, const Clause& c) {
     return !p.do_not_add_if_inconsistent || !c.unit() || !setup_->Subsumes(Clause{c[0].flip()});
   }
@@ -1114,15 +1201,17 @@ class Grounder {
   void ForEachNewGrounding(UnaryFunction range, UnaryPredicate pred, Setup::Result* add_result = nullptr) {
     typedef decltype(range(std::declval<Ply>()).begin()) iterator;
     typedef typename iterator::value_type::value_type value_type;
-    for (const Ply& p : plies(Plies::kOld)) {
-      for (const Ungrounded<value_type>& u : range(p)) {
-        for (const Term x : u.vars) {
-          for (const Term n : names(x.sort(), Plies::kNew)) {
-            for (const value_type& g : groundings(&u.val, &u.vars, x, n)) {
-              assert(g.ground());
-              pred(g, p, add_result);
-              if (add_result && *add_result == Setup::kInconsistent) {
-                return;
+    if (!NoNewNames()) {
+      for (const Ply& p : plies(Plies::kOld)) {
+        for (const Ungrounded<value_type>& u : range(p)) {
+          for (const Term x : u.vars) {
+            for (const Term n : names(x.sort(), Plies::kNew)) {
+              for (const value_type& g : groundings(&u.val, &u.vars, x, n)) {
+                assert(g.ground());
+                pred(g, p, add_result);
+                if (add_result && *add_result == Setup::kInconsistent) {
+                  return;
+                }
               }
             }
           }
@@ -1140,6 +1229,250 @@ class Grounder {
     }
   }
 
+  template<typename InputIt>
+  Setup::Result GroundClauses(InputIt first,
+                              InputIt last,
+                              Undo* undo,
+                              const bool do_not_add_if_inconsistent) {
+    // Add c to ungrounded_clauses.
+    // Add new names in c to names.
+    // Add variables to vars, generate plus-names.
+    // Re-ground.
+    Ply& p = new_ply();
+    for (; first != last; ++first) {
+      Ungrounded<Clause> uc(*first);
+      assert(uc.val.well_formed());
+      uc.val.Traverse([this, &p, &uc](Term t) {
+        if (t.variable()) {
+          uc.vars.insert(t);
+        }
+        if (t.name()) {
+          if (!IsOccurringName(t)) {
+            if (IsPlusName(t)) {
+              p.names.plus_mentioned.insert(t);
+            } else {
+              p.names.mentioned.insert(t);
+            }
+          }
+        }
+        return true;
+      });
+      CreateMaxPlusNames(uc.vars, 1);
+      p.clauses.ungrounded.push_back(std::move(uc));
+    }
+    CreateNewPlusNames(p.names.plus_mentioned);
+    p.do_not_add_if_inconsistent = do_not_add_if_inconsistent;
+    const Setup::Result r = Reground();
+    if (undo) {
+      *undo = Undo(this);
+    }
+    return r;
+  }
+
+  static SymbolSet FunctionSymbolsOf(const Clause& c) {
+    SymbolSet ss;
+    c.Traverse([&ss](const Term t) { if (t.function()) { ss.insert(t.symbol()); } return true; });
+    return ss;
+  }
+
+  static SymbolSet FunctionSymbolsOf(const Formula& phi) {
+    SymbolSet ss;
+    phi.Traverse([&ss](const Term t) { if (t.function()) { ss.insert(t.symbol()); } return true; });
+    return ss;
+  }
+
+  // Grounds the clauses held back in lazy mode. Without a relevance filter
+  // every pending clause is flushed, for dropping clauses is only sound under
+  // a consistency guarantee. With a filter, a pending clause is flushed iff
+  // it is connected to the query by a chain of shared function symbols --
+  // through pending as well as already-added clauses -- which
+  // over-approximates the component connectivity the relevance index tracks
+  // on the ground level; the remaining clauses stay pending for later queries.
+  // The flushed clauses form an ordinary ply that is not covered by the
+  // query's Undo, just as if they had been added eagerly before the query.
+  void FlushPending(SymbolSet seed, bool relevant_only) {
+    if (pending_.empty()) {
+      return;
+    }
+    std::vector<Clause> flush;
+    if (relevant_only) {
+      const size_t none = pending_.size();
+      struct Entry {
+        SymbolSet symbols;
+        size_t pending_index;
+      };
+      std::vector<Entry> entries;
+      for (size_t i = 0; i < pending_.size(); ++i) {
+        entries.push_back(Entry{FunctionSymbolsOf(pending_[i]), i});
+      }
+      for (const Ply& p : plies_) {
+        for (const Ungrounded<Clause>& u : p.clauses.ungrounded) {
+          entries.push_back(Entry{FunctionSymbolsOf(u.val), none});
+        }
+      }
+      std::vector<bool> done(entries.size(), false);
+      std::vector<bool> selected(pending_.size(), false);
+      for (bool changed = true; changed; ) {
+        changed = false;
+        for (size_t e = 0; e < entries.size(); ++e) {
+          if (done[e]) {
+            continue;
+          }
+          const bool hit = std::any_of(entries[e].symbols.begin(), entries[e].symbols.end(),
+                                       [&seed](Symbol s) { return seed.count(s) > 0; });
+          if (hit) {
+            seed.insert(entries[e].symbols.begin(), entries[e].symbols.end());
+            done[e] = true;
+            if (entries[e].pending_index != none) {
+              selected[entries[e].pending_index] = true;
+            }
+            changed = true;
+          }
+        }
+      }
+      std::vector<Clause> rest;
+      for (size_t i = 0; i < pending_.size(); ++i) {
+        (selected[i] ? flush : rest).push_back(pending_[i]);
+      }
+      pending_ = std::move(rest);
+    } else {
+      flush = std::move(pending_);
+      pending_.clear();
+    }
+    if (!flush.empty()) {
+      GroundClauses(flush.begin(), flush.end(), nullptr, false);
+    }
+  }
+
+  // A key of the ground-instance cache: an ungrounded clause, a single
+  // (variable, name) substitution, and the name universe over which the
+  // remaining variables range. Like in the solver's split cache, the universe
+  // is identified by its hash; the clause itself is compared by value.
+  struct InstanceCacheKey {
+    struct Hash {
+      internal::hash64_t operator()(const InstanceCacheKey& k) const {
+        return k.clause.hash() ^ internal::splitmix64_hash(k.names) ^ k.x.hash() ^ internal::splitmix64_hash(k.n.hash());
+      }
+    };
+
+    bool operator==(const InstanceCacheKey& k) const {
+      return names == k.names && x == k.x && n == k.n && clause == k.clause;
+    }
+    bool operator!=(const InstanceCacheKey& k) const { return !(*this == k); }
+
+    Clause clause;
+    internal::hash64_t names;
+    Term x;
+    Term n;
+  };
+
+  // An order-independent hash of all names currently in the universe. Two
+  // regroundings produce the same instances when their universes coincide,
+  // which happens regularly for repeated queries because pop_ply() returns
+  // plus-names to the pool for re-use by the next query.
+  internal::hash64_t NameUniverseHash() const {
+    internal::hash64_t h = 0;
+    for (const Ply& p : plies_) {
+      for (const Term n : p.names.mentioned) { h ^= internal::splitmix64_hash(n.hash()); }
+      for (const Term n : p.names.plus_max)  { h ^= internal::splitmix64_hash(n.hash()); }
+      for (const Term n : p.names.plus_new)  { h ^= internal::splitmix64_hash(n.hash()); }
+    }
+    return h;
+  }
+
+  // Grounds the added clauses for the new names (and the new clauses for all
+  // names) like ForEachNewGrounding() does, with two twists.
+  //
+  // First, the instances of an old clause are cached under the clause, the
+  // substitution, and the name universe, so a later query that re-creates the
+  // same names reuses the already-normalized instances instead of re-running
+  // the substitution. The cache deliberately survives UndoLast(): that is
+  // what makes the next query over the same terms cheap. Instances of the
+  // last ply's own clauses are not cached, for a knowledge base clause is
+  // ground in full only once.
+  //
+  // Second, when more than one thread is configured, the instances are
+  // constructed by the worker pool into per-job buffers; the workers share
+  // only the term factory, which is internally synchronized. In either case
+  // the instances are fed to pred in job order, so the setup is written only
+  // by this thread and insertion is deterministic. An inconsistency stops
+  // the drain, at the price of some wasted grounding work.
+  template<typename UnaryPredicate>
+  void GroundNewClauses(UnaryPredicate pred, Setup::Result* add_result) {
+    struct Job {
+      const Ply* ply;
+      const Ungrounded<Clause>* clause;
+      Term x;
+      Term n;
+      std::vector<Clause>* cached;
+      bool ground;
+      std::vector<Clause> buf;
+    };
+    std::vector<Job> jobs;
+    if (!NoNewNames()) {
+      const internal::hash64_t nh = NameUniverseHash();
+      if (instance_cache_.size() > kMaxInstanceCacheSize) {
+        // Entries for other name universes stem from queries with other
+        // relevant terms or from growing the knowledge base; they are evicted
+        // only when the cache grows too large so that alternating query shapes
+        // keep their entries.
+        for (auto it = instance_cache_.begin(); it != instance_cache_.end(); ) {
+          it = it->first.names != nh ? instance_cache_.erase(it) : std::next(it);
+        }
+      }
+      for (const Ply& q : plies(Plies::kOld)) {
+        for (const Ungrounded<Clause>& u : q.clauses.ungrounded) {
+          for (const Term x : u.vars) {
+            for (const Term n : names(x.sort(), Plies::kNew)) {
+              const auto p = instance_cache_.emplace(InstanceCacheKey{u.val, nh, x, n}, std::vector<Clause>());
+              jobs.push_back(Job{&q, &u, x, n, &p.first->second, p.second, std::vector<Clause>()});
+            }
+          }
+        }
+      }
+    }
+    for (const Ungrounded<Clause>& u : last_ply().clauses.ungrounded) {
+      jobs.push_back(Job{&last_ply(), &u, Term(), Term(), nullptr, true, std::vector<Clause>()});
+    }
+    const auto ground = [this](Job* job) {
+      std::vector<Clause>* out = job->cached != nullptr ? job->cached : &job->buf;
+      for (const Clause& g : groundings(&job->clause->val, &job->clause->vars, job->x, job->n)) {
+        assert(g.ground());
+        out->push_back(g);
+      }
+    };
+    if (n_threads_ > 1 && !jobs.empty()) {
+      if (!pool_) {
+        pool_ = std::unique_ptr<internal::ThreadPool>(new internal::ThreadPool(n_threads_));
+      }
+      std::atomic<size_t> next(0);
+      for (size_t i = 0; i < pool_->size(); ++i) {
+        pool_->Submit([&jobs, &next, &ground]() {
+          for (size_t j = next++; j < jobs.size(); j = next++) {
+            if (jobs[j].ground) {
+              ground(&jobs[j]);
+            }
+          }
+        });
+      }
+      pool_->Wait();
+    } else {
+      for (Job& job : jobs) {
+        if (job.ground) {
+          ground(&job);
+        }
+      }
+    }
+    for (const Job& job : jobs) {
+      for (const Clause& g : (job.cached != nullptr ? *job.cached : job.buf)) {
+        pred(g, *job.ply, add_result);
+        if (add_result && *add_result == Setup::kInconsistent) {
+          return;
+        }
+      }
+    }
+  }
+
   static void update_result(Setup::Result* add_result, Setup::Result r) {
     if (add_result) {
       switch (r) {
@@ -1164,15 +1497,13 @@ class Grounder {
     Setup::Result add_result = Setup::kSubsumed;
     Ply& p = last_ply();
     Setup& s = *setup_;
-    ForEachNewGrounding(
-        [](const Ply& p) -> auto& { return p.clauses.ungrounded; },
-        [this, &s](const Clause& c, const Ply& p, Setup::Result* add_result) {
-          if (!c.valid() && InconsistencyCheck(p, c)) {
-            const Setup::Result r = s.AddClause(c);
-            update_result(add_result, r);
-          }
-        },
-        &add_result);
+    const auto add = [this, &s](const Clause& c, const Ply& p, Setup::Result* add_result) {
+      if (!c.valid() && InconsistencyCheck(p, c)) {
+        const Setup::Result r = s.AddClause(c);
+        update_result(add_result, r);
+      }
+    };
+    GroundNewClauses(add, &add_result);
     if (add_result == Setup::kInconsistent) {
       return add_result;
     }
@@ -1185,7 +1516,7 @@ class Grounder {
       const internal::Maybe<Clause> c = s.clause(i);
       if (c) {
         UpdateLhsRhs(c.val);
-        UpdateWithTerm(c.val, i);
+        UpdateRelevance(c.val, i);
       }
     }
     ForEachNewGrounding(
@@ -1199,7 +1530,6 @@ class Grounder {
           [this](const Term t, const Ply&, Setup::Result*) {
             UpdateImmediatelyRelevantTerm(t);
           });
-      CloseRelevance();
     }
     return add_result;
   }
@@ -1215,8 +1545,6 @@ class Grounder {
       it->clauses.shallow_setup.Immortalize();
       std::move(it->clauses.ungrounded.begin(), it->clauses.ungrounded.end(),
                 std::inserter(p->clauses.ungrounded, p->clauses.ungrounded.end()));
-      std::move(it->clauses.with_term.begin(), it->clauses.with_term.end(),
-                std::inserter(p->clauses.with_term, p->clauses.with_term.end()));
       p->names.mentioned.insert(it->names.mentioned);
       p->names.plus_max.insert(it->names.plus_max);
       p->names.plus_new.insert(it->names.plus_new);
@@ -1224,8 +1552,6 @@ class Grounder {
       p->relevant.filter |= it->relevant.filter;
       std::move(it->relevant.ungrounded.begin(), it->relevant.ungrounded.end(),
                 std::inserter(p->relevant.ungrounded, p->relevant.ungrounded.end()));
-      std::move(it->relevant.clauses.begin(), it->relevant.clauses.end(),
-                std::inserter(p->relevant.clauses, p->relevant.clauses.end()));
       std::move(it->lhs_rhs.ungrounded.begin(), it->lhs_rhs.ungrounded.end(),
                 std::inserter(p->lhs_rhs.ungrounded, p->lhs_rhs.ungrounded.end()));
       for (auto& lhs_rhs : it->lhs_rhs.map) {
@@ -1241,20 +1567,46 @@ class Grounder {
     if (minimize) {
       p->clauses.full_setup->Minimize();
       p->clauses.shallow_setup = p->clauses.full_setup->shallow_copy();
-      // TODO re-compute p->relevant.clauses and p->clauses.with_term, for the indices may have changed
+      // TODO re-compute the relevance index, for the indices may have changed
     }
 #endif
 
     plies_.erase(plies_.begin(), p);
     plies_.erase(std::next(p), plies_.end());
     assert(plies_.size() == 1);
+    ++ply_epoch_;
   }
 
+  struct CandidateCache {
+    struct LhsEntry {
+      size_t epoch = 0;
+      CandidateVector terms;
+    };
+    struct RhsEntry {
+      size_t epoch = 0;
+      std::unordered_map<Term, CandidateVector> map;
+    };
+    LhsEntry lhs[3];
+    RhsEntry rhs[3];
+  };
+
   Term::Factory* const tf_;
   NamePool name_pool_;
   VariablePool var_pool_;
   Ply::List plies_;
+  Ply::List free_plies_;
   std::unique_ptr<Setup> setup_;
+  static constexpr size_t kMaxInstanceCacheSize = size_t(1) << 16;
+
+  size_t n_threads_ = 1;
+  std::unique_ptr<internal::ThreadPool> pool_;
+  std::unordered_map<InstanceCacheKey, std::vector<Clause>, InstanceCacheKey::Hash> instance_cache_;
+  size_t ply_epoch_ = 1;
+  mutable CandidateCache candidate_cache_;
+  RelevanceIndex relevance_;
+  mutable RelevanceCache relevance_cache_;
+  bool lazy_ = false;
+  std::vector<Clause> pending_;
 };
 
 }  // namespace limbo
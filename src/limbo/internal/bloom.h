@@ -9,21 +9,33 @@
 // This implementation is designed for small sets and specifically intended
 // for clauses.
 //
-// Let m = 64 the size of the bitmask.
+// Let m = 256 the size of the bitmask.
 // Let k be the number of hash functions.
 // Let n be the expected number of entries.
 //
-// The optimal n for given m and k is (m / n) * ln 2. (Says Wikipedia.)
+// The optimal k for given m and n is (m / n) * ln 2. (Says Wikipedia.)
 //
 // Supposing most clauses don't have more than 10 entries, 4 or 5 hash
 // functions should be fine.
 //
-// We take the byte pairs 1,2 and 3,4 and 5,6 and 7,8 and consider the 16bit
-// number formed by each of them as a single hash.
+// We take the bytes 1, 2, 3, 4 of the hash and consider the 8bit number
+// formed by each of them as a single hash, that is, as the index of a bit
+// in the mask.
+//
+// The mask is stored as four 64 bit words, so Union(), Intersect(), Subset(),
+// and Overlap() are single 256 bit vector operations when the compiler is
+// invoked with AVX2 (see the commented flags in the top-level CMakeLists.txt)
+// and pairs of 128 bit operations under WASM SIMD.
 
 #ifndef LIMBO_INTERNAL_BLOOM_H_
 #define LIMBO_INTERNAL_BLOOM_H_
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
 #include <functional>
 
 #include <limbo/internal/hash.h>
@@ -36,38 +48,104 @@ class BloomFilter {
  public:
   BloomFilter() = default;
 
-  static BloomFilter Union(const BloomFilter a, const BloomFilter b)        { return BloomFilter(a.mask_ | b.mask_); }
-  static BloomFilter Intersection(const BloomFilter a, const BloomFilter b) { return BloomFilter(a.mask_ & b.mask_); }
+  static BloomFilter Union(const BloomFilter a, const BloomFilter b) {
+    BloomFilter c;
+    for (size_t i = 0; i < kWords; ++i) {
+      c.mask_[i] = a.mask_[i] | b.mask_[i];
+    }
+    return c;
+  }
+
+  static BloomFilter Intersection(const BloomFilter a, const BloomFilter b) {
+    BloomFilter c;
+    for (size_t i = 0; i < kWords; ++i) {
+      c.mask_[i] = a.mask_[i] & b.mask_[i];
+    }
+    return c;
+  }
 
-  bool operator==(const BloomFilter b) const { return mask_ == b.mask_; }
+  bool operator==(const BloomFilter b) const {
+    word_t neq = 0;
+    for (size_t i = 0; i < kWords; ++i) {
+      neq |= mask_[i] ^ b.mask_[i];
+    }
+    return neq == 0;
+  }
   bool operator!=(const BloomFilter b) const { return !(*this == b); }
 
-  void Clear() { mask_ = 0; }
+  void Clear() {
+    for (size_t i = 0; i < kWords; ++i) {
+      mask_[i] = 0;
+    }
+  }
 
   template<typename HashType>
   void Add(const HashType x) {
-    mask_ |= (static_cast<mask_t>(1) << index<0>(x))
-          |  (static_cast<mask_t>(1) << index<1>(x))
-          |  (static_cast<mask_t>(1) << index<2>(x))
-          |  (static_cast<mask_t>(1) << index<3>(x));
+    set(index<0>(x));
+    set(index<1>(x));
+    set(index<2>(x));
+    set(index<3>(x));
   }
 
   template<typename HashType>
   bool Contains(const HashType x) const {
-    return (( (mask_ >> index<0>(x))
-            & (mask_ >> index<1>(x))
-            & (mask_ >> index<2>(x))
-            & (mask_ >> index<3>(x))) & static_cast<mask_t>(1)) != 0;
+    return test(index<0>(x)) && test(index<1>(x)) && test(index<2>(x)) && test(index<3>(x));
+  }
+
+  void Union(const BloomFilter& b) {
+    for (size_t i = 0; i < kWords; ++i) {
+      mask_[i] |= b.mask_[i];
+    }
   }
 
-  void Union(const BloomFilter& b)     { mask_ |= b.mask_; }
-  void Intersect(const BloomFilter& b) { mask_ &= b.mask_; }
+  void Intersect(const BloomFilter& b) {
+    for (size_t i = 0; i < kWords; ++i) {
+      mask_[i] &= b.mask_[i];
+    }
+  }
 
   bool SubsetOf(const BloomFilter& b) const { return Subset(*this, b); }
   bool Overlaps(const BloomFilter& b) const { return Overlap(*this, b); }
 
-  static bool Subset(const BloomFilter& a, const BloomFilter& b)  { return ~(~a.mask_ | b.mask_) == 0; }
-  static bool Overlap(const BloomFilter& a, const BloomFilter& b) { return (a.mask_ & b.mask_) != 0; }
+  static bool Subset(const BloomFilter& a, const BloomFilter& b) {
+#if defined(__AVX2__)
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.mask_));
+    const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.mask_));
+    return _mm256_testc_si256(y, x) != 0;
+#elif defined(__wasm_simd128__)
+    const v128_t x0 = wasm_v128_load(a.mask_);
+    const v128_t x1 = wasm_v128_load(a.mask_ + 2);
+    const v128_t y0 = wasm_v128_load(b.mask_);
+    const v128_t y1 = wasm_v128_load(b.mask_ + 2);
+    return !wasm_v128_any_true(wasm_v128_or(wasm_v128_andnot(x0, y0), wasm_v128_andnot(x1, y1)));
+#else
+    word_t left_over = 0;
+    for (size_t i = 0; i < kWords; ++i) {
+      left_over |= a.mask_[i] & ~b.mask_[i];
+    }
+    return left_over == 0;
+#endif
+  }
+
+  static bool Overlap(const BloomFilter& a, const BloomFilter& b) {
+#if defined(__AVX2__)
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.mask_));
+    const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.mask_));
+    return _mm256_testz_si256(x, y) == 0;
+#elif defined(__wasm_simd128__)
+    const v128_t x0 = wasm_v128_load(a.mask_);
+    const v128_t x1 = wasm_v128_load(a.mask_ + 2);
+    const v128_t y0 = wasm_v128_load(b.mask_);
+    const v128_t y1 = wasm_v128_load(b.mask_ + 2);
+    return wasm_v128_any_true(wasm_v128_or(wasm_v128_and(x0, y0), wasm_v128_and(x1, y1)));
+#else
+    word_t common = 0;
+    for (size_t i = 0; i < kWords; ++i) {
+      common |= a.mask_[i] & b.mask_[i];
+    }
+    return common != 0;
+#endif
+  }
 
  private:
 #ifdef FRIEND_TEST
@@ -75,31 +153,29 @@ class BloomFilter {
 #endif
 
   typedef internal::u64 bit_index_t;
-  typedef internal::u64 mask_t;
+  typedef internal::u64 word_t;
 
-  explicit BloomFilter(const mask_t& mask) : mask_(mask) {}
+  static constexpr size_t kWords = 4;
+  static constexpr size_t kBits = kWords * sizeof(word_t) * 8;
 
   template<size_t I, typename HashType>
   static bit_index_t index(HashType x) {
     // index() should slice the original HashType x into several bit_index_t,
-    // whose range shall be [0 ... bits(mask_t) - 1], that is, the indices
-    // of the bits in mask_t.
-    //
-    // When mask_t is a 64 bit integer, we just need log_2(64) = 6 bits for
-    // an index. So we can do is take the Ith byte and return its value
-    // modulo 64, which then gives a hash in the range [0 ... 63]:
-    //
-    // return ((x >> (I*8)) & 0xFF) % (sizeof(mask_t) * 8);
+    // whose range shall be [0 ... kBits - 1], that is, the indices of the
+    // bits in the mask.
     //
-    // But since 63 is just binary 111111, we can simply take the six
-    // right-most bits of the byte:
-    constexpr bit_index_t kMaxIndex = 63;
+    // When the mask has 256 bits, an index is exactly one byte, so we can
+    // simply take the Ith byte of x:
+    constexpr bit_index_t kMaxIndex = kBits - 1;
     static_assert((~static_cast<HashType>(0) & kMaxIndex) != 0, "HashType does not provide enough bits");
-    static_assert((~static_cast<mask_t>(0) >> kMaxIndex) == 1, "mask does not cover mask_t indices");
+    static_assert(kBits == 256, "index scheme assumes one byte per index");
     return (x >> (I*8)) & kMaxIndex;
   }
 
-  mask_t mask_ = 0;
+  void set(bit_index_t i)        { mask_[i >> 6] |= static_cast<word_t>(1) << (i & 63); }
+  bool test(bit_index_t i) const { return ((mask_[i >> 6] >> (i & 63)) & static_cast<word_t>(1)) != 0; }
+
+  word_t mask_[kWords] = {};
 };
 
 template<typename T>
@@ -151,4 +227,3 @@ struct equal_to<limbo::internal::BloomSet<T>> {
 }  // namespace std
 
 #endif  // LIMBO_INTERNAL_BLOOM_H_
-
@@ -15,6 +15,19 @@ namespace internal {
 typedef u32 hash32_t;
 typedef u64 hash64_t;
 
+// The splitmix64 finalizer (by Sebastiano Vigna, public domain). It is a
+// bijection on u64, so distinct ids never collide in the full 64 bit hash,
+// and it mixes well enough that any subset of the output bits can be used
+// as a table index. This is the library-wide successor of jenkins_hash().
+hash64_t splitmix64_hash(u64 x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111eb;
+  x ^= x >> 31;
+  return x;
+}
+
 hash32_t jenkins_hash(u32 x) {
   x = (x + 0x7ed55d16) + (x << 12);
   x = (x ^ 0xc761c23c) ^ (x >> 19);
@@ -7,11 +7,18 @@
 // underlying array. Unset values are implicitly set to a null value, which by
 // default is T(), which amounts to 0 for integers and false for bools; the
 // value can be changed by set_null_value().
+//
+// The keys are typically sorts, of which most problems only have a handful,
+// so the map stores the first N values inline and falls back to the heap
+// only beyond that; N is a template parameter of IntMap.
 
 #ifndef LIMBO_INTERNAL_INTMAP_H_
 #define LIMBO_INTERNAL_INTMAP_H_
 
+#include <cassert>
+
 #include <algorithm>
+#include <array>
 #include <type_traits>
 #include <unordered_set>
 #include <utility>
@@ -23,10 +30,69 @@
 namespace limbo {
 namespace internal {
 
-template<typename Key, typename T>
+// A vector whose first N elements are stored inline, so that the typical
+// IntMap with just a few keys does not allocate at all. Only the subset of
+// the std::vector interface needed by IntMap is provided; resize() is the
+// only way to grow, and all elements are value-initialized.
+template<typename T, size_t N>
+class SmallVec {
+ public:
+  typedef size_t size_type;
+  typedef T value_type;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef array_iterator<SmallVec, T> iterator;
+  typedef array_iterator<const SmallVec, const T> const_iterator;
+
+  bool operator==(const SmallVec& v) const {
+    if (size_ != v.size_) {
+      return false;
+    }
+    for (size_type i = 0; i < size_; ++i) {
+      if (!((*this)[i] == v[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool operator!=(const SmallVec& v) const { return !(*this == v); }
+
+        reference operator[](size_type i)       { assert(i < size_); return i < N ? buf_[i] : rest_[i - N]; }
+  const_reference operator[](size_type i) const { assert(i < size_); return i < N ? buf_[i] : rest_[i - N]; }
+
+  void resize(size_type n, const T& val) {
+    for (size_type i = size_; i < std::min(n, N); ++i) {
+      buf_[i] = val;
+    }
+    if (n > N) {
+      rest_.resize(n - N, val);
+    } else {
+      for (size_type i = n; i < std::min(size_, N); ++i) {
+        buf_[i] = T();
+      }
+      rest_.clear();
+    }
+    size_ = n;
+  }
+
+  size_type size() const { return size_; }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end()   { return iterator(this, size_); }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end()   const { return const_iterator(this, size_); }
+
+ private:
+  std::array<T, N> buf_ = {};
+  std::vector<T> rest_;
+  size_type size_ = 0;
+};
+
+template<typename Key, typename T, size_t N = 4>
 class IntMap {
  public:
-  typedef std::vector<T> Vec;
+  typedef SmallVec<T, N> Vec;
   typedef typename Vec::value_type value_type;
   typedef typename Vec::reference reference;
   typedef typename Vec::const_reference const_reference;
@@ -50,6 +116,15 @@ class IntMap {
 
   size_t n_keys() const { return vec_.size(); }
 
+  // Pre-grows the map to cover the keys 0, ..., n-1 in one go. The growth
+  // in operator[] is per key, so a caller who knows its key space up front
+  // -- typically the number of sorts -- saves one resize per key.
+  void FitForKeys(size_t n) {
+    if (n > vec_.size()) {
+      vec_.resize(n, null_);
+    }
+  }
+
   struct Keys {
     struct Cast { Key operator()(size_t key) const { return Key(key); } };
     typedef internal::int_iterator<size_t> int_iterator;
@@ -141,6 +216,15 @@ class IntMultiMap {
     return n;
   }
 
+  // Empties all buckets but keeps their capacity, so re-use after clear()
+  // does not re-allocate.
+  void clear() {
+    for (const Key key : keys()) {
+      map_[key].clear();
+    }
+    size_ = 0;
+  }
+
   bool contains(Key key, const T& val) const {
     const Bucket& s = map_[key];
     return s.count(val) > 0;
@@ -149,6 +233,8 @@ class IntMultiMap {
   size_t n_keys() const { return map_.n_keys(); }
   size_t n_values(Key key) const { return map_[key].size(); }
 
+  void FitForKeys(size_t n) { map_.FitForKeys(n); }
+
   typedef typename Base::Keys Keys;
 
   Keys keys() const { return Keys(&map_); }
@@ -217,11 +303,15 @@ class IntMultiSet {
 
   size_t erase(const T& val) { return map_.erase(key_(val), val); }
 
+  void clear() { map_.clear(); }
+
   bool contains(const T& val) const { return map_.contains(key_(val), val); }
 
   size_t n_keys() const { return map_.n_keys(); }
   size_t n_values(Key key) const { return map_[key].size(); }
 
+  void FitForKeys(size_t n) { map_.FitForKeys(n); }
+
   typedef typename Parent::Keys Keys;
   typedef typename Parent::value_iterator value_iterator;
   typedef typename Parent::ValuesForKey ValuesForKey;
@@ -0,0 +1,75 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// Byte accounting for the reasoner's heaps, so that memory growth can be
+// attributed to a subsystem instead of bisected blindly: interned terms,
+// grounder plies, setup clauses, and the clause overflow blocks.
+//
+// Two complementary mechanisms:
+//
+//  * Allocation counters, incremented through LIMBO_MEMORY_DO() at the two
+//    allocation sites that cannot be measured after the fact -- Term::Data
+//    on interning and the Clause literal pool. Like the statistics and
+//    timers, they compile to nothing unless LIMBO_MEMORY is defined (see
+//    the corresponding option in the top-level CMakeLists.txt), they are
+//    thread-local, and differencing them around a query gives the query's
+//    allocation churn.
+//
+//  * On-demand measurement: Term::Factory, Grounder and Setup each expose
+//    a memory_bytes() method that sums the capacities of their dominant
+//    containers. These methods are always compiled, cost nothing until
+//    called, and Solver::memory_profile() bundles them with the counters
+//    into one MemoryProfile snapshot.
+
+#ifndef LIMBO_INTERNAL_MEMORY_H_
+#define LIMBO_INTERNAL_MEMORY_H_
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+struct Memory {
+  static Memory& Local() {
+    static thread_local Memory memory;
+    return memory;
+  }
+
+  void Reset() { *this = Memory(); }
+
+  u64 term_bytes_allocated = 0;    // Term::Data objects interned by Term::Factory::CreateTerm()
+  u64 term_bytes_freed = 0;        // Term::Data objects released by Term::Factory::Backtrack()
+  u64 clause_bytes_allocated = 0;  // overflow blocks taken from the heap by Clause's literal pool
+  u64 clause_bytes_freed = 0;      // overflow blocks returned to the heap by Clause's literal pool
+};
+
+struct MemoryProfile {
+  u64 term_factory_bytes = 0;  // interned Term::Data heaps
+  u64 grounder_bytes = 0;      // ply containers, caches, and pending clauses
+  u64 setup_bytes = 0;         // clause store, units, and the watcher and occurrence indexes
+  u64 clause_pool_bytes = 0;   // live overflow blocks of the calling thread; zero unless LIMBO_MEMORY
+
+  u64 total() const { return term_factory_bytes + grounder_bytes + setup_bytes + clause_pool_bytes; }
+};
+
+// Rough footprint of an unordered associative container: one bucket pointer
+// per bucket plus one node per element, where a node carries its value, a
+// chain pointer, and a cached hash (the libstdc++ layout). Nested containers
+// in the values are the caller's business.
+template<typename C>
+u64 unordered_memory_bytes(const C& c) {
+  return u64(c.bucket_count()) * sizeof(void*) +
+         u64(c.size()) * (sizeof(typename C::value_type) + sizeof(void*) + sizeof(u64));
+}
+
+}  // namespace internal
+}  // namespace limbo
+
+#ifdef LIMBO_MEMORY
+#define LIMBO_MEMORY_DO(expr) (void) (expr)
+#else
+#define LIMBO_MEMORY_DO(expr) (void) 0
+#endif
+
+#endif  // LIMBO_INTERNAL_MEMORY_H_
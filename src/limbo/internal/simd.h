@@ -0,0 +1,79 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// A vectorized search kernel for arrays of 64 bit ids. Literals pack their
+// sign and both terms into a single 64 bit id and clauses store them
+// contiguously, so predicates like "has the same lhs" reduce to comparing
+// masked ids, which SIMD instructions do four (AVX2) or two (NEON, WASM
+// SIMD) at a time. The kernels are compiled when the compiler is invoked
+// with the respective instruction set (see the commented flags in the
+// top-level CMakeLists.txt and the Emscripten flags in the examples) and
+// fall back to a scalar loop otherwise.
+
+#ifndef LIMBO_INTERNAL_SIMD_H_
+#define LIMBO_INTERNAL_SIMD_H_
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+// Returns the least index i in [i0, n) such that (xs[i] & mask) == val, or n
+// if there is no such index. The array does not need to be sorted.
+inline size_t FindMasked(const u64* xs, size_t i0, size_t n, u64 mask, u64 val) {
+  size_t i = i0;
+#if defined(__AVX2__)
+  const __m256i m = _mm256_set1_epi64x(static_cast<long long>(mask));
+  const __m256i v = _mm256_set1_epi64x(static_cast<long long>(val));
+  for (; i + 4 <= n; i += 4) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i));
+    const __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(x, m), v);
+    const int bits = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+    if (bits != 0) {
+      return i + __builtin_ctz(static_cast<unsigned int>(bits));
+    }
+  }
+#elif defined(__ARM_NEON)
+  const uint64x2_t m = vdupq_n_u64(mask);
+  const uint64x2_t v = vdupq_n_u64(val);
+  for (; i + 2 <= n; i += 2) {
+    const uint64x2_t eq = vceqq_u64(vandq_u64(vld1q_u64(xs + i), m), v);
+    if (vgetq_lane_u64(eq, 0) != 0) {
+      return i;
+    }
+    if (vgetq_lane_u64(eq, 1) != 0) {
+      return i + 1;
+    }
+  }
+#elif defined(__wasm_simd128__)
+  const v128_t m = wasm_u64x2_splat(mask);
+  const v128_t v = wasm_u64x2_splat(val);
+  for (; i + 2 <= n; i += 2) {
+    const v128_t eq = wasm_i64x2_eq(wasm_v128_and(wasm_v128_load(xs + i), m), v);
+    const int bits = wasm_i64x2_bitmask(eq);
+    if (bits != 0) {
+      return i + __builtin_ctz(static_cast<unsigned int>(bits));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if ((xs[i] & mask) == val) {
+      return i;
+    }
+  }
+  return n;
+}
+
+}  // namespace internal
+}  // namespace limbo
+
+#endif  // LIMBO_INTERNAL_SIMD_H_
@@ -0,0 +1,53 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// Lightweight counters for the reasoner's hot paths: splits tried per belief
+// level, unit propagations in Setup::AddUnit(), subsumption tests, and
+// Bloom-filter early-outs. The counters explain why one query is cheap and
+// another expensive and thus help tuning the belief level k.
+//
+// The counters are incremented with plain adds through the LIMBO_STATS_DO()
+// macro, which compiles to nothing unless LIMBO_STATS is defined (see the
+// corresponding option in the top-level CMakeLists.txt). They are thread-local,
+// so with multi-threaded splitting each worker counts into its own instance;
+// Solver::stats() reports the calling thread's counters.
+
+#ifndef LIMBO_INTERNAL_STATS_H_
+#define LIMBO_INTERNAL_STATS_H_
+
+#include <array>
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+struct Stats {
+  static constexpr size_t kMaxLevel = 16;
+
+  static Stats& Local() {
+    static thread_local Stats stats;
+    return stats;
+  }
+
+  void Reset() { *this = Stats(); }
+
+  std::array<u64, kMaxLevel> splits{{}};  // split literals added, indexed by belief level (clamped to kMaxLevel - 1)
+  u64 unit_propagations = 0;              // clauses shortened by unit propagation in Setup::AddUnit()
+  u64 subsumption_tests = 0;              // calls of the Clause::Subsumes() overloads
+  u64 bloom_rejections = 0;               // propagation or subsumption tests rejected by the Bloom filter
+  u64 regression_cache_hits = 0;          // ActionTheory::Regress() results served from the memoization cache
+  u64 regression_cache_misses = 0;        // ActionTheory::Regress() results computed and added to the cache
+};
+
+}  // namespace internal
+}  // namespace limbo
+
+#ifdef LIMBO_STATS
+#define LIMBO_STATS_DO(expr) (void) (expr)
+#else
+#define LIMBO_STATS_DO(expr) (void) 0
+#endif
+
+#endif  // LIMBO_INTERNAL_STATS_H_
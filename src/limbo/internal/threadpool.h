@@ -0,0 +1,103 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// A small pool of worker threads. Jobs are submitted to a shared queue from
+// which idle workers take them; a job that wants to fan out over a range
+// typically claims indices from a shared atomic counter, which distributes
+// the range over the workers without further synchronisation. The pool is
+// kept alive between queries so that threads are spawned only once.
+
+#ifndef LIMBO_INTERNAL_THREADPOOL_H_
+#define LIMBO_INTERNAL_THREADPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t n) {
+    workers_.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      workers_.emplace_back([this]() { Work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      down_ = true;
+    }
+    work_cv_.notify_all();
+    for (std::thread& t : workers_) {
+      t.join();
+    }
+  }
+
+  size_t size() const { return workers_.size(); }
+
+  void Submit(std::function<void()> job) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      jobs_.push_back(std::move(job));
+      ++n_pending_;
+    }
+    work_cv_.notify_one();
+  }
+
+  // Blocks until every job submitted so far has run to completion.
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return n_pending_ == 0; });
+  }
+
+ private:
+  void Work() {
+    for (;;) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cv_.wait(lock, [this]() { return down_ || !jobs_.empty(); });
+        if (jobs_.empty()) {
+          return;
+        }
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+      job();
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (--n_pending_ == 0) {
+          done_cv_.notify_all();
+        }
+      }
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  size_t n_pending_ = 0;
+  bool down_ = false;
+};
+
+}  // namespace internal
+}  // namespace limbo
+
+#endif  // LIMBO_INTERNAL_THREADPOOL_H_
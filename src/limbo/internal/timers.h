@@ -0,0 +1,98 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// Scoped phase timers for the reasoner's hot paths: grounding in
+// Grounder::PrepareForQuery(), unit propagation in Setup::AddUnit(),
+// subsumption in Setup::Subsumes(), and split search in Solver::DoSplit().
+// Together with the counters in stats.h they answer where a slow query
+// spent its time without attaching an external profiler.
+//
+// The timers are driven by the LIMBO_TIMERS_SCOPE() macro, which compiles
+// to nothing unless LIMBO_TIMERS is defined (see the corresponding option
+// in the top-level CMakeLists.txt). When enabled, entering and leaving a
+// phase costs one time-stamp counter read each; nested scopes of the same
+// phase are counted once. Like the stats, the timers are thread-local, so
+// each split worker accumulates into its own instance, and the query entry
+// points reset the calling thread's timers.
+
+#ifndef LIMBO_INTERNAL_TIMERS_H_
+#define LIMBO_INTERNAL_TIMERS_H_
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+#include <array>
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+struct Timers {
+  enum Phase { kGround = 0, kPropagate, kSubsume, kSplit, kNPhases };
+
+  static Timers& Local() {
+    static thread_local Timers timers;
+    return timers;
+  }
+
+  // Raw time-stamp counter ticks on x86, nanoseconds elsewhere. The values
+  // are meant for comparing phases of one query against each other, not for
+  // conversion to wall-clock time.
+  static u64 Now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+
+  void Reset() { *this = Timers(); }
+
+  u64 ticks(Phase p) const { return ticks_[p]; }
+
+  class Scope {
+   public:
+    explicit Scope(Phase p) : timers_(Local()), p_(p), outermost_(!timers_.active_[p]) {
+      if (outermost_) {
+        timers_.active_[p_] = true;
+        start_ = Now();
+      }
+    }
+    ~Scope() {
+      if (outermost_) {
+        timers_.ticks_[p_] += Now() - start_;
+        timers_.active_[p_] = false;
+      }
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Timers& timers_;
+    Phase p_;
+    bool outermost_;
+    u64 start_ = 0;
+  };
+
+ private:
+  std::array<u64, kNPhases> ticks_{{}};
+  std::array<bool, kNPhases> active_{{}};
+};
+
+}  // namespace internal
+}  // namespace limbo
+
+#ifdef LIMBO_TIMERS
+#define LIMBO_TIMERS_SCOPE(phase) limbo::internal::Timers::Scope limbo_timers_scope_(phase)
+#define LIMBO_TIMERS_DO(expr) (void) (expr)
+#else
+#define LIMBO_TIMERS_SCOPE(phase) (void) 0
+#define LIMBO_TIMERS_DO(expr) (void) 0
+#endif
+
+#endif  // LIMBO_INTERNAL_TIMERS_H_
@@ -22,12 +22,47 @@
 //
 // Queries are not subject to any syntactic restrictions. Technically, they are
 // evaluated using variants of Levesque's representation theorem.
+//
+// Entails() memoizes its verdicts: every answer is stored under the query's
+// structural hash together with the knowledge base's mutation epoch, so
+// re-asking a formula costs only a hash lookup until the next Add().
+//
+// For objective knowledge bases, a cached verdict even survives additions
+// that cannot interact with the query: each entry records its support, the
+// function symbols in the symbol-connected component of the query at verdict
+// time, and an addition invalidates only the entries whose support it
+// intersects. An agent that adds one observation per tick and re-asks a
+// whole frontier of queries hence re-evaluates only the queries near the
+// observation. Conditional beliefs disable this revalidation. The sphere
+// system itself is maintained incrementally, though: real-world facts never
+// enter the spheres, and knowledge that is disconnected from every
+// conditional joins the existing spheres without re-running the consistency
+// probes; only additions that connect to some conditional, and new
+// conditionals themselves, rebuild the system.
+//
+// When more than one thread is configured with set_n_threads(), the
+// per-sphere reductions of a conditional-belief query are evaluated
+// concurrently on a pool of worker threads, for each sphere owns its own
+// solver. The construction of the sphere system itself remains sequential:
+// which conditionals a sphere accommodates depends on the evaluation of the
+// previous sphere. The thread count also propagates to the solvers'
+// grounders, which then construct the ground instances of added clauses in
+// parallel.
 
 #ifndef LIMBO_KNOWLEDGE_BASE_H_
 #define LIMBO_KNOWLEDGE_BASE_H_
 
 #include <cassert>
 
+#include <algorithm>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -41,6 +76,8 @@
 #include <limbo/internal/ints.h>
 #include <limbo/internal/iter.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/threadpool.h>
+#include <limbo/internal/timers.h>
 
 namespace limbo {
 
@@ -60,15 +97,311 @@ class KnowledgeBase {
   KnowledgeBase(KnowledgeBase&&) = default;
   KnowledgeBase& operator=(KnowledgeBase&&) = default;
 
+  // Additions are staged: AddReal(), Add() and AddClauses() only append to
+  // pending buffers, and the grounder and spheres integrate everything that
+  // accumulated since the last query in one pass -- one grounding ply, one
+  // unit-propagation fixpoint, one sphere update -- on the next query or an
+  // explicit Flush(). A burst of facts between two queries hence costs as
+  // much as a single batch, not one grounder round per literal.
   void AddReal(Literal a) {
     real_facts_.push_back(Clause{a});
     a.Traverse([this](Term t) { if (t.name()) names_.insert(t); return true; });
+    LogSupport(real_facts_.back());
+    ++epoch_;
   }
 
   void Add(const Clause& c) {
     assert(c.well_formed());
     knowledge_.push_back(c);
     c.Traverse([this](Term t) { if (t.name()) names_.insert(t); return true; });
+    LogSupport(c);
+    ++epoch_;
+  }
+
+  // Adds a range of clauses in one go. Programmatically generated theories
+  // are born clausal, so this is their fast path into the knowledge base:
+  // no Formula round trip, and the mutation epoch -- which invalidates the
+  // query cache -- is bumped only once for the whole batch. Reserve() can
+  // be called beforehand when the total is known.
+  template<typename InputIt>
+  void AddClauses(InputIt first, InputIt last) {
+    if (first == last) {
+      return;
+    }
+    for (; first != last; ++first) {
+      const Clause& c = *first;
+      assert(c.well_formed());
+      knowledge_.push_back(c);
+      c.Traverse([this](Term t) { if (t.name()) names_.insert(t); return true; });
+      LogSupport(c);
+    }
+    ++epoch_;
+  }
+
+  void Reserve(size_t n_clauses) { knowledge_.reserve(n_clauses); }
+
+  // Pre-declares the dimensions of the theory: n_sorts sorts with
+  // n_names_per_sort names each, n_functions function symbols, and n_clauses
+  // clauses to be added with AddReal(), Add() or AddClauses(). All backing
+  // storage -- the term factory's interning index, the per-sort tables, and
+  // the solvers' clause stores -- is then sized once at startup instead of
+  // growing step by step while the theory streams in. The counts are hints,
+  // not limits: everything beyond them falls back to incremental growth.
+  void Reserve(size_t n_sorts, size_t n_names_per_sort, size_t n_functions, size_t n_clauses) {
+    knowledge_.reserve(n_clauses);
+    support_log_.reserve(2 * n_clauses);
+    names_.FitForKeys(n_sorts);
+    // Sized for nullary and unary ground terms, which dominate flat
+    // theories; deeper nesting only costs the interning index a rehash.
+    tf_->Reserve(n_sorts * n_names_per_sort + n_functions * (1 + n_names_per_sort));
+    // The literal buffer is sized for binary clauses; it grows geometrically
+    // from there, so longer clauses cost at most a few more relocations.
+    const size_t n_literals = 2 * n_clauses;
+    real_world_.Reserve(n_sorts, n_clauses, n_literals);
+    for (Solver& sphere : spheres_) {
+      sphere.Reserve(n_sorts, n_clauses, n_literals);
+    }
+  }
+
+  // Integrates all staged additions now instead of on the next query. Useful
+  // to take the grounding cost at a controlled point, e.g. between ingesting
+  // a sensor burst and serving queries.
+  void Flush() { UpdateSpheres(); }
+
+  // Snapshots the interned terms once all additions have been integrated.
+  // Terms interned after the snapshot are the by-products of queries --
+  // groundings, plus-names, reduced formulas -- and BacktrackTerms() bulk-
+  // releases them; see Term::Factory::Backtrack(). Without this, the term
+  // heaps and interning tables grow monotonically with every query ever
+  // asked, which is what makes long-running systems' footprints climb.
+  Term::Factory::Mark MarkTerms() {
+    UpdateSpheres();
+    return tf_->mark();
+  }
+
+  // Releases the terms interned since the mark was taken and recycles their
+  // ids. Sound only if nothing was added to the knowledge base since then and
+  // the caller retains no Formula or Term created since then. Queries leave
+  // no other trace than pooled names, grounding caches, and cached verdicts,
+  // all of which are dropped here and rebuilt by the next queries. Must not
+  // run while a query is in flight.
+  void BacktrackTerms(const Term::Factory::Mark& mark) {
+    assert(n_processed_real_facts_ == real_facts_.size());
+    assert(n_processed_knowledge_ == knowledge_.size());
+    assert(n_processed_beliefs_ == beliefs_.size());
+    query_cache_.clear();
+    real_world_.grounder().BacktrackTerms(mark);
+    for (Solver& sphere : spheres_) {
+      sphere.grounder().BacktrackTerms(mark);
+    }
+    tf_->Backtrack(mark);
+  }
+
+  // Save() writes the symbol counters, the symbols, a deduplicated term
+  // table, and the clauses of the knowledge base in a compact binary format,
+  // and Load() recreates them through the symbol and term factories. Loading
+  // a snapshot hence takes time linear in its size and skips parsing and
+  // normal form construction altogether, which is what makes warm restarts
+  // cheap. The format is structural rather than a memory image: terms are
+  // interned singletons whose identifiers differ between runs, so Load()
+  // re-interns them instead of patching addresses.
+  //
+  // Only objective knowledge bases can be snapshotted; Save() returns false
+  // if conditional beliefs have been added, for their antecedents are
+  // formulas, which have no binary encoding. Load() appends to this
+  // knowledge base and expects factories that are fresh or that created the
+  // saved symbols; it returns false on malformed input, in which case the
+  // knowledge base may have been partially extended. The encoding consists
+  // of raw fixed-width integers and is not portable across architectures of
+  // different endianness.
+  bool Save(std::ostream* os) const {
+    if (!beliefs_.empty()) {
+      return false;
+    }
+    std::vector<Symbol> symbols;
+    std::unordered_map<Symbol, internal::u32> symbol_index;
+    std::vector<Term> terms;
+    std::unordered_map<Term, internal::u32> term_index;
+    for (const Clause& c : real_facts_) {
+      for (const Literal a : c) {
+        IndexTerm(a.lhs(), &symbols, &symbol_index, &terms, &term_index);
+        IndexTerm(a.rhs(), &symbols, &symbol_index, &terms, &term_index);
+      }
+    }
+    for (const Clause& c : knowledge_) {
+      for (const Literal a : c) {
+        IndexTerm(a.lhs(), &symbols, &symbol_index, &terms, &term_index);
+        IndexTerm(a.rhs(), &symbols, &symbol_index, &terms, &term_index);
+      }
+    }
+    WriteFixed<internal::u32>(os, kSnapshotMagic);
+    WriteFixed<Symbol::Sort::Id>(os, sf_->last_sort());
+    WriteFixed<Symbol::Id>(os, sf_->last_function());
+    WriteFixed<Symbol::Id>(os, sf_->last_name());
+    WriteFixed<Symbol::Id>(os, sf_->last_variable());
+    WriteFixed<internal::u32>(os, internal::u32(symbols.size()));
+    for (const Symbol s : symbols) {
+      WriteFixed<internal::u8>(os, s.function() ? 0 : s.name() ? 1 : 2);
+      WriteFixed<Symbol::Sort::Id>(os, s.sort().id());
+      WriteFixed<Symbol::Arity>(os, s.arity());
+      WriteFixed<Symbol::Id>(os, s.index());
+    }
+    WriteFixed<internal::u32>(os, internal::u32(terms.size()));
+    for (const Term t : terms) {
+      WriteFixed<internal::u32>(os, symbol_index.at(t.symbol()));
+      for (const Term arg : t.args()) {
+        WriteFixed<internal::u32>(os, term_index.at(arg));
+      }
+    }
+    WriteFixed<internal::u32>(os, internal::u32(real_facts_.size()));
+    for (const Clause& c : real_facts_) {
+      assert(c.unit());
+      WriteLiteral(os, c.first(), term_index);
+    }
+    WriteFixed<internal::u32>(os, internal::u32(knowledge_.size()));
+    for (const Clause& c : knowledge_) {
+      WriteFixed<internal::u32>(os, internal::u32(c.size()));
+      for (const Literal a : c) {
+        WriteLiteral(os, a, term_index);
+      }
+    }
+    return bool(*os);
+  }
+
+  // Writes a C++ translation unit that embeds this knowledge base's Save()
+  // snapshot as static initialized data:
+  //
+  //   extern const unsigned char <identifier>[];
+  //   extern const unsigned long long <identifier>_size;
+  //
+  // Compiling the generated file into the binary and handing the array to
+  // Load(data, size) at startup restores the static part of the theory
+  // without touching the file system or parsing anything; dynamic facts are
+  // layered on top through the normal Add() path. This is the build-time
+  // counterpart of the deploy-time snapshot file. Like Save(), it is limited
+  // to objective knowledge bases and returns false for conditional ones.
+  bool SaveEmbedded(std::ostream* os, const std::string& identifier) const {
+    std::ostringstream data;
+    if (!Save(&data)) {
+      return false;
+    }
+    const std::string s = data.str();
+    *os << "// Generated by limbo::KnowledgeBase::SaveEmbedded(). Do not edit.\n";
+    *os << "extern const unsigned char " << identifier << "[] = {";
+    for (size_t i = 0; i < s.size(); ++i) {
+      *os << (i % 12 == 0 ? "\n  " : " ") << unsigned(static_cast<unsigned char>(s[i])) << ',';
+    }
+    *os << "\n};\n";
+    *os << "extern const unsigned long long " << identifier << "_size = " << s.size() << "ULL;\n";
+    return bool(*os);
+  }
+
+  // Restores a knowledge base from an in-memory snapshot, such as one
+  // embedded with SaveEmbedded() or mapped from a file. Equivalent to Load()
+  // on a stream over [data, data + size), but without copying the bytes.
+  bool Load(const unsigned char* data, size_t size) {
+    struct MemBuf : public std::streambuf {
+      MemBuf(char* begin, size_t n) { setg(begin, begin, begin + n); }
+    };
+    MemBuf buf(const_cast<char*>(reinterpret_cast<const char*>(data)), size);
+    std::istream is(&buf);
+    return Load(&is);
+  }
+
+  bool Load(std::istream* is) {
+    internal::u32 magic;
+    if (!ReadFixed(is, &magic) || magic != kSnapshotMagic) {
+      return false;
+    }
+    Symbol::Sort::Id last_sort;
+    Symbol::Id last_function;
+    Symbol::Id last_name;
+    Symbol::Id last_variable;
+    if (!ReadFixed(is, &last_sort) || !ReadFixed(is, &last_function) ||
+        !ReadFixed(is, &last_name) || !ReadFixed(is, &last_variable)) {
+      return false;
+    }
+    sf_->Resume(last_sort, last_function, last_name, last_variable);
+    internal::u32 n_symbols;
+    if (!ReadFixed(is, &n_symbols)) {
+      return false;
+    }
+    std::vector<Symbol> symbols;
+    symbols.reserve(n_symbols);
+    for (internal::u32 i = 0; i < n_symbols; ++i) {
+      internal::u8 kind;
+      Symbol::Sort::Id sort_id;
+      Symbol::Arity arity;
+      Symbol::Id index;
+      if (!ReadFixed(is, &kind) || !ReadFixed(is, &sort_id) || !ReadFixed(is, &arity) || !ReadFixed(is, &index)) {
+        return false;
+      }
+      const Symbol::Sort sort = Symbol::Sort(sort_id);
+      switch (kind) {
+        case 0:  symbols.push_back(Symbol::Factory::CreateFunction(index, sort, arity)); break;
+        case 1:  symbols.push_back(Symbol::Factory::CreateName(index, sort)); break;
+        case 2:  symbols.push_back(Symbol::Factory::CreateVariable(index, sort)); break;
+        default: return false;
+      }
+    }
+    internal::u32 n_terms;
+    if (!ReadFixed(is, &n_terms)) {
+      return false;
+    }
+    std::vector<Term> terms;
+    terms.reserve(n_terms);
+    for (internal::u32 i = 0; i < n_terms; ++i) {
+      internal::u32 si;
+      if (!ReadFixed(is, &si) || si >= symbols.size()) {
+        return false;
+      }
+      Term::Vector args;
+      args.reserve(symbols[si].arity());
+      for (Symbol::Arity a = 0; a < symbols[si].arity(); ++a) {
+        internal::u32 ti;
+        if (!ReadFixed(is, &ti) || ti >= terms.size()) {
+          return false;
+        }
+        args.push_back(terms[ti]);
+      }
+      terms.push_back(tf_->CreateTerm(symbols[si], args));
+    }
+    internal::u32 n_facts;
+    if (!ReadFixed(is, &n_facts)) {
+      return false;
+    }
+    for (internal::u32 i = 0; i < n_facts; ++i) {
+      internal::Maybe<Literal> a = ReadLiteral(is, terms);
+      if (!a) {
+        return false;
+      }
+      AddReal(a.val);
+    }
+    internal::u32 n_clauses;
+    if (!ReadFixed(is, &n_clauses)) {
+      return false;
+    }
+    std::vector<Clause> cs;
+    cs.reserve(n_clauses);
+    for (internal::u32 i = 0; i < n_clauses; ++i) {
+      internal::u32 n_lits;
+      if (!ReadFixed(is, &n_lits)) {
+        return false;
+      }
+      std::vector<Literal> as;
+      as.reserve(n_lits);
+      for (internal::u32 j = 0; j < n_lits; ++j) {
+        internal::Maybe<Literal> a = ReadLiteral(is, terms);
+        if (!a) {
+          return false;
+        }
+        as.push_back(a.val);
+      }
+      cs.push_back(Clause(as.begin(), as.end()));
+    }
+    Reserve(knowledge_.size() + cs.size());
+    AddClauses(cs.begin(), cs.end());
+    return true;
   }
 
   bool Add(const Formula& alpha) {
@@ -99,10 +432,25 @@ class KnowledgeBase {
 
   bool Entails(const Formula& sigma, bool distribute = true) {
     assert(sigma.free_vars().all_empty());
+    const internal::hash64_t h = sigma.hash();
+    const auto range = query_cache_.equal_range(h);
+    for (auto it = range.first; it != range.second; ) {
+      QueryCacheEntry& e = it->second;
+      if (e.epoch != epoch_ && !Revalidate(&e)) {
+        it = query_cache_.erase(it);
+      } else if (e.distribute == distribute && *e.sigma == sigma) {
+        return e.verdict;
+      } else {
+        ++it;
+      }
+    }
     UpdateSpheres();
     Formula::Ref phi = ReduceModalities(*sigma.NF(sf_, tf_, distribute));
     assert(phi->objective());
-    return real_world_.Entails(0, *phi, Solver::kNoConsistencyGuarantee);
+    const bool verdict = real_world_.Entails(0, *phi, Solver::kNoConsistencyGuarantee);
+    query_cache_.emplace(h, QueryCacheEntry{sigma.Clone(), distribute, epoch_, support_log_.size(),
+                                            Support(sigma), verdict});
+    return verdict;
   }
 
   sphere_index n_spheres() const { const_cast<KnowledgeBase&>(*this).UpdateSpheres(); return spheres_.size(); }
@@ -113,6 +461,24 @@ class KnowledgeBase {
   const SortedTermSet& mentioned_names() const { return names_; }
   const TermSet& mentioned_names(Symbol::Sort sort) const { return names_[sort]; }
 
+  internal::size_t n_threads() const { return n_threads_; }
+
+  // The calling thread's per-phase time breakdown of the last solver-level
+  // query run on behalf of this knowledge base (see Solver::timers()). All
+  // zero unless compiled with LIMBO_TIMERS.
+  const internal::Timers& timers() const { return internal::Timers::Local(); }
+
+  void set_n_threads(internal::size_t n) {
+    n_threads_ = n > 0 ? n : 1;
+    if (pool_ && pool_->size() != n_threads_) {
+      pool_ = nullptr;
+    }
+    real_world_.grounder().set_n_threads(n_threads_);
+    for (Solver& sphere : spheres_) {
+      sphere.grounder().set_n_threads(n_threads_);
+    }
+  }
+
  private:
   typedef Formula::belief_level belief_level;
 
@@ -124,6 +490,115 @@ class KnowledgeBase {
     bool assume_consistent;
   };
 
+  struct QueryCacheEntry {
+    Formula::Ref sigma;
+    bool distribute;
+    size_t epoch;
+    size_t log_watermark;
+    std::unordered_set<Symbol> support;
+    bool verdict;
+  };
+
+  // Appends the function symbols of c to the support log, against which
+  // Revalidate() checks cached verdicts from earlier epochs.
+  void LogSupport(const Clause& c) {
+    c.Traverse([this](const Term t) { if (t.function()) { support_log_.push_back(t.symbol()); } return true; });
+  }
+
+  // The support of a verdict of sigma: the function symbols reachable from
+  // sigma by chains of clauses that share a function symbol. A clause over
+  // other symbols can participate in no derivation of sigma -- and since
+  // fresh names are represented by a single placeholder anyway, the new
+  // names it mentions do not change the verdict either.
+  std::unordered_set<Symbol> Support(const Formula& sigma) const {
+    std::unordered_set<Symbol> support;
+    sigma.Traverse([&support](const Term t) { if (t.function()) { support.insert(t.symbol()); } return true; });
+    CloseSupport(&support);
+    return support;
+  }
+
+  // Extends support to every function symbol reachable from it by chains of
+  // added clauses that share a function symbol.
+  void CloseSupport(std::unordered_set<Symbol>* support) const {
+    bool changed;
+    auto close = [support, &changed](const Clause& c) {
+      bool connected = false;
+      c.Traverse([support, &connected](const Term t) {
+        connected |= t.function() && support->count(t.symbol()) > 0;
+        return !connected;
+      });
+      if (connected) {
+        c.Traverse([support, &changed](const Term t) {
+          if (t.function()) {
+            changed |= support->insert(t.symbol()).second;
+          }
+          return true;
+        });
+      }
+    };
+    do {
+      changed = false;
+      for (const std::vector<Clause>* cs : {&real_facts_, &knowledge_}) {
+        for (const Clause& c : *cs) {
+          close(c);
+        }
+      }
+      for (const Conditional& c : beliefs_) {
+        close(c.not_ante_or_conse);
+      }
+    } while (changed);
+  }
+
+  // The function symbols that can influence the sphere structure: those of
+  // the conditionals' antecedents and consequents, closed under the symbol
+  // connectivity from CloseSupport(). A clause over other symbols can
+  // participate in no derivation of a consistency probe (cf. Support()), so
+  // adding it leaves the sphere structure as it is.
+  void RebuildBeliefSupport() {
+    belief_support_.clear();
+    for (const Conditional& c : beliefs_) {
+      c.ante->Traverse([this](const Term t) {
+        if (t.function()) {
+          belief_support_.insert(t.symbol());
+        }
+        return true;
+      });
+      c.not_ante_or_conse.Traverse([this](const Term t) {
+        if (t.function()) {
+          belief_support_.insert(t.symbol());
+        }
+        return true;
+      });
+    }
+    CloseSupport(&belief_support_);
+  }
+
+  bool ConnectedToBeliefs(const Clause& c) const {
+    bool connected = false;
+    c.Traverse([this, &connected](const Term t) {
+      connected |= t.function() && belief_support_.count(t.symbol()) > 0;
+      return !connected;
+    });
+    return connected;
+  }
+
+  // Brings a cached verdict from an earlier epoch up to date if none of the
+  // additions since touched its support; returns false if it must be
+  // re-evaluated instead.
+  bool Revalidate(QueryCacheEntry* e) {
+    if (!beliefs_.empty()) {
+      return false;
+    }
+    for (size_t i = e->log_watermark; i < support_log_.size(); ++i) {
+      if (e->support.count(support_log_[i]) > 0) {
+        return false;
+      }
+    }
+    e->log_watermark = support_log_.size();
+    e->epoch = epoch_;
+    return true;
+  }
+
   void Add(belief_level k,
            belief_level l,
            const Formula& antecedent,
@@ -132,6 +607,7 @@ class KnowledgeBase {
     beliefs_.push_back(Conditional{k, l, antecedent.Clone(), not_antecedent_or_consequent, assume_consistent});
     antecedent.Traverse([this](Term t) { if (t.name()) names_.insert(t); return true; });
     not_antecedent_or_consequent.Traverse([this](Term t) { if (t.name()) names_.insert(t); return true; });
+    ++epoch_;
   }
 
   void UpdateSpheres() {
@@ -141,12 +617,26 @@ class KnowledgeBase {
       return;
     }
     real_world_.grounder().AddClauses(real_facts_.begin() + n_processed_real_facts_, real_facts_.end());
+    n_processed_real_facts_ = real_facts_.size();
+    if (n_processed_beliefs_ == beliefs_.size() && n_processed_knowledge_ == knowledge_.size()) {
+      // Only real-world facts came in, and those never enter the spheres.
+      return;
+    }
     if (beliefs_.empty()) {
       assert(spheres_.size() == 1);
       assert(n_processed_beliefs_ == 0);
       for (Solver& sphere : spheres_) {
         sphere.grounder().AddClauses(knowledge_.begin() + n_processed_knowledge_, knowledge_.end());
       }
+    } else if (n_processed_beliefs_ == beliefs_.size() &&
+               std::none_of(knowledge_.begin() + n_processed_knowledge_, knowledge_.end(),
+                            [this](const Clause& c) { return ConnectedToBeliefs(c); })) {
+      // New knowledge that is disconnected from every conditional cannot
+      // change the outcome of any consistency probe, so the sphere structure
+      // stands and the new clauses just join every sphere.
+      for (Solver& sphere : spheres_) {
+        sphere.grounder().AddClauses(knowledge_.begin() + n_processed_knowledge_, knowledge_.end());
+      }
     } else {
       spheres_.clear();
       std::vector<bool> done(beliefs_.size(), false);
@@ -156,6 +646,7 @@ class KnowledgeBase {
       do {
         last_n_done = n_done;
         Solver sphere(sf_, tf_);
+        sphere.grounder().set_n_threads(n_threads_);
         auto is = internal::filter_range(internal::int_iterator<size_t>(0),
                                          internal::int_iterator<size_t>(beliefs_.size()),
                                          [this, &done](size_t i) { return !done[i]; });
@@ -189,6 +680,7 @@ class KnowledgeBase {
         }
         is_plausibility_consistent = next_is_plausibility_consistent;
       } while (n_done > last_n_done);
+      RebuildBeliefSupport();
     }
     n_processed_beliefs_ = beliefs_.size();
     n_processed_knowledge_ = knowledge_.size();
@@ -225,14 +717,42 @@ class KnowledgeBase {
         const belief_level l = alpha.as_bel().l();
         std::vector<Formula::Ref> consistent;
         std::vector<Formula::Ref> entails;
-        for (sphere_index p = 0; p < spheres_.size(); ++p) {
-          consistent.push_back(ResConsistent(p, l, *ante));
-          entails.push_back(ResEntails(p, k, *not_ante_or_conse));
-          // The above calls to ResConsistent() and ResEntails() are potentially
-          // very expensive, so we should abort this loop when the subsequent
-          // spheres are clearly irrelevant.
-          if (consistent.back()->trivially_valid()) {
-            break;
+        if (n_threads_ > 1 && spheres_.size() > 1) {
+          // The calls to ResConsistent() and ResEntails() are independent
+          // across spheres, since every sphere owns its own solver, so they
+          // are distributed over the worker pool. The sequential loop below
+          // skips the spheres after the first one whose consistency result is
+          // trivially valid; truncating the results accordingly afterwards
+          // yields the same formula at the price of some wasted work.
+          if (!pool_) {
+            pool_ = std::unique_ptr<internal::ThreadPool>(new internal::ThreadPool(n_threads_));
+          }
+          consistent.resize(spheres_.size());
+          entails.resize(spheres_.size());
+          for (sphere_index p = 0; p < spheres_.size(); ++p) {
+            pool_->Submit([this, p, k, l, &ante, &not_ante_or_conse, &consistent, &entails]() {
+              consistent[p] = ResConsistent(p, l, *ante);
+              entails[p] = ResEntails(p, k, *not_ante_or_conse);
+            });
+          }
+          pool_->Wait();
+          for (sphere_index p = 0; p < spheres_.size(); ++p) {
+            if (consistent[p]->trivially_valid()) {
+              consistent.resize(p + 1);
+              entails.resize(p + 1);
+              break;
+            }
+          }
+        } else {
+          for (sphere_index p = 0; p < spheres_.size(); ++p) {
+            consistent.push_back(ResConsistent(p, l, *ante));
+            entails.push_back(ResEntails(p, k, *not_ante_or_conse));
+            // The above calls to ResConsistent() and ResEntails() are potentially
+            // very expensive, so we should abort this loop when the subsequent
+            // spheres are clearly irrelevant.
+            if (consistent.back()->trivially_valid()) {
+              break;
+            }
           }
         }
         Formula::Ref phi;
@@ -364,6 +884,61 @@ class KnowledgeBase {
     return Formula::Factory::Or(Formula::Factory::Atomic(c), std::move(phi));
   }
 
+  // Identifies and versions the snapshot format written by Save().
+  static constexpr internal::u32 kSnapshotMagic = 0x6c6b6231;  // "lkb1"
+
+  // Assigns t and its subterms indices in depth-first postorder, so that in
+  // the term table every term is preceded by its arguments and Load() can
+  // re-intern the table in a single pass.
+  static internal::u32 IndexTerm(Term t,
+                                 std::vector<Symbol>* symbols,
+                                 std::unordered_map<Symbol, internal::u32>* symbol_index,
+                                 std::vector<Term>* terms,
+                                 std::unordered_map<Term, internal::u32>* term_index) {
+    const auto it = term_index->find(t);
+    if (it != term_index->end()) {
+      return it->second;
+    }
+    for (const Term arg : t.args()) {
+      IndexTerm(arg, symbols, symbol_index, terms, term_index);
+    }
+    if (symbol_index->emplace(t.symbol(), internal::u32(symbols->size())).second) {
+      symbols->push_back(t.symbol());
+    }
+    const internal::u32 i = internal::u32(terms->size());
+    terms->push_back(t);
+    term_index->emplace(t, i);
+    return i;
+  }
+
+  template<typename T>
+  static void WriteFixed(std::ostream* os, T x) {
+    os->write(reinterpret_cast<const char*>(&x), sizeof(x));
+  }
+
+  template<typename T>
+  static bool ReadFixed(std::istream* is, T* x) {
+    is->read(reinterpret_cast<char*>(x), sizeof(*x));
+    return !is->fail();
+  }
+
+  static void WriteLiteral(std::ostream* os, Literal a, const std::unordered_map<Term, internal::u32>& term_index) {
+    WriteFixed<internal::u8>(os, a.pos() ? 1 : 0);
+    WriteFixed<internal::u32>(os, term_index.at(a.lhs()));
+    WriteFixed<internal::u32>(os, term_index.at(a.rhs()));
+  }
+
+  static internal::Maybe<Literal> ReadLiteral(std::istream* is, const std::vector<Term>& terms) {
+    internal::u8 pos;
+    internal::u32 lhs;
+    internal::u32 rhs;
+    if (!ReadFixed(is, &pos) || !ReadFixed(is, &lhs) || !ReadFixed(is, &rhs) ||
+        lhs >= terms.size() || rhs >= terms.size()) {
+      return internal::Nothing;
+    }
+    return internal::Just(pos != 0 ? Literal::Eq(terms[lhs], terms[rhs]) : Literal::Neq(terms[lhs], terms[rhs]));
+  }
+
   static Formula::Ref bool_to_formula(bool b) {
     Formula::Ref falsum = Formula::Factory::Atomic(Clause());
     return b ? Formula::Factory::Not(std::move(falsum)) : std::move(falsum);
@@ -377,9 +952,21 @@ class KnowledgeBase {
   SortedTermSet names_;
   std::vector<Solver> spheres_;
   Solver real_world_;
+  internal::size_t n_threads_ = 1;
+  std::unique_ptr<internal::ThreadPool> pool_;
   size_t n_processed_real_facts_ = 0;
   size_t n_processed_knowledge_ = 0;
   size_t n_processed_beliefs_ = 0;
+  // The verdicts of past queries; entries from older epochs are revalidated
+  // or dropped lazily when their hash bucket is visited again.
+  std::unordered_multimap<internal::hash64_t, QueryCacheEntry> query_cache_;
+  // The function symbols of all added clauses in order of addition; a cache
+  // entry's watermark marks how much of the log predates its verdict.
+  std::vector<Symbol> support_log_;
+  // The support of the conditionals as of the last sphere rebuild; additions
+  // outside it are integrated into the spheres without a rebuild.
+  std::unordered_set<Symbol> belief_support_;
+  size_t epoch_ = 0;
 };
 
 }  // namespace limbo
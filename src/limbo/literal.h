@@ -22,11 +22,13 @@
 
 #include <functional>
 #include <utility>
+#include <vector>
 
 #include <limbo/term.h>
 
 #include <limbo/internal/ints.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/simd.h>
 
 namespace limbo {
 
@@ -35,6 +37,7 @@ class Literal {
   template<typename T>
   using Maybe = internal::Maybe<T>;
   struct LhsHash;
+  class LhsSet;
 
   static Literal Eq(Term lhs, Term rhs) { return Literal(true, lhs, rhs); }
   static Literal Neq(Term lhs, Term rhs) { return Literal(false, lhs, rhs); }
@@ -62,10 +65,7 @@ class Literal {
 
   static Literal Min(Term lhs) { return Literal(lhs); }
 
-  internal::hash32_t hash() const {
-    return internal::jenkins_hash(static_cast<Term::Id>(id_ >> 32)) ^
-           internal::jenkins_hash(static_cast<Term::Id>(id_));
-  }
+  internal::hash64_t hash() const { return internal::splitmix64_hash(id_); }
 
   // valid() holds for (t = t) and (n1 != n2) and (t1 != t2) if t1, t2 have different sorts.
   bool valid() const {
@@ -110,6 +110,22 @@ class Literal {
 
   bool ProperlySubsumes(Literal b) const { return ProperlySubsumes(*this, b); }
 
+  // FindLhs() and Find() return the least index i in [i0, n) such that
+  // lits[i].lhs() == lhs or lits[i] == a, respectively, or n if there is no
+  // such index. Since literals are just 64 bit ids, both are masked-id
+  // searches, which internal::FindMasked() vectorizes where SIMD instructions
+  // are available.
+  static internal::size_t FindLhs(const Literal* lits, internal::size_t i0, internal::size_t n, Term lhs) {
+    static_assert(sizeof(Literal) == sizeof(Id), "Literal must be its id");
+    return internal::FindMasked(reinterpret_cast<const internal::u64*>(lits), i0, n,
+                                kBitMaskLhs, static_cast<Id>(lhs.id()) << kFirstBitLhs);
+  }
+
+  static internal::size_t Find(const Literal* lits, internal::size_t i0, internal::size_t n, Literal a) {
+    static_assert(sizeof(Literal) == sizeof(Id), "Literal must be its id");
+    return internal::FindMasked(reinterpret_cast<const internal::u64*>(lits), i0, n, ~Id(0), a.id_);
+  }
+
   template<typename UnaryFunction>
   Literal Substitute(UnaryFunction theta, Term::Factory* tf) const {
     return Literal(pos(), lhs().Substitute(theta, tf), rhs().Substitute(theta, tf));
@@ -190,7 +206,147 @@ class Literal {
 };
 
 struct Literal::LhsHash {
-  internal::hash32_t operator()(const Literal a) const { return a.lhs().hash(); }
+  internal::hash64_t operator()(const Literal a) const { return a.lhs().hash(); }
+};
+
+// A flat open-addressing hash set of literals, grouped by their lhs term:
+// the probe position depends only on the lhs, so all literals with the same
+// lhs share one linear probe chain and can be visited together. Since a
+// literal is a single 64 bit word, every probe is an inline array load
+// instead of the pointer chase of a node-based set. This is the set that
+// Clause::PropagateUnits() and Setup's unit index run their innermost loops
+// over.
+class Literal::LhsSet {
+ public:
+  LhsSet() = default;
+  LhsSet(std::initializer_list<Literal> lits) { for (const Literal a : lits) { Insert(a); } }
+  template<typename InputIt>
+  LhsSet(InputIt first, InputIt last) { for (; first != last; ++first) { Insert(*first); } }
+
+  bool empty() const { return size_ == 0; }
+  internal::size_t size() const { return size_; }
+  internal::u64 memory_bytes() const { return internal::u64(slots_.capacity()) * sizeof(Literal); }
+
+  void Clear() {
+    slots_.clear();
+    size_ = 0;
+    n_used_ = 0;
+  }
+
+  bool Contains(const Literal a) const {
+    return AnyWithLhs(a.lhs(), [a](const Literal b) { return a == b; });
+  }
+
+  // Pre-sizes the probe table for n literals, so that a burst of Insert()
+  // calls triggers no rehash. No-op when the table is already big enough.
+  void Reserve(internal::size_t n) {
+    internal::size_t cap = kMinCapacity;
+    while (cap < 2 * n) {
+      cap *= 2;
+    }
+    if (cap > slots_.size()) {
+      Rehash(cap);
+    }
+  }
+
+  // Inserts a unless it is contained already.
+  void Insert(const Literal a) {
+    assert(!a.null() && !a.lhs().null());
+    if (2 * (n_used_ + 1) > slots_.size()) {
+      Grow();
+    }
+    const internal::size_t mask = slots_.size() - 1;
+    internal::size_t i = a.lhs().hash() & mask;
+    internal::size_t free = kNone;
+    for (; !slots_[i].null(); i = (i + 1) & mask) {
+      if (slots_[i] == a) {
+        return;
+      }
+      if (free == kNone && slots_[i].id_ == kTombstone) {
+        free = i;
+      }
+    }
+    if (free == kNone) {
+      free = i;
+      ++n_used_;
+    }
+    slots_[free] = a;
+    ++size_;
+  }
+
+  void Erase(const Literal a) {
+    if (slots_.empty()) {
+      return;
+    }
+    const internal::size_t mask = slots_.size() - 1;
+    for (internal::size_t i = a.lhs().hash() & mask; !slots_[i].null(); i = (i + 1) & mask) {
+      if (slots_[i] == a) {
+        slots_[i] = Literal(kTombstone);
+        --size_;
+        return;
+      }
+    }
+  }
+
+  // Calls p for every literal in the set whose lhs is t until p returns
+  // true, and returns whether some call did. The walk is an array scan from
+  // the hash position of t to the next empty slot.
+  template<typename UnaryPredicate>
+  bool AnyWithLhs(const Term t, UnaryPredicate p) const {
+    if (slots_.empty()) {
+      return false;
+    }
+    const internal::size_t mask = slots_.size() - 1;
+    for (internal::size_t i = t.hash() & mask; !slots_[i].null(); i = (i + 1) & mask) {
+      const Literal a = slots_[i];
+      if (a.id_ != kTombstone && a.lhs() == t && p(a)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template<typename UnaryFunction>
+  void ForEach(UnaryFunction f) const {
+    for (const Literal a : slots_) {
+      if (!a.null() && a.id_ != kTombstone) {
+        f(a);
+      }
+    }
+  }
+
+ private:
+  static constexpr internal::size_t kMinCapacity = 16;
+  static constexpr internal::size_t kNone = ~internal::size_t(0);
+  // The tombstone marks erased slots; its lhs is null and hence cannot
+  // collide with a stored literal, whose lhs is a function.
+  static constexpr Id kTombstone = kBitMaskPos;
+
+  // Doubles the capacity, or just drops the tombstones when they make up
+  // most of the used slots. The capacity stays a power of two, so the probe
+  // sequence can wrap around with a mask instead of a modulo.
+  void Grow() {
+    const internal::size_t n = 4 * size_ > slots_.size() ? 2 * slots_.size() : slots_.size();
+    Rehash(n < kMinCapacity ? kMinCapacity : n);
+  }
+
+  void Rehash(internal::size_t n) {
+    assert((n & (n - 1)) == 0 && 2 * size_ <= n);
+    std::vector<Literal> old;
+    old.swap(slots_);
+    slots_.resize(n);
+    size_ = 0;
+    n_used_ = 0;
+    for (const Literal a : old) {
+      if (!a.null() && a.id_ != kTombstone) {
+        Insert(a);
+      }
+    }
+  }
+
+  std::vector<Literal> slots_;
+  internal::size_t size_ = 0;
+  internal::size_t n_used_ = 0;
 };
 
 }  // namespace limbo
@@ -200,7 +356,7 @@ namespace std {
 
 template<>
 struct hash<limbo::Literal> {
-  limbo::internal::hash32_t operator()(const limbo::Literal a) const { return a.hash(); }
+  limbo::internal::hash64_t operator()(const limbo::Literal a) const { return a.hash(); }
 };
 
 template<>
@@ -0,0 +1,144 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// A KnowledgeBaseService makes a knowledge base queryable from many threads
+// at once. KnowledgeBase itself is single-threaded -- queries ground new
+// plies, update spheres, and fill caches -- so instead of funnelling all
+// queries through one lock, the service publishes immutable epochs:
+//
+//  * The writer side (AddReal(), Add(), Publish()) maintains a master
+//    knowledge base under a mutex. Publish() serializes it with
+//    KnowledgeBase::Save() and swaps the snapshot in atomically.
+//
+//  * The reader side (Entails()) keeps one replica per thread, rebuilt
+//    with KnowledgeBase::Load() whenever the thread first queries a newer
+//    epoch. Between epochs, queries run on the thread's replica without
+//    any synchronization; the symbol and term factories are shared safely,
+//    for symbol creation is atomic and term interning is sharded (see
+//    term.h).
+//
+// Readers never block writers and vice versa; a query started before a
+// Publish() simply answers against the epoch it started with. The cost of
+// the design is that every thread re-grounds a new epoch on its first query
+// against it, so Publish() is meant for batches, not single facts.
+//
+// Since the snapshot format is restricted to objective knowledge bases,
+// so is the service: Add() rejects conditional beliefs.
+
+#ifndef LIMBO_SERVICE_H_
+#define LIMBO_SERVICE_H_
+
+#include <cassert>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <limbo/clause.h>
+#include <limbo/formula.h>
+#include <limbo/knowledge_base.h>
+#include <limbo/literal.h>
+#include <limbo/term.h>
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+
+class KnowledgeBaseService {
+ public:
+  KnowledgeBaseService(Symbol::Factory* sf, Term::Factory* tf) : sf_(sf), tf_(tf), master_(sf, tf) {
+    Publish();
+  }
+
+  KnowledgeBaseService(const KnowledgeBaseService&) = delete;
+  KnowledgeBaseService& operator=(const KnowledgeBaseService&) = delete;
+
+  void AddReal(Literal a) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    master_.AddReal(a);
+  }
+
+  void Add(const Clause& c) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    master_.Add(c);
+  }
+
+  bool Add(const Formula& alpha) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    return master_.Add(alpha);
+  }
+
+  // Makes everything added so far visible to the readers as a new epoch.
+  // Returns false and publishes nothing if the master knowledge base cannot
+  // be snapshotted (that is, a conditional belief slipped in through the
+  // Formula overload of Add()).
+  bool Publish() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    std::ostringstream os;
+    if (!master_.Save(&os)) {
+      return false;
+    }
+    auto snapshot = std::make_shared<const Snapshot>(Snapshot{next_epoch(), os.str()});
+    std::atomic_store(&snapshot_, std::move(snapshot));
+    return true;
+  }
+
+  // Evaluates the query against the latest epoch published before the call.
+  // Safe to call from any number of threads concurrently.
+  bool Entails(const Formula& sigma, bool distribute = true) {
+    return replica()->Entails(sigma, distribute);
+  }
+
+ private:
+  struct Snapshot {
+    internal::u64 epoch;
+    std::string bytes;
+  };
+
+  struct Replica {
+    internal::u64 epoch = 0;
+    std::unique_ptr<KnowledgeBase> kb;
+  };
+
+  // Epochs are drawn from one global counter so that a replica left behind
+  // by a destroyed service can never alias an epoch of a new service that
+  // happens to live at the same address.
+  static internal::u64 next_epoch() {
+    static std::atomic<internal::u64> counter{0};
+    return ++counter;
+  }
+
+  // The calling thread's replica of the latest published epoch. Replicas of
+  // a destroyed service linger until their thread exits, which costs their
+  // memory but nothing else.
+  KnowledgeBase* replica() {
+    static thread_local std::unordered_map<const KnowledgeBaseService*, Replica> replicas;
+    const std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&snapshot_);
+    Replica& r = replicas[this];
+    if (r.epoch != snapshot->epoch) {
+      std::unique_ptr<KnowledgeBase> kb(new KnowledgeBase(sf_, tf_));
+      std::istringstream is(snapshot->bytes);
+      const bool ok = kb->Load(&is);
+      assert(ok);
+      (void) ok;
+      r.kb = std::move(kb);
+      r.epoch = snapshot->epoch;
+    }
+    return r.kb.get();
+  }
+
+  Symbol::Factory* sf_;
+  Term::Factory* tf_;
+  std::mutex writer_mutex_;
+  KnowledgeBase master_;
+  std::shared_ptr<const Snapshot> snapshot_;
+};
+
+}  // namespace limbo
+
+#endif  // LIMBO_SERVICE_H_
@@ -5,7 +5,10 @@
 // Setups are collections of primitive clauses, which are added with
 // AddClause() and AddUnit(), where the former is more lightweight.
 // A setup is not automatically minimal wrt unit propagation and subsumption;
-// to ensure minimality, call Minimize().
+// to ensure minimality, call Minimize(). Clauses that are literal-for-literal
+// identical to a stored clause are detected through a fingerprint table
+// keyed by clause hash and skipped by AddClause(), so re-grounding the same
+// instantiations does not pile up duplicates.
 //
 // The typical lifecycle is to create a Setup object, use AddClause() to
 // populate it, evaluate queries with Subsumes(), Determines(), Consistent(),
@@ -18,6 +21,13 @@
 // lifecycle of any ShallowCopies, Minimize() must not be called, as it leads
 // to undefined behaviour.
 //
+// Spawn() creates a snapshot view of a setup: the clauses added so far become
+// an immutable base shared by reference, and the spawned setup layers its own
+// clauses, unit clauses and watched literals on top. Spawned setups can hence
+// evaluate queries in parallel over the same knowledge base without
+// duplicating the clause storage and without synchronization, as long as the
+// spawning setup is left untouched in the meantime.
+//
 // Subsumes() checks whether the clause is subsumed by any clause in the setup
 // after doing unit propagation; it is hence a sound but incomplete test for
 // entailment.
@@ -27,11 +37,13 @@
 // clause, the null term is returned, that is, n.null() holds, to indicate
 // that the setup entails [t=n] for arbitrary n.
 //
-// Consistent() and LocallyConsistent() perform a sound but incomplete
-// consistency checks. The former only investigates clauses that share a one
-// of a given set of primitive terms. Typically one wants this set of terms
-// to be transitively closed under the terms occurring in setup clauses. It
-// is the users responsibility to make sure this condition holds.
+// Consistent() performs a sound but incomplete consistency check: it fails
+// iff the setup contains the empty clause or two complementary literals occur
+// among the unit clauses and the unit-propagated views of the clauses. The
+// number of complementary pairs is maintained incrementally: AddClause() and
+// AddUnit() update per-literal occurrence counts and a pair counter, and
+// ShallowCopy rolls the updates back through a journal, so the check itself
+// is a constant-time read instead of a scan over the setup.
 //
 // The setup is implemented using watched literals: the empty clause and unit
 // clauses are stored separately from clauses with >= 2 literals, and for each
@@ -51,6 +63,16 @@
 // in particular satisfy their invariant of not being subsumed by any unit
 // clause at this earlier point, so we do not need to adjust them.
 //
+// To avoid scanning all clauses during unit propagation, an index maps every
+// lhs term to the clauses that watch a literal with this term, so a new unit
+// clause only visits the clauses that can actually react to it. Subsumption
+// queries use the same index, for a clause can only subsume the query clause
+// if its watched literals' lhs terms occur in the query clause; the unit
+// clauses are likewise looked up by lhs term instead of scanned. The index is
+// maintained lazily: entries are appended when the watched literals change,
+// and entries that have become stale due to later watch updates or
+// backtracking are skipped and pruned the next time their term is visited.
+//
 // The copy constructor and assignment operators are deleted, not for technical
 // reasons, but because it may likely lead to complications with the linked
 // structure of setups and therefore hints at a programming error.
@@ -61,7 +83,8 @@
 #include <cassert>
 
 #include <algorithm>
-#include <unordered_set>
+#include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -69,9 +92,13 @@
 #include <limbo/literal.h>
 #include <limbo/term.h>
 
+#include <limbo/internal/intmap.h>
 #include <limbo/internal/ints.h>
 #include <limbo/internal/iter.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/memory.h>
+#include <limbo/internal/stats.h>
+#include <limbo/internal/timers.h>
 
 namespace limbo {
 
@@ -133,14 +160,32 @@ class Setup {
     void Kill() {
       if (setup_) {
         assert(data_.empty_clause + data_.n_clauses + data_.n_units == 0 || setup_->saved_-- > 0);
+        setup_->UndoJournal(data_.n_journal);
         setup_->empty_clause_ = data_.empty_clause;
+        for (size_t i = data_.n_units; i < setup_->units_.size(); ++i) {
+          setup_->RemoveLhs(setup_->units_[i].lhs());
+        }
+        for (size_t i = data_.n_clauses; i < setup_->clauses_.size(); ++i) {
+          for (const Literal a : setup_->clauses_.literals(i)) {
+            setup_->RemoveLhs(a.lhs());
+          }
+        }
         setup_->units_.Resize(data_.n_units);
         setup_->clauses_.Resize(data_.n_clauses);
+        setup_->removed_.resize(data_.n_clauses);
+        setup_->dead_.resize(data_.n_clauses);
+        setup_->touched_.resize(data_.n_clauses);
+        --setup_->n_shallow_;
         setup_ = nullptr;
       }
     }
 
-    void Immortalize() { setup_ = nullptr; }
+    void Immortalize() {
+      if (setup_) {
+        --setup_->n_shallow_;
+      }
+      setup_ = nullptr;
+    }
 
     Setup& setup() { return *setup_; }
     const Setup& setup() const { return *setup_; }
@@ -178,17 +223,22 @@ class Setup {
 
     struct Data {
       Data() = default;
-      Data(bool ec, size_t nc, size_t nu) : empty_clause(ec), n_clauses(nc), n_units(nu) {}
+      Data(bool ec, size_t nc, size_t nu, size_t nj)
+          : empty_clause(ec), n_clauses(nc), n_units(nu), n_journal(nj) {}
       bool empty_clause = false;
       size_t n_clauses = 0;
       size_t n_units = 0;
+      size_t n_journal = 0;
 #ifndef NDEBUG
       size_t saved = 0;
 #endif
     };
 
-    explicit ShallowCopy(Setup* s) : setup_(s), data_(Data(s->empty_clause_, s->clauses_.size(), s->units_.size())) {
+    explicit ShallowCopy(Setup* s)
+        : setup_(s),
+          data_(Data(s->empty_clause_, s->clauses_.size(), s->units_.size(), s->journal_.size())) {
       assert(data_.empty_clause + data_.n_clauses + data_.n_units == 0 || ++setup_->saved_ > 0);
+      ++setup_->n_shallow_;
 #ifndef NDEBUG
       data_.saved = s->saved_;
 #endif
@@ -206,6 +256,46 @@ class Setup {
 
   ShallowCopy shallow_copy() { return ShallowCopy(this); }
 
+  // Spawn() returns a setup that shares this setup's clauses as an immutable,
+  // reference-counted base and layers its own clauses and unit clauses on
+  // top. The base is never modified through a spawned setup, so any number of
+  // spawned setups can evaluate queries concurrently without copying the
+  // clause storage, and each of them supports ShallowCopy() backtracking as
+  // usual. Only the unit clauses, the watched literals and the watcher index
+  // are copied, which are small compared to the clauses themselves. The
+  // spawning setup must not be modified while spawned setups are in use.
+  Setup Spawn() const {
+    Setup s;
+    s.empty_clause_ = empty_clause_;
+    s.units_ = units_;
+    s.clauses_ = clauses_.Spawn();
+    s.occur_ = occur_;
+    s.removed_ = removed_;
+    s.dead_ = dead_;
+    s.touched_ = touched_;
+    s.view_counts_ = view_counts_;
+    s.pos_counts_ = pos_counts_;
+    s.comp_pairs_ = comp_pairs_;
+    s.activity_ = activity_;
+    s.fingerprints_ = fingerprints_;
+    s.lhs_counts_ = lhs_counts_;
+    return s;
+  }
+
+  // Pre-sizes the clause store, the unit clauses, and the per-clause
+  // bookkeeping for n_clauses clauses with n_literals literals in total, so
+  // that populating the setup does not relocate them step by step. Units and
+  // proper clauses share the budget: every added clause lands in one of the
+  // two stores, so at most n_clauses records are needed in either. The hash
+  // indexes rehash geometrically and are left alone.
+  void Reserve(size_t n_clauses, size_t n_literals) {
+    clauses_.Reserve(n_clauses, n_literals);
+    units_.Reserve(n_clauses);
+    removed_.reserve(n_clauses);
+    dead_.reserve(n_clauses);
+    touched_.reserve(n_clauses);
+  }
+
   void Minimize() {
     Minimize(0, 0);
     units_.SealOriginalUnits();  // units_.set() have been eliminated from all clauses, so not needed in AddUnit()
@@ -226,12 +316,19 @@ class Setup {
       empty_clause_ |= ur == kInconsistent;
       return ur;
     } else {
+      const internal::hash64_t h = c.hash();
+      if (FindDuplicate(h, c)) {
+        return kSubsumed;
+      }
       clauses_.Add(c);
+      RegisterClauseInView(clauses_.size() - 1, c);
+      fingerprints_.emplace(h, clauses_.size() - 1);
       return kOk;
     }
   }
 
   Result AddUnit(Literal a) {
+    LIMBO_TIMERS_SCOPE(internal::Timers::kPropagate);
     assert(a.primitive());
     assert(!a.valid() && !a.unsatisfiable());
     if (empty_clause_) {
@@ -239,31 +336,46 @@ class Setup {
     }
     size_t n_propagated = units_.size();
     const Result ur = units_.Add(a);
+    if (ur == kOk) {
+      AddLhs(a.lhs());
+    }
     empty_clause_ = ur == kInconsistent;
     for (; n_propagated < units_.size() && !empty_clause_; ++n_propagated) {
       a = units_[n_propagated];
-      for (size_t i = 0; i < clauses_.size() && !empty_clause_; ++i) {
+      UpdateViewForUnit(a);
+      clauses_.VisitWatchers(a.lhs(), [this, a](size_t i) {
+        if (empty_clause_) {
+          return;
+        }
         if (Literal::Complementary(clauses_.watched(i).a, a) ||
             Literal::Complementary(clauses_.watched(i).b, a)) {
           Clause c = clauses_[i];
           const Clause::Result pr = c.PropagateUnits(units_.set());
           if (pr == Clause::kPropagated) {
+            LIMBO_STATS_DO(++internal::Stats::Local().unit_propagations);
+            BumpActivity(a.lhs());
             if (c.size() == 0) {
               empty_clause_ = true;
+              BumpActivity(a.lhs());
             } else if (c.size() == 1) {
+              BumpActivity(c.first().lhs());
               const Result ur = units_.Add(c.first());
+              if (ur == kOk) {
+                AddLhs(c.first().lhs());
+              }
               empty_clause_ = ur == kInconsistent;
             } else {
               clauses_.Watch(i, c.first(), c.last());
             }
           }
         }
-      }
+      });
     }
     return empty_clause_ ? kInconsistent : ur;
   }
 
   bool Subsumes(const Clause& c) const {
+    LIMBO_TIMERS_SCOPE(internal::Timers::kSubsume);
     assert(c.ground());
     if (empty_clause_) {
       return true;
@@ -274,23 +386,33 @@ class Setup {
     if (!c.primitive()) {
       return c.valid();
     }
-    for (size_t i = 0; i < units_.size(); ++i) {
-      if (Clause::Subsumes(units_[i], c)) {
-        return true;
-      }
+    if (!MentionsSomeLhsOf(c)) {
+      return false;
+    }
+    if (units_.Subsumes(c)) {
+      return true;
     }
     if (c.unit() && c.first().pos()) {
       return false;
     }
     assert(c.size() >= 1 && (c.size() >= 2 || !c.first().pos()));
-    for (size_t i = 0; i < clauses_.size(); ++i) {
-      if (Clause::Subsumes(clauses_.watched(i).a, clauses_.watched(i).b, c)) {
-        Clause d = clauses_[i];
-        const Clause::Result pr = d.PropagateUnits(units_.set());
-        assert(pr != Clause::kSubsumed);
-        if (pr == Clause::kSubsumed || Clause::Subsumes(d, c)) {
-          return true;
+    bool subsumed = false;
+    for (const Literal b : c) {
+      clauses_.VisitWatchers(b.lhs(), [this, &c, &subsumed](size_t i) {
+        if (subsumed) {
+          return;
         }
+        if (Clause::Subsumes(clauses_.watched(i).a, clauses_.watched(i).b, c)) {
+          Clause d = clauses_[i];
+          const Clause::Result pr = d.PropagateUnits(units_.set());
+          assert(pr != Clause::kSubsumed);
+          if (pr == Clause::kSubsumed || Clause::Subsumes(d, c)) {
+            subsumed = true;
+          }
+        }
+      });
+      if (subsumed) {
+        return true;
       }
     }
     return false;
@@ -298,6 +420,7 @@ class Setup {
 
   template<typename InputIt>
   bool Subsumes(const Clause& c, InputIt first_clause, InputIt last_clause) const {
+    LIMBO_TIMERS_SCOPE(internal::Timers::kSubsume);
     assert(c.ground());
     if (empty_clause_) {
       return true;
@@ -308,10 +431,11 @@ class Setup {
     if (!c.primitive()) {
       return c.valid();
     }
-    for (size_t i = 0; i < units_.size(); ++i) {
-      if (Clause::Subsumes(units_[i], c)) {
-        return true;
-      }
+    if (!MentionsSomeLhsOf(c)) {
+      return false;
+    }
+    if (units_.Subsumes(c)) {
+      return true;
     }
     if (c.unit() && c.first().pos()) {
       return false;
@@ -337,10 +461,64 @@ class Setup {
     return false;
   }
 
+  // Sound but incomplete consistency check: fails iff the setup contains the
+  // empty clause or two complementary literals occur among the unit clauses
+  // and the unit-propagated views of the clauses. The complementary pair
+  // count is maintained incrementally by AddClause() and AddUnit() and rolled
+  // back by ShallowCopy, so this is a constant-time read.
+  bool Consistent() const { return !empty_clause_ && comp_pairs_ == 0; }
+
+  // The activity of a term grows when it participates in unit propagation or
+  // in the derivation of the empty clause; Solver::Split() prefers terms with
+  // high activity (in the style of VSIDS in SAT solvers). Activities are a
+  // pure heuristic and hence deliberately not rolled back by ShallowCopy:
+  // terms that caused conflicts in abandoned branches are good candidates.
+  double activity(Term t) const {
+    const auto it = activity_.find(t);
+    return it != activity_.end() ? it->second : 0.0;
+  }
+
   bool contains_empty_clause() const { return empty_clause_; }
 
-  const std::unordered_set<Literal, Literal::LhsHash>& units() const { return units_.set(); }
-  const std::vector<Clause>& non_units() const { return clauses_.vec(); }
+  // True iff t occurs as the lhs of some stored unit clause or clause. The
+  // occurrence counts are exact (maintained by the add, backtracking and
+  // Minimize() paths), so a miss means the setup holds no knowledge about t
+  // whatsoever, and queries that mention only unknown terms can be answered
+  // without touching the clause indexes at all.
+  bool MentionsLhs(Term t) const {
+    return t.index() < lhs_counts_.n_keys() && lhs_counts_[t.index()] > 0;
+  }
+
+  bool MentionsSomeLhsOf(const Clause& c) const {
+    return c.any([this](const Literal a) { return MentionsLhs(a.lhs()); });
+  }
+
+  // The bytes held by the clause store, the unit clauses, and the indexes
+  // around them (see internal/memory.h for the accounting overview). Meant
+  // for attribution, not exact bookkeeping: the containers' per-allocation
+  // overhead is not counted.
+  internal::u64 memory_bytes() const {
+    internal::u64 n = clauses_.memory_bytes() + units_.memory_bytes();
+    n += internal::unordered_memory_bytes(occur_);
+    for (const auto& p : occur_) {
+      n += p.second.capacity() * sizeof(size_t);
+    }
+    n += internal::unordered_memory_bytes(fingerprints_);
+    n += removed_.capacity() * sizeof(std::vector<bool>);
+    for (const std::vector<bool>& v : removed_) {
+      n += v.capacity() / 8;
+    }
+    n += touched_.capacity() / 8 + dead_.capacity() / 8;
+    n += internal::unordered_memory_bytes(view_counts_);
+    n += internal::unordered_memory_bytes(pos_counts_);
+    n += lhs_counts_.n_keys() * sizeof(size_t);
+    n += internal::unordered_memory_bytes(activity_);
+    n += journal_.capacity() * sizeof(ViewOp);
+    return n;
+  }
+
+  const Literal::LhsSet& units() const { return units_.set(); }
+  const std::vector<Literal>& units_vec() const { return units_.vec(); }
 
   Maybe<Term> Determines(Term lhs) const {
     assert(lhs.primitive());
@@ -395,52 +573,203 @@ class Setup {
     Literal b;
   };
 
+  // Clauses are stored in structure-of-arrays fashion: all literals live in
+  // one contiguous buffer, and per clause only an (offset, length) record is
+  // kept, next to the parallel vector of watched literals. Propagation and
+  // subsumption hence stream the literals linearly through memory instead of
+  // hopping between the clauses' own allocations. Erase() leaves holes in
+  // the buffer, which Compact() -- called at the end of Minimize() --
+  // removes again.
   class Clauses {
    public:
-    const Clause& operator[](size_t i) const { return clauses_[i]; }
-    Clause& operator[](size_t i) { return clauses_[i]; }
+    // A view of a clause's literals in the packed buffer; it is invalidated
+    // by any modification of the store.
+    struct LiteralRange {
+      const Literal* begin() const { return first; }
+      const Literal* end()   const { return last; }
+      size_t size() const { return last - first; }
+      Literal operator[](size_t p) const { assert(p < size()); return first[p]; }
+
+      const Literal* first;
+      const Literal* last;
+    };
+
+    Clause operator[](size_t i) const {
+      const LiteralRange r = literals(i);
+      return Clause(r.size(), r.begin(), r.end());
+    }
+
+    LiteralRange literals(size_t i) const {
+      const Store& s = i < n_base() ? *base_ : *own_;
+      const Record r = s.recs[i < n_base() ? i : i - n_base()];
+      const Literal* first = s.lits.data() + r.offset;
+      return LiteralRange{first, first + r.size};
+    }
 
     Watched watched(size_t i) const { return watched_[i]; }
     Watched& watched(size_t i) { return watched_[i]; }
 
-    void Add(const Clause& c) {
-      assert(c.size() >= 2);
-      watched_.push_back(Watched(c.first(), c.last()));
-      clauses_.push_back(c);
+    // The bytes held by the literal store, the watched-literal pairs, and
+    // the watcher index. A base store shared through Spawn() is counted by
+    // every setup that references it.
+    internal::u64 memory_bytes() const {
+      internal::u64 n = 0;
+      for (const Store* s : {base_.get(), static_cast<const Store*>(own_.get())}) {
+        if (s != nullptr) {
+          n += s->lits.capacity() * sizeof(Literal) + s->recs.capacity() * sizeof(Record);
+        }
+      }
+      n += watched_.capacity() * sizeof(Watched);
+      n += internal::unordered_memory_bytes(watchers_);
+      for (const auto& p : watchers_) {
+        n += p.second.capacity() * sizeof(size_t);
+      }
+      return n;
+    }
+
+    // Returns a Clauses object that shares this object's clauses as an
+    // immutable, reference-counted base and stores its own additions
+    // separately. The watched literals and the watcher index are copied,
+    // since unit propagation adjusts them even for base clauses.
+    Clauses Spawn() const {
+      assert(base_ == nullptr || own_->recs.empty());
+      Clauses c;
+      c.base_ = base_ != nullptr ? base_ : own_;
+      c.watched_ = watched_;
+      c.watchers_ = watchers_;
+      return c;
     }
 
-    void Add(Clause&& c) {
+    // Pre-sizes the packed buffer for n_clauses own clauses with n_literals
+    // literals in total, so that a burst of Add() calls does not relocate it.
+    void Reserve(size_t n_clauses, size_t n_literals) {
+      own_->recs.reserve(own_->recs.size() + n_clauses);
+      own_->lits.reserve(own_->lits.size() + n_literals);
+      watched_.reserve(watched_.size() + n_clauses);
+    }
+
+    void Add(const Clause& c) {
       assert(c.size() >= 2);
       watched_.push_back(Watched(c.first(), c.last()));
-      clauses_.push_back(std::forward<Clause>(c));
+      own_->recs.push_back(Record(own_->lits.size(), c.size()));
+      own_->lits.insert(own_->lits.end(), c.begin(), c.end());
+      AddWatchers(size() - 1, watched_.back());
     }
 
     void Watch(size_t i, Literal a, Literal b) {
       assert(a < b);
+      const Watched w = watched_[i];
       watched_[i] = Watched(a, b);
+      if (a.lhs() != w.a.lhs() && a.lhs() != w.b.lhs()) {
+        watchers_[a.lhs()].push_back(i);
+      }
+      if (b.lhs() != a.lhs() && b.lhs() != w.a.lhs() && b.lhs() != w.b.lhs()) {
+        watchers_[b.lhs()].push_back(i);
+      }
+    }
+
+    // Calls f for every clause that currently watches a literal with lhs t.
+    // Entries that are stale or duplicates due to backtracking or later calls
+    // of Watch() are pruned on the way. f may update the watched literals of
+    // the visited clause, but must not add or remove clauses.
+    template<typename UnaryFunction>
+    void VisitWatchers(Term t, UnaryFunction f) const {
+      const auto it = watchers_.find(t);
+      if (it == watchers_.end()) {
+        return;
+      }
+      std::vector<size_t>& ws = it->second;
+      size_t n = 0;
+      for (size_t j = 0; j < ws.size(); ++j) {
+        const size_t i = ws[j];
+        if (i < size() && (watched_[i].a.lhs() == t || watched_[i].b.lhs() == t) &&
+            (n == 0 || ws[n-1] != i)) {
+          ws[n++] = i;
+          f(i);
+        }
+      }
+      ws.resize(n);
+      if (ws.empty()) {
+        watchers_.erase(t);
+      }
     }
 
     size_t size() const {
-      assert(clauses_.size() == watched_.size());
-      return clauses_.size();
+      assert(n_base() + own_->recs.size() == watched_.size());
+      return watched_.size();
     }
 
     void Erase(size_t i) {
-      std::swap(clauses_[i], clauses_.back());
+      assert(i >= n_base());
+      std::swap(own_->recs[i - n_base()], own_->recs.back());
+      own_->recs.pop_back();
       std::swap(watched_[i], watched_.back());
-      Resize(clauses_.size() - 1);
+      watched_.pop_back();
+      if (i < size()) {
+        AddWatchers(i, watched_[i]);
+      }
     }
 
     void Resize(size_t n) {
-      clauses_.resize(n);
+      // Only whole suffixes of appended clauses are ever cut off, and
+      // Compact() restores the records' append order after Minimize(), so
+      // the buffer always ends where the last remaining clause does.
+      assert(n >= n_base());
+      const size_t m = n - n_base();
+      own_->recs.resize(m);
+      own_->lits.resize(m > 0 ? own_->recs.back().offset + own_->recs.back().size : 0);
       watched_.resize(n);
     }
 
-    const std::vector<Clause>& vec() const { return clauses_; }
+    // Rebuilds the literal buffer densely in record order, dropping the
+    // holes left behind by Erase(). Does nothing when there are none.
+    void Compact() {
+      size_t n = 0;
+      bool dense = true;
+      for (const Record& r : own_->recs) {
+        dense = dense && r.offset == n;
+        n += r.size;
+      }
+      if (dense && n == own_->lits.size()) {
+        return;
+      }
+      std::vector<Literal> lits;
+      lits.reserve(n);
+      for (Record& r : own_->recs) {
+        const size_t offset = lits.size();
+        lits.insert(lits.end(), own_->lits.begin() + r.offset, own_->lits.begin() + r.offset + r.size);
+        r.offset = offset;
+      }
+      own_->lits = std::move(lits);
+    }
 
    private:
-    std::vector<Clause> clauses_;
+    struct Record {
+      Record() = default;
+      Record(size_t offset, size_t size) : offset(offset), size(size) {}
+
+      size_t offset = 0;
+      size_t size = 0;
+    };
+
+    struct Store {
+      std::vector<Literal> lits;
+      std::vector<Record> recs;
+    };
+
+    void AddWatchers(size_t i, Watched w) {
+      watchers_[w.a.lhs()].push_back(i);
+      if (w.b.lhs() != w.a.lhs()) {
+        watchers_[w.b.lhs()].push_back(i);
+      }
+    }
+
+    size_t n_base() const { return base_ != nullptr ? base_->recs.size() : 0; }
+
+    std::shared_ptr<const Store> base_;
+    std::shared_ptr<Store> own_ = std::make_shared<Store>();
     std::vector<Watched> watched_;
+    mutable std::unordered_map<Term, std::vector<size_t>> watchers_;
   };
 
   class Units {
@@ -452,6 +781,11 @@ class Setup {
       return vec_.size();
     }
 
+    void Reserve(size_t n) {
+      vec_.reserve(vec_.size() + n);
+      set_.Reserve(set_.size() + n);
+    }
+
     Result Add(Literal a) {
       const auto orig_end = vec_.begin() + n_orig_;
       const auto orig_begin = std::lower_bound(vec_.begin(), orig_end, Literal::Min(a.lhs()));
@@ -463,28 +797,36 @@ class Setup {
           return kSubsumed;
         }
       }
-      if (set_.bucket_count() > 0) {
-        const auto bucket = set_.bucket(a);
-        for (auto it = set_.begin(bucket), end = set_.end(bucket); it != end; ++it) {
-          if (Literal::Complementary(a, *it)) {
-            return kInconsistent;
-          }
-          if (it->Subsumes(a)) {
-            return kSubsumed;
-          }
-        }
+      bool inconsistent = false;
+      bool subsumed = false;
+      set_.AnyWithLhs(a.lhs(), [a, &inconsistent, &subsumed](const Literal b) {
+        inconsistent = Literal::Complementary(a, b);
+        subsumed = b.Subsumes(a);
+        return inconsistent || subsumed;
+      });
+      if (inconsistent) {
+        return kInconsistent;
+      }
+      if (subsumed) {
+        return kSubsumed;
       }
-      assert(set_.count(a) == 0);
+      assert(!set_.Contains(a));
       assert(std::find(vec_.begin(), vec_.end(), a) == vec_.end());
-      set_.insert(a);
+      set_.Insert(a);
       vec_.push_back(a);
+      if (a.pos()) {
+        determined_[a.lhs().index()] = a.rhs();
+      }
       return kOk;
     }
 
     void Resize(size_t n) {
       assert(n == 0 || n >= n_orig_);
       for (size_t i = n; i < vec_.size(); ++i) {
-        set_.erase(vec_[i]);
+        set_.Erase(vec_[i]);
+        if (vec_[i].pos()) {
+          determined_[vec_[i].lhs().index()] = Term();
+        }
       }
       vec_.resize(n);
       if (n == 0) {
@@ -494,7 +836,10 @@ class Setup {
 
     void Erase(size_t i) {
       assert(n_orig_ == 0);
-      set_.erase(vec_[i]);
+      set_.Erase(vec_[i]);
+      if (vec_[i].pos()) {
+        determined_[vec_[i].lhs().index()] = Term();
+      }
       std::swap(vec_[i], vec_.back());
       vec_.resize(vec_.size() - 1);
     }
@@ -503,50 +848,75 @@ class Setup {
       std::sort(vec_.begin(), vec_.end());
       vec_.erase(std::unique(vec_.begin(), vec_.end()), vec_.end());
       n_orig_ = vec_.size();
-      set_.clear();
+      set_.Clear();
     }
 
     void UnsealOriginalUnits() {
       for (size_t i = 0; i < n_orig_; ++i) {
-        set_.insert(vec_[i]);
+        set_.Insert(vec_[i]);
       }
       n_orig_ = 0;
     }
 
-    Maybe<Term> Determines(Term t) const {
-      assert(t.primitive());
-      const auto orig_end = vec_.begin() + n_orig_;
-      const auto orig_begin = std::lower_bound(vec_.begin(), orig_end, Literal::Min(t));
-      for (auto it = orig_begin; it != orig_end && t == it->lhs(); ++it) {
-        if (it->pos()) {
-          return internal::Just(it->rhs());
-        }
-      }
-      if (set_.bucket_count() > 0) {
-        auto bucket = set_.bucket(Literal::Min(t));
-        for (auto it = set_.begin(bucket), end = set_.end(bucket); it != end; ++it) {
-          if (it->lhs() == t && it->pos()) {
-            return internal::Just(it->rhs());
+    // Checks whether some unit clause subsumes some literal of c. Only the
+    // unit clauses whose lhs occurs in c are looked at: the sealed region of
+    // vec_ is sorted and searched by lower bound, the rest is found through
+    // the lhs-grouped probe chains of set_.
+    bool Subsumes(const Clause& c) const {
+      for (const Literal b : c) {
+        const auto orig_end = vec_.begin() + n_orig_;
+        const auto orig_begin = std::lower_bound(vec_.begin(), orig_end, Literal::Min(b.lhs()));
+        for (auto it = orig_begin; it != orig_end && b.lhs() == it->lhs(); ++it) {
+          if (it->Subsumes(b)) {
+            return true;
           }
         }
+        if (set_.AnyWithLhs(b.lhs(), [b](const Literal a) { return a.Subsumes(b); })) {
+          return true;
+        }
       }
-      return internal::Nothing;
+      return false;
     }
 
-    const std::vector<Literal>&                          vec() const { return vec_; }
-    const std::unordered_set<Literal, Literal::LhsHash>& set() const { return set_; }
+    // Since at most one positive unit clause per lhs term can be added
+    // without inconsistency, the determined name is maintained in a dense map
+    // from primitive-term index to name, so the lookup is a single array
+    // load. The map is updated in Add() and rolled back in Resize() and
+    // Erase().
+    Maybe<Term> Determines(Term t) const {
+      assert(t.primitive());
+      const Term n = t.index() < determined_.n_keys() ? determined_[t.index()] : Term();
+      return !n.null() ? internal::Just(n) : internal::Nothing;
+    }
+
+    const std::vector<Literal>& vec() const { return vec_; }
+    const Literal::LhsSet&      set() const { return set_; }
+
+    internal::u64 memory_bytes() const { return vec_.capacity() * sizeof(Literal) + set_.memory_bytes(); }
 
    private:
     std::vector<Literal> vec_;
-    std::unordered_set<Literal, Literal::LhsHash> set_;
+    Literal::LhsSet set_;
+    internal::IntMap<internal::u32, Term> determined_;
     size_t n_orig_ = 0;
   };
 
   void Minimize(const size_t n_clauses, const size_t n_units) {
     assert(n_clauses + n_units > 0 || saved_ == 0);
     if (empty_clause_) {
+      for (size_t i = n_units; i < units_.size(); ++i) {
+        RemoveLhs(units_[i].lhs());
+      }
+      for (size_t i = n_clauses; i < clauses_.size(); ++i) {
+        for (const Literal a : clauses_.literals(i)) {
+          RemoveLhs(a.lhs());
+        }
+      }
       clauses_.Resize(n_clauses);
       units_.Resize(n_units);
+      removed_.resize(n_clauses);
+      dead_.resize(n_clauses);
+      touched_.resize(n_clauses);
       return;
     }
     for (size_t i = n_units; i < units_.size(); ++i) {
@@ -555,28 +925,318 @@ class Setup {
         units_.Erase(i);
         const Result ur = units_.Add(a);
         assert(ur != kInconsistent), (void) ur;
+        if (ur != kOk) {
+          RemoveLhs(a.lhs());
+        }
       }
     }
     for (size_t i = clauses_.size(); i > n_clauses; --i) {
-      Clause c;
-      std::swap(c, clauses_[i - 1]);
+      if (!touched_[i - 1]) {
+        assert([&]() { Clause c = clauses_[i - 1];
+                       return c.PropagateUnits(units_.set()) == Clause::kUnchanged; }());
+        continue;
+      }
+      Clause c = clauses_[i - 1];
       const Clause::Result pr = c.PropagateUnits(units_.set());
       if (pr == Clause::kUnchanged) {
         assert(c.size() >= 2);
-        std::swap(c, clauses_[i - 1]);
+        touched_[i - 1] = false;
       } else {
         assert(c.size() >= 1);
+        assert((pr == Clause::kSubsumed) == bool(dead_[i - 1]));
+        if (pr == Clause::kPropagated) {
+          // c is exactly the part of the clause that is still in the index.
+          const Clause& cc = c;
+          for (const Literal b : cc) {
+            RemoveFromView(b);
+            Journal(ViewOp::Remove(b, i - 1, kNoPos));
+          }
+        }
+        for (const Literal b : clauses_.literals(i - 1)) {
+          RemoveLhs(b.lhs());
+        }
         clauses_.Erase(i - 1);
+        OnEraseClause(i - 1);
         if (pr == Clause::kPropagated && c.size() >= 2) {
           clauses_.Add(c);
+          RegisterClauseInView(clauses_.size() - 1, c);
+          fingerprints_.emplace(c.hash(), clauses_.size() - 1);
+        }
+      }
+    }
+    clauses_.Compact();
+  }
+
+  // True iff some stored clause with hash h is literal-for-literal identical
+  // to c. Fingerprint entries that have become stale due to backtracking or
+  // Minimize() are pruned on the way, like in Clauses::VisitWatchers().
+  bool FindDuplicate(internal::hash64_t h, const Clause& c) {
+    const auto range = fingerprints_.equal_range(h);
+    for (auto it = range.first; it != range.second; ) {
+      const size_t i = it->second;
+      if (i >= clauses_.size()) {
+        it = fingerprints_.erase(it);
+        continue;
+      }
+      const Clauses::LiteralRange r = clauses_.literals(i);
+      internal::hash64_t rh = 0;
+      for (const Literal a : r) {
+        rh ^= a.hash();
+      }
+      if (rh != h) {
+        it = fingerprints_.erase(it);
+        continue;
+      }
+      if (r.size() == c.size() && std::equal(r.begin(), r.end(), c.begin())) {
+        return true;
+      }
+      ++it;
+    }
+    return false;
+  }
+
+  // The complementary-literal index behind Consistent(). It mirrors the
+  // literals of the unit-propagated views of the clauses: view_counts_ and
+  // pos_counts_ count their occurrences, and comp_pairs_ is the number of
+  // complementary pairs among them. Complementary pairs involving unit
+  // clauses need no representation: two complementary unit clauses make the
+  // setup contain the empty clause, and literals complementary to a unit
+  // clause are propagated out of the views. Per clause, removed_ marks the
+  // literals falsified by some unit clause and dead_ marks clauses subsumed
+  // by a unit clause; occur_ maps every lhs term to the clauses that mention
+  // it, so a new unit clause only visits the clauses it can affect. All
+  // updates made during the lifecycle of a ShallowCopy are recorded in
+  // journal_ and undone when the ShallowCopy is killed.
+  //
+  // touched_ marks the clauses whose view has changed since the clause was
+  // last known to be fully propagated, so Minimize() only re-propagates
+  // those instead of rewriting the whole setup. The mark is conservative:
+  // rolling back a ShallowCopy leaves it set, and Minimize() clears it
+  // again when it finds the clause unchanged.
+
+  struct ViewOp {
+    enum Kind { kInsert, kRemove, kDeath };
+
+    static ViewOp Insert(Literal a) { return ViewOp{kInsert, a, 0, 0}; }
+    static ViewOp Remove(Literal a, size_t i, size_t p) { return ViewOp{kRemove, a, i, p}; }
+    static ViewOp Death(size_t i) { return ViewOp{kDeath, Literal(), i, 0}; }
+
+    Kind kind;
+    Literal a;
+    size_t clause;
+    size_t pos;
+  };
+
+  static constexpr size_t kNoPos = ~size_t(0);
+
+  size_t view_count(Literal a) const {
+    const auto it = view_counts_.find(a);
+    return it != view_counts_.end() ? it->second : 0;
+  }
+
+  size_t pos_count(Term t) const {
+    const auto it = pos_counts_.find(t);
+    return it != pos_counts_.end() ? it->second : 0;
+  }
+
+  // The number of indexed literals complementary to a: for [t = n] these are
+  // [t != n] and every [t = n'] with n' distinct from n, for [t != n] it is
+  // just [t = n].
+  size_t n_complementary(Literal a) const {
+    return a.pos() ? pos_count(a.lhs()) - view_count(a) + view_count(a.flip())
+                   : view_count(a.flip());
+  }
+
+  void AddToView(Literal a) {
+    comp_pairs_ += n_complementary(a);
+    ++view_counts_[a];
+    if (a.pos()) {
+      ++pos_counts_[a.lhs()];
+    }
+  }
+
+  void RemoveFromView(Literal a) {
+    const auto it = view_counts_.find(a);
+    assert(it != view_counts_.end() && it->second > 0);
+    if (--it->second == 0) {
+      view_counts_.erase(it);
+    }
+    if (a.pos()) {
+      const auto jt = pos_counts_.find(a.lhs());
+      if (--jt->second == 0) {
+        pos_counts_.erase(jt);
+      }
+    }
+    comp_pairs_ -= n_complementary(a);
+  }
+
+  // Updates are journaled only while some ShallowCopy is alive; outside of
+  // any ShallowCopy there is nothing to roll back to.
+  void Journal(ViewOp op) {
+    if (n_shallow_ > 0) {
+      journal_.push_back(op);
+    }
+  }
+
+  void UndoJournal(size_t n) {
+    while (journal_.size() > n) {
+      const ViewOp op = journal_.back();
+      journal_.pop_back();
+      switch (op.kind) {
+        case ViewOp::kInsert:
+          RemoveFromView(op.a);
+          break;
+        case ViewOp::kRemove:
+          AddToView(op.a);
+          if (op.clause < removed_.size() && op.pos < removed_[op.clause].size()) {
+            removed_[op.clause][op.pos] = false;
+          }
+          break;
+        case ViewOp::kDeath:
+          if (op.clause < dead_.size()) {
+            dead_[op.clause] = false;
+          }
+          break;
+      }
+    }
+  }
+
+  void RegisterClauseInView(size_t i, const Clause& c) {
+    assert(removed_.size() == i && dead_.size() == i && touched_.size() == i);
+    removed_.emplace_back(c.size(), false);
+    dead_.push_back(false);
+    touched_.push_back(false);
+    Term prev;
+    for (const Literal b : c) {
+      AddToView(b);
+      Journal(ViewOp::Insert(b));
+      AddLhs(b.lhs());
+      if (b.lhs() != prev) {
+        occur_[b.lhs()].push_back(i);
+        prev = b.lhs();
+      }
+    }
+  }
+
+  // Called after Clauses::Erase(i), which moved the last clause to index i:
+  // moves the bookkeeping along and re-registers the moved clause's
+  // occurrence entries under its new index.
+  void OnEraseClause(size_t i) {
+    const size_t last = removed_.size() - 1;
+    if (i != last) {
+      std::swap(removed_[i], removed_[last]);
+      const bool d = dead_[i];
+      dead_[i] = dead_[last];
+      dead_[last] = d;
+      const bool t = touched_[i];
+      touched_[i] = touched_[last];
+      touched_[last] = t;
+      Term prev;
+      for (const Literal b : clauses_.literals(i)) {
+        if (b.lhs() != prev) {
+          occur_[b.lhs()].push_back(i);
+          prev = b.lhs();
         }
       }
     }
+    removed_.pop_back();
+    dead_.pop_back();
+    touched_.pop_back();
   }
 
+  // Removes from the index the literals the new unit clause a falsifies, and
+  // the remaining literals of clauses a subsumes. Only clauses that mention
+  // a's lhs term can be affected; entries in their occurrence list that are
+  // stale or duplicates due to backtracking or Minimize() are pruned on the
+  // way, like in Clauses::VisitWatchers().
+  void UpdateViewForUnit(const Literal a) {
+    const auto it = occur_.find(a.lhs());
+    if (it == occur_.end()) {
+      return;
+    }
+    std::vector<size_t>& os = it->second;
+    if (!std::is_sorted(os.begin(), os.end())) {
+      std::sort(os.begin(), os.end());
+    }
+    size_t n = 0;
+    for (size_t j = 0; j < os.size(); ++j) {
+      const size_t i = os[j];
+      if (i < clauses_.size() && (n == 0 || os[n-1] != i)) {
+        const Clauses::LiteralRange c = clauses_.literals(i);
+        if (std::any_of(c.begin(), c.end(), [&a](Literal b) { return b.lhs() == a.lhs(); })) {
+          os[n++] = i;
+        }
+      }
+    }
+    os.resize(n);
+    if (os.empty()) {
+      occur_.erase(it);
+      return;
+    }
+    for (size_t j = 0; j < n; ++j) {
+      const size_t i = os[j];
+      if (dead_[i]) {
+        continue;
+      }
+      const Clauses::LiteralRange c = clauses_.literals(i);
+      bool dies = false;
+      for (size_t p = 0; p < c.size(); ++p) {
+        const Literal b = c[p];
+        if (b.lhs() != a.lhs()) {
+          continue;
+        }
+        if (!removed_[i][p] && Literal::Complementary(a, b)) {
+          removed_[i][p] = true;
+          touched_[i] = true;
+          RemoveFromView(b);
+          Journal(ViewOp::Remove(b, i, p));
+        }
+        dies |= a.Subsumes(b);
+      }
+      if (dies) {
+        for (size_t p = 0; p < c.size(); ++p) {
+          if (!removed_[i][p]) {
+            removed_[i][p] = true;
+            RemoveFromView(c[p]);
+            Journal(ViewOp::Remove(c[p], i, p));
+          }
+        }
+        dead_[i] = true;
+        touched_[i] = true;
+        Journal(ViewOp::Death(i));
+      }
+    }
+  }
+
+  void AddLhs(Term t) { ++lhs_counts_[t.index()]; }
+
+  void RemoveLhs(Term t) {
+    assert(t.index() < lhs_counts_.n_keys() && lhs_counts_[t.index()] > 0);
+    --lhs_counts_[t.index()];
+  }
+
+  void BumpActivity(Term t) { activity_[t] += 1.0; }
+
   bool empty_clause_ = false;
   Units units_;
   Clauses clauses_;
+  std::unordered_map<Term, std::vector<size_t>> occur_;
+  // Maps clause hashes to clause indices so that AddClause() can skip exact
+  // duplicates; entries invalidated by backtracking or Minimize() are
+  // pruned lazily by FindDuplicate().
+  std::unordered_multimap<internal::hash64_t, size_t> fingerprints_;
+  std::vector<std::vector<bool>> removed_;
+  std::vector<bool> touched_;
+  std::vector<bool> dead_;
+  std::unordered_map<Literal, size_t> view_counts_;
+  std::unordered_map<Term, size_t> pos_counts_;
+  size_t comp_pairs_ = 0;
+  // The number of lhs occurrences per primitive-term index over all stored
+  // unit clauses and clauses; the term-universe filter behind MentionsLhs().
+  internal::IntMap<internal::u32, size_t> lhs_counts_;
+  std::unordered_map<Term, double> activity_;
+  std::vector<ViewOp> journal_;
+  size_t n_shallow_ = 0;
 #ifndef NDEBUG
   mutable size_t saved_ = 0;
 #endif
@@ -12,7 +12,11 @@
 // The method EntailsComplete() uses Consistent() to implement a complete but
 // unsound entailment relation. It is safe to call AddClause() between
 // evaluating queries with Entails(), Determines(), EntailsComplete(), or
-// Consistent().
+// Consistent(). EntailsAll() answers a batch of queries over a single shared
+// grounding, which is much cheaper than a loop of Entails() calls.
+// EntailsWithin() is an anytime variant of Entails() that iteratively deepens
+// the belief level until a deadline passes and reports the deepest completed
+// level together with its verdict.
 //
 // Splitting and assigning is done at a deterministic point, namely after
 // reducing the outermost logical operators with conjunctive meaning (negated
@@ -21,13 +25,44 @@
 // In the special case that the set of clauses can be shown to be inconsistent
 // after the splits, Determines() returns the null term to indicate that [t=n]
 // is entailed by the clauses for arbitrary n.
+//
+// When more than one thread is configured with set_n_threads(), the candidate
+// terms of the outermost split are distributed over a pool of worker threads.
+// Every worker evaluates its candidates on a replica of the setup, so the
+// cheap ShallowCopy-style backtracking still applies within each worker; the
+// successful candidate with the smallest index wins, and candidates beyond it
+// are cancelled. The answers coincide with the single-threaded ones.
+//
+// set_n_processes() scales the same scheme beyond one address space: for
+// Entails() queries whose split trees exceed what the threaded workers
+// manage -- typically high belief levels -- the candidates are claimed by
+// forked worker processes instead, which inherit the prepared setup by
+// copy-on-write and coordinate through a small shared-memory table (see
+// SplitDistributed()).
+//
+// Within a single query, Split() memoizes its subproblems in a transposition
+// cache keyed by the unit clauses added to the setup since the query started
+// plus the remaining split depth. Split orders that only permute the splits,
+// such as t1=n1 before t2=n2 and vice versa, lead to the same setup and hence
+// share their result.
 
 #ifndef LIMBO_SOLVER_H_
 #define LIMBO_SOLVER_H_
 
 #include <cassert>
+#include <cerrno>
 
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <limbo/formula.h>
 #include <limbo/grounder.h>
@@ -35,8 +70,13 @@
 #include <limbo/setup.h>
 #include <limbo/term.h>
 
+#include <limbo/internal/hash.h>
 #include <limbo/internal/ints.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/memory.h>
+#include <limbo/internal/stats.h>
+#include <limbo/internal/threadpool.h>
+#include <limbo/internal/timers.h>
 
 namespace limbo {
 
@@ -48,7 +88,7 @@ class Solver {
   static constexpr bool kConsistencyGuarantee = true;
   static constexpr bool kNoConsistencyGuarantee = false;
 
-  Solver(Symbol::Factory* sf, Term::Factory* tf) : tf_(tf), grounder_(sf, tf) {}
+  Solver(Symbol::Factory* sf, Term::Factory* tf) : sf_(sf), tf_(tf), grounder_(sf, tf) {}
   Solver(const Solver&) = delete;
   Solver& operator=(const Solver&) = delete;
   Solver(Solver&&) = default;
@@ -59,39 +99,189 @@ class Solver {
 
   const Setup& setup() const { return grounder_.setup(); }
 
+  // Forwards to Grounder::Reserve(); see there.
+  void Reserve(internal::size_t n_sorts, internal::size_t n_clauses, internal::size_t n_literals) {
+    grounder_.Reserve(n_sorts, n_clauses, n_literals);
+  }
+
+  internal::size_t n_threads() const { return n_threads_; }
+
+  // The calling thread's counters for the last Entails(), Determines(), or
+  // Consistent() call. All zero unless compiled with LIMBO_STATS.
+  const internal::Stats& stats() const { return internal::Stats::Local(); }
+
+  // The calling thread's per-phase time breakdown for the last query. All
+  // zero unless compiled with LIMBO_TIMERS.
+  const internal::Timers& timers() const { return internal::Timers::Local(); }
+
+  // A per-subsystem byte snapshot: the term factory's heaps, the grounder's
+  // containers, and the setup's stores, measured now, plus the calling
+  // thread's live clause overflow bytes (the latter are zero unless compiled
+  // with LIMBO_MEMORY). Differencing two snapshots around a query attributes
+  // the query's memory growth.
+  internal::MemoryProfile memory_profile() const {
+    internal::MemoryProfile p;
+    p.term_factory_bytes = tf_->memory_bytes();
+    p.grounder_bytes = grounder_.memory_bytes();
+    p.setup_bytes = grounder_.setup().memory_bytes();
+    p.clause_pool_bytes = internal::Memory::Local().clause_bytes_allocated -
+                          internal::Memory::Local().clause_bytes_freed;
+    return p;
+  }
+
+  void set_n_threads(internal::size_t n) {
+    n_threads_ = n > 0 ? n : 1;
+    if (pool_ && pool_->size() != n_threads_) {
+      pool_ = nullptr;
+    }
+  }
+
+  internal::size_t n_processes() const { return n_processes_; }
+
+  // With n > 1, Entails() distributes the outermost split candidates over n
+  // forked worker processes (see SplitDistributed()); it takes precedence
+  // over set_n_threads() for the outermost split. Meant to be set on a
+  // solver whose queries are issued from a single thread.
+  void set_n_processes(internal::size_t n) { n_processes_ = n > 0 ? n : 1; }
+
   bool Entails(Formula::belief_level k, const Formula& phi, bool assume_consistent = false) {
     assert(phi.non_modal());
     assert(phi.free_vars().all_empty());
+    LIMBO_TIMERS_DO(internal::Timers::Local().Reset());
     Grounder::Undo undo1;
     if (assume_consistent) {
       grounder_.GuaranteeConsistency(phi, &undo1);
     }
     Grounder::Undo undo2;
     grounder_.PrepareForQuery(phi, &undo2);
+    ResetSplitCaches();
+    LIMBO_STATS_DO(internal::Stats::Local().Reset());
+    auto goal = [&phi](Solver* s) { return s->Reduce(phi); };
+    auto merge = [](bool r1, bool r2) { return r1 && r2; };
     const bool entailed = Subsumes(Clause{}) || phi.trivially_valid() ||
-        Split(k, [this, &phi]() { return Reduce(phi); }, [](bool r1, bool r2) { return r1 && r2; }, true, false);
+        (n_processes_ > 1 && k > 0
+            ? SplitDistributed(k, goal, merge)
+            : n_threads_ > 1 && k > 0
+            ? SplitParallel(k, &phi, Term(), goal, merge, true, false, assume_consistent)
+            : Split(k, [this, &goal]() { return goal(this); }, merge, true, false));
+    return entailed;
+  }
+
+  // The outcome of an EntailsWithin() query: the verdict of the deepest
+  // belief level that was completed before the deadline, and that level.
+  struct AnytimeResult {
+    bool entailed;
+    Formula::belief_level k;
+  };
+
+  // Iteratively deepens the belief level from 0 to max_k until phi is
+  // entailed or the deadline has passed. The deadline is checked between
+  // split candidates; an interrupted level is abandoned (its split clauses
+  // are undone by the usual Grounder::Undo mechanics) and the verdict of the
+  // last completed level is returned. Level 0 involves no splits and is
+  // always completed, so the verdict is at least as good as Entails(0, phi).
+  AnytimeResult EntailsWithin(std::chrono::steady_clock::time_point deadline,
+                              Formula::belief_level max_k,
+                              const Formula& phi,
+                              bool assume_consistent = false) {
+    assert(phi.non_modal());
+    assert(phi.free_vars().all_empty());
+    LIMBO_TIMERS_DO(internal::Timers::Local().Reset());
+    Grounder::Undo undo1;
+    if (assume_consistent) {
+      grounder_.GuaranteeConsistency(phi, &undo1);
+    }
+    Grounder::Undo undo2;
+    grounder_.PrepareForQuery(phi, &undo2);
+    deadline_ = deadline;
+    deadline_active_ = true;
+    deadline_hit_ = false;
+    auto goal = [&phi](Solver* s) { return s->Reduce(phi); };
+    auto merge = [](bool r1, bool r2) { return r1 && r2; };
+    AnytimeResult result{false, 0};
+    for (Formula::belief_level k = 0; k <= max_k; ++k) {
+      ResetSplitCaches();
+      LIMBO_STATS_DO(internal::Stats::Local().Reset());
+      const bool entailed = Subsumes(Clause{}) || phi.trivially_valid() ||
+          Split(k, [this, &goal]() { return goal(this); }, merge, true, false);
+      if (deadline_hit_ && k > 0) {
+        break;
+      }
+      result = AnytimeResult{entailed, k};
+      if (entailed || DeadlineExceeded()) {
+        break;
+      }
+    }
+    deadline_active_ = false;
+    return result;
+  }
+
+  // Evaluates the batch of queries in [first, last), whose iterators shall
+  // dereference to pointers (or Refs) to formulas, and returns the answers in
+  // order. The grounder is prepared only once for the union of the queries
+  // instead of once per Entails() call, which saves most of the regrounding
+  // work for batches of many small ground queries, such as the per-cell
+  // queries of the minesweeper agent. The answers are sound just like those
+  // of Entails(); they are evaluated under the union grounding, so the split
+  // candidates stemming from one query are available to all others. The batch
+  // is evaluated in the calling thread irrespective of set_n_threads().
+  template<typename InputIt>
+  std::vector<bool> EntailsAll(Formula::belief_level k, InputIt first, InputIt last, bool assume_consistent = false) {
+    std::vector<Grounder::Undo> undos;
+    if (assume_consistent) {
+      for (InputIt it = first; it != last; ++it) {
+        const Formula& phi = **it;
+        assert(phi.non_modal());
+        undos.emplace_back();
+        grounder_.GuaranteeConsistency(phi, &undos.back());
+      }
+    }
+    LIMBO_TIMERS_DO(internal::Timers::Local().Reset());
+    for (InputIt it = first; it != last; ++it) {
+      const Formula& phi = **it;
+      assert(phi.non_modal());
+      assert(phi.free_vars().all_empty());
+      undos.emplace_back();
+      grounder_.PrepareForQuery(phi, &undos.back());
+    }
+    std::vector<bool> entailed;
+    for (InputIt it = first; it != last; ++it) {
+      const Formula& phi = **it;
+      // The transposition cache entries record goal results for the current
+      // query's reduction, so they must not survive into the next query.
+      ResetSplitCaches();
+      LIMBO_STATS_DO(internal::Stats::Local().Reset());
+      auto goal = [&phi](Solver* s) { return s->Reduce(phi); };
+      auto merge = [](bool r1, bool r2) { return r1 && r2; };
+      entailed.push_back(Subsumes(Clause{}) || phi.trivially_valid() ||
+                         Split(k, [this, &goal]() { return goal(this); }, merge, true, false));
+    }
     return entailed;
   }
 
   Maybe<Term> Determines(Formula::belief_level k, Term lhs, bool assume_consistent = false) {
     assert(lhs.primitive());
+    LIMBO_TIMERS_DO(internal::Timers::Local().Reset());
     Grounder::Undo undo1;
     if (assume_consistent) {
       grounder_.GuaranteeConsistency(lhs, &undo1);
     }
     Grounder::Undo undo2;
     grounder_.PrepareForQuery(lhs, &undo2);
+    ResetSplitCaches();
+    LIMBO_STATS_DO(internal::Stats::Local().Reset());
     Maybe<Term> inconsistent_result = internal::Just(Term());
     Maybe<Term> unsuccessful_result = internal::Nothing;
-    Maybe<Term> t = Split(k,
-                          [this, lhs]() { return Determines(lhs); },
-                          [](Maybe<Term> r1, Maybe<Term> r2) {
-                            return r1 && r2 && r1.val == r2.val ? r1 :
-                                   r1 && r2 && r1.val.null()    ? r2 :
-                                   r1 && r2 && r2.val.null()    ? r1 :
-                                                                  internal::Nothing;
-                          },
-                          inconsistent_result, unsuccessful_result);
+    auto goal = [lhs](Solver* s) { return s->Determines(lhs); };
+    auto merge = [](Maybe<Term> r1, Maybe<Term> r2) {
+      return r1 && r2 && r1.val == r2.val ? r1 :
+             r1 && r2 && r1.val.null()    ? r2 :
+             r1 && r2 && r2.val.null()    ? r1 :
+                                            internal::Nothing;
+    };
+    Maybe<Term> t = n_threads_ > 1 && k > 0
+        ? SplitParallel(k, nullptr, lhs, goal, merge, inconsistent_result, unsuccessful_result, assume_consistent)
+        : Split(k, [this, &goal]() { return goal(this); }, merge, inconsistent_result, unsuccessful_result);
     return t;
   }
 
@@ -105,12 +295,14 @@ class Solver {
   bool Consistent(int k, const Formula& phi, bool assume_consistent = false) {
     assert(phi.non_modal());
     assert(phi.free_vars().all_empty());
+    LIMBO_TIMERS_DO(internal::Timers::Local().Reset());
     Grounder::Undo undo1;
     if (assume_consistent) {
       grounder_.GuaranteeConsistency(phi, &undo1);
     }
     Grounder::Undo undo2;
     grounder_.PrepareForQuery(phi, &undo2);
+    LIMBO_STATS_DO(internal::Stats::Local().Reset());
     return !phi.trivially_unsatisfiable() && Fix(k, [this, &phi]() { return Reduce(phi); });
   }
 
@@ -119,77 +311,71 @@ class Solver {
   typedef Formula::SortedTermSet SortedTermSet;
 
   bool Reduce(const Formula& phi) {
+    assert(reduce_env_.empty());
+    return Reduce(phi, &reduce_env_, false);
+  }
+
+  // Evaluates phi under the variable bindings in env, negated iff sign is
+  // true. Negation and quantifier instantiation are handled by flipping the
+  // sign and extending the bindings rather than by materializing
+  // Factory::Not() and SubstituteFree() clones, which would deep-copy the
+  // whole subtree once per name; the only allocations left are the
+  // substituted clauses at the atomic leaves.
+  bool Reduce(const Formula& phi, std::unordered_map<Term, Term>* env, bool sign) {
     assert(phi.non_modal());
     switch (phi.type()) {
       case Formula::kAtomic: {
-        const Clause c = phi.as_atomic().arg();
+        Clause c = phi.as_atomic().arg();
+        if (!env->empty()) {
+          c = c.Substitute([env](Term t) {
+            const auto it = env->find(t);
+            return it != env->end() ? internal::Just(it->second) : internal::Nothing;
+          }, tf_);
+        }
         assert(c.ground());
         assert(c.valid() || c.primitive());
-        return c.valid() || Subsumes(c);
+        const Clause& cc = c;
+        if (!sign) {
+          return cc.valid() || Subsumes(cc);
+        } else {
+          // The negated clause is the conjunction of its negated literals.
+          return std::all_of(cc.begin(), cc.end(), [this](Literal a) {
+            const Clause d{a.flip()};
+            return d.valid() || Subsumes(d);
+          });
+        }
       }
       case Formula::kNot: {
-        switch (phi.as_not().arg().type()) {
-          case Formula::kAtomic: {
-            const Clause c = phi.as_not().arg().as_atomic().arg();
-            return std::all_of(c.begin(), c.end(), [this](Literal a) {
-              Formula::Ref psi = Formula::Factory::Atomic(Clause{a.flip()});
-              return Reduce(*psi);
-            });
-          }
-          case Formula::kNot: {
-            return Reduce(phi.as_not().arg().as_not().arg());
-          }
-          case Formula::kOr: {
-            Formula::Ref left = Formula::Factory::Not(phi.as_not().arg().as_or().lhs().Clone());
-            Formula::Ref right = Formula::Factory::Not(phi.as_not().arg().as_or().rhs().Clone());
-            return Reduce(*left) && Reduce(*right);
-          }
-          case Formula::kExists: {
-            const Term x = phi.as_not().arg().as_exists().x();
-            const Formula& psi = phi.as_not().arg().as_exists().arg();
-            const SortedTermSet& xs = psi.free_vars();
-            if (xs.all_empty()) {
-              Formula::Ref xi = Formula::Factory::Not(psi.Clone());
-              return Reduce(*xi);
-            } else {
-              const Grounder::Names ns = grounder_.names(x.sort());
-              assert(ns.begin() != ns.end());
-              return std::all_of(ns.begin(), ns.end(), [this, &psi, x](const Term n) {
-                Formula::Ref xi = Formula::Factory::Not(psi.Clone());
-                xi->SubstituteFree(Term::Substitution(x, n), tf_);
-                return Reduce(*xi);
-              });
-            }
-          }
-          case Formula::kKnow:
-          case Formula::kCons:
-          case Formula::kBel:
-          case Formula::kGuarantee:
-          case Formula::kAction:
-            assert(false);
-            break;
-        }
+        return Reduce(phi.as_not().arg(), env, !sign);
       }
       case Formula::kOr: {
         const Formula& left = phi.as_or().lhs();
         const Formula& right = phi.as_or().rhs();
-        return Reduce(left) || Reduce(right);
+        return !sign ? Reduce(left, env, false) || Reduce(right, env, false)
+                     : Reduce(left, env, true) && Reduce(right, env, true);
       }
       case Formula::kExists: {
         const Term x = phi.as_exists().x();
         const Formula& psi = phi.as_exists().arg();
-        const SortedTermSet& xs = psi.free_vars();
-        if (xs.all_empty()) {
-          return Reduce(psi);
+        if (!psi.free_vars().contains(x)) {
+          return Reduce(psi, env, sign);
+        }
+        const Grounder::Names ns = grounder_.names(x.sort());
+        assert(ns.begin() != ns.end());
+        const auto it = env->find(x);
+        const Maybe<Term> outer = it != env->end() ? internal::Just(it->second) : internal::Nothing;
+        auto eval = [this, env, x, &psi, sign](const Term n) {
+          (*env)[x] = n;
+          return Reduce(psi, env, sign);
+        };
+        const bool r = !sign ? std::any_of(ns.begin(), ns.end(), eval)
+                             : std::all_of(ns.begin(), ns.end(), eval);
+        if (outer) {
+          (*env)[x] = outer.val;
         } else {
-          const Grounder::Names ns = grounder_.names(x.sort());
-          assert(ns.begin() != ns.end());
-          return std::any_of(ns.begin(), ns.end(), [this, &psi, x](const Term n) {
-            Formula::Ref xi = psi.Clone();
-            xi->SubstituteFree(Term::Substitution(x, n), tf_);
-            return Reduce(*xi);
-          });
+          env->erase(x);
         }
+        return r;
       }
       case Formula::kKnow:
       case Formula::kCons:
@@ -209,16 +395,50 @@ class Solver {
     if (k == 0) {
       return goal();
     }
+    std::unordered_map<internal::hash64_t, T>& cache = split_cache(static_cast<T*>(nullptr));
+    const internal::hash64_t key = SplitCacheKey(k);
+    const auto it = cache.find(key);
+    if (it != cache.end()) {
+      return it->second;
+    }
+    const T result = DoSplit(k, goal, merge, inconsistent_result, unsuccessful_result);
+    if (!deadline_hit_) {
+      // An interrupted split must not pollute the cache with its provisional result.
+      cache[key] = result;
+    }
+    return result;
+  }
+
+  template<typename T, typename GoalPredicate, typename MergeResultPredicate>
+  T DoSplit(int k, GoalPredicate goal, MergeResultPredicate merge, T inconsistent_result, T unsuccessful_result) {
+    LIMBO_TIMERS_SCOPE(internal::Timers::kSplit);
     bool recursed = false;
+    // The candidates are consumed in order of descending activity, popped
+    // lazily off a max-heap since often only the first few terms are tried.
+    // Activities bumped during the recursion may stale the heap order below
+    // the popped element, which costs only ordering quality, not soundness.
+    std::vector<Term> ts;
     for (const Term t : grounder_.lhs_terms()) {
+      ts.push_back(t);
+    }
+    const Setup& s = setup();
+    auto less_active = [&s](Term t1, Term t2) { return s.activity(t1) < s.activity(t2); };
+    std::make_heap(ts.begin(), ts.end(), less_active);
+    for (auto end = ts.end(); end != ts.begin(); ) {
+      std::pop_heap(ts.begin(), end, less_active);
+      const Term t = *--end;
       if (Determines(t)) {
         continue;
       }
       auto merged_result = unsuccessful_result;
       for (const Term n : grounder_.rhs_names(t)) {
+        if (DeadlineExceeded()) {
+          return unsuccessful_result;
+        }
         Grounder::Undo undo;
         const Literal a = Literal::Eq(t, n);
         assert(!a.valid() && !a.unsatisfiable());
+        LIMBO_STATS_DO(++internal::Stats::Local().splits[SplitLevelIndex(k)]);
         const Setup::Result add_result = grounder_.AddClause(Clause{a}, &undo);
         if (add_result == Setup::kInconsistent) {
           merged_result = !merged_result ? inconsistent_result : merge(merged_result, inconsistent_result);
@@ -249,6 +469,271 @@ next_term:
     return recursed ? unsuccessful_result : goal();
   }
 
+  // Evaluates the inner loop of Split() for a single candidate term t, that
+  // is, splits t into every name and merges the sub-results. Returns Nothing
+  // when some branch fails, and the merged result otherwise.
+  template<typename T, typename GoalPredicate, typename MergeResultPredicate>
+  Maybe<T> SplitTerm(int k, Term t, GoalPredicate goal, MergeResultPredicate merge,
+                     T inconsistent_result, T unsuccessful_result, bool* recursed) {
+    LIMBO_TIMERS_SCOPE(internal::Timers::kSplit);
+    if (setup().contains_empty_clause()) {
+      return internal::Nothing;
+    }
+    auto g = [this, &goal]() { return goal(this); };
+    T merged_result = unsuccessful_result;
+    for (const Term n : grounder_.rhs_names(t)) {
+      if (DeadlineExceeded()) {
+        return internal::Nothing;
+      }
+      Grounder::Undo undo;
+      const Literal a = Literal::Eq(t, n);
+      assert(!a.valid() && !a.unsatisfiable());
+      LIMBO_STATS_DO(++internal::Stats::Local().splits[SplitLevelIndex(k)]);
+      const Setup::Result add_result = grounder_.AddClause(Clause{a}, &undo);
+      if (add_result == Setup::kInconsistent) {
+        merged_result = !merged_result ? inconsistent_result : merge(merged_result, inconsistent_result);
+        if (!merged_result) {
+          return internal::Nothing;
+        }
+        *recursed = true;
+        continue;
+      }
+      const T split_result = Split(k-1, g, merge, inconsistent_result, unsuccessful_result);
+      if (!split_result) {
+        return internal::Nothing;
+      }
+      merged_result = !merged_result ? split_result : merge(merged_result, split_result);
+      if (!merged_result) {
+        return internal::Nothing;
+      }
+      *recursed = true;
+    }
+    return internal::Just(merged_result);
+  }
+
+  // Distributes the top-level split candidates over the worker pool. Either
+  // phi is non-null and the workers prepare for the query phi, or they prepare
+  // for the query term lhs. Every worker re-adds the original clauses to a
+  // private Solver, which replays the grounding (with fresh plus-names, which
+  // are interchangeable with the parent's), and then claims candidate indices
+  // from a shared counter. The result is the one of the successful candidate
+  // with the smallest index, so the answers match the single-threaded ones;
+  // once some candidate has succeeded, all candidates beyond it are cancelled.
+  template<typename T, typename GoalPredicate, typename MergeResultPredicate>
+  T SplitParallel(int k, const Formula* phi, Term lhs, GoalPredicate goal, MergeResultPredicate merge,
+                  T inconsistent_result, T unsuccessful_result, bool assume_consistent) {
+    assert(n_threads_ > 1 && k > 0);
+    if (setup().contains_empty_clause()) {
+      return unsuccessful_result;
+    }
+    std::vector<Term> ts;
+    for (const Term t : grounder_.lhs_terms()) {
+      if (!Determines(t)) {
+        ts.push_back(t);
+      }
+    }
+    if (ts.empty()) {
+      return goal(this);
+    }
+    // Highest activity first, like in the sequential DoSplit().
+    const Setup& s = setup();
+    std::stable_sort(ts.begin(), ts.end(), [&s](Term t1, Term t2) { return s.activity(t1) > s.activity(t2); });
+    std::vector<Clause> cs;
+    grounder_.TraverseClauses([&cs](const Clause& c) { cs.push_back(c); });
+    if (!pool_) {
+      pool_ = std::unique_ptr<internal::ThreadPool>(new internal::ThreadPool(n_threads_));
+    }
+    std::vector<Maybe<T>> results(ts.size());
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> min_success(ts.size());
+    std::atomic<bool> recursed(false);
+    const size_t n_jobs = std::min(pool_->size(), ts.size());
+    for (size_t j = 0; j < n_jobs; ++j) {
+      pool_->Submit([&]() {
+        Solver s(sf_, tf_);
+        if (!cs.empty()) {
+          s.grounder_.AddClauses(cs.begin(), cs.end());
+        }
+        Grounder::Undo undo1;
+        if (assume_consistent) {
+          if (phi != nullptr) {
+            s.grounder_.GuaranteeConsistency(*phi, &undo1);
+          } else {
+            s.grounder_.GuaranteeConsistency(lhs, &undo1);
+          }
+        }
+        Grounder::Undo undo2;
+        if (phi != nullptr) {
+          s.grounder_.PrepareForQuery(*phi, &undo2);
+        } else {
+          s.grounder_.PrepareForQuery(lhs, &undo2);
+        }
+        s.ResetSplitCaches();
+        for (;;) {
+          const size_t i = next.fetch_add(1);
+          if (i >= ts.size() || i > min_success.load()) {
+            break;
+          }
+          bool r = false;
+          const Maybe<T> result = s.SplitTerm(k, ts[i], goal, merge, inconsistent_result, unsuccessful_result, &r);
+          if (r) {
+            recursed.store(true);
+          }
+          if (result) {
+            results[i] = result;
+            for (size_t m = min_success.load(); i < m && !min_success.compare_exchange_weak(m, i); ) {
+            }
+          }
+        }
+      });
+    }
+    pool_->Wait();
+    for (size_t i = 0; i < ts.size(); ++i) {
+      if (results[i]) {
+        return results[i].val;
+      }
+    }
+    return recursed.load() ? unsuccessful_result : goal(this);
+  }
+
+  // Distributes the top-level split candidates over forked worker processes.
+  // Unlike the threaded workers, the forked ones need no replay: Entails()
+  // has already prepared the grounder for the query, and fork() hands every
+  // worker an identical copy of it for free, since the subtrees share
+  // nothing but the immutable setup and copy-on-write leaves it unduplicated.
+  // The workers coordinate through a small shared mapping holding the claim
+  // counter and the per-candidate verdicts: as in SplitParallel(), the
+  // successful candidate with the smallest index wins, and a success cancels
+  // the claiming of the candidates beyond it. Only Entails() is distributed;
+  // Determines() would have to report terms interned after the fork, which
+  // the coordinator's factory does not know. If no worker can be spawned,
+  // the query falls back to the sequential split.
+  template<typename GoalPredicate, typename MergeResultPredicate>
+  bool SplitDistributed(int k, GoalPredicate goal, MergeResultPredicate merge) {
+    assert(n_processes_ > 1 && k > 0);
+    if (setup().contains_empty_clause()) {
+      return false;
+    }
+    std::vector<Term> ts;
+    for (const Term t : grounder_.lhs_terms()) {
+      if (!Determines(t)) {
+        ts.push_back(t);
+      }
+    }
+    if (ts.empty()) {
+      return goal(this);
+    }
+    // Highest activity first, like in the sequential DoSplit().
+    const Setup& s = setup();
+    std::stable_sort(ts.begin(), ts.end(), [&s](Term t1, Term t2) { return s.activity(t1) > s.activity(t2); });
+    constexpr internal::u8 kFailed = 1;
+    constexpr internal::u8 kFalse  = 2;
+    constexpr internal::u8 kTrue   = 3;
+    struct SharedHeader {
+      std::atomic<size_t> next{0};
+      std::atomic<size_t> min_success;
+      std::atomic<bool> recursed{false};
+    };
+    const size_t n_bytes = sizeof(SharedHeader) + ts.size() * sizeof(std::atomic<internal::u8>);
+    void* mem = mmap(nullptr, n_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      return Split(k, [this, &goal]() { return goal(this); }, merge, true, false);
+    }
+    SharedHeader* header = new (mem) SharedHeader;
+    header->min_success.store(ts.size());
+    std::atomic<internal::u8>* verdicts = reinterpret_cast<std::atomic<internal::u8>*>(header + 1);
+    for (size_t i = 0; i < ts.size(); ++i) {
+      new (verdicts + i) std::atomic<internal::u8>(0);
+    }
+    const size_t n_workers = std::min(n_processes_, ts.size());
+    std::vector<pid_t> workers;
+    for (size_t j = 0; j < n_workers; ++j) {
+      const pid_t pid = fork();
+      if (pid < 0) {
+        break;
+      }
+      if (pid == 0) {
+        for (;;) {
+          const size_t i = header->next.fetch_add(1);
+          if (i >= ts.size() || i > header->min_success.load()) {
+            break;
+          }
+          bool r = false;
+          const Maybe<bool> result = SplitTerm(k, ts[i], goal, merge, true, false, &r);
+          if (r) {
+            header->recursed.store(true);
+          }
+          verdicts[i].store(!result ? kFailed : result.val ? kTrue : kFalse);
+          if (result) {
+            for (size_t m = header->min_success.load();
+                 i < m && !header->min_success.compare_exchange_weak(m, i); ) {
+            }
+          }
+        }
+        // _exit() skips destructors and atexit handlers, which belong to the
+        // coordinator's copy of the world.
+        _exit(0);
+      }
+      workers.push_back(pid);
+    }
+    if (workers.empty()) {
+      munmap(mem, n_bytes);
+      return Split(k, [this, &goal]() { return goal(this); }, merge, true, false);
+    }
+    for (const pid_t pid : workers) {
+      int status;
+      while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+      }
+    }
+    Maybe<bool> outcome = internal::Nothing;
+    for (size_t i = 0; i < ts.size() && !outcome; ++i) {
+      const internal::u8 v = verdicts[i].load();
+      if (v == kTrue || v == kFalse) {
+        outcome = internal::Just(v == kTrue);
+      }
+    }
+    const bool recursed = header->recursed.load();
+    munmap(mem, n_bytes);
+    return outcome ? outcome.val : recursed ? false : goal(this);
+  }
+
+  // The transposition cache key identifies the setup state reached by the
+  // splits so far: the splits only add unit clauses, whose propagated
+  // consequences are unit clauses as well, so the unit clauses added since the
+  // query started determine the state. The per-unit hashes are combined with
+  // XOR to make the key independent of the propagation order.
+  internal::hash64_t SplitCacheKey(int k) const {
+    internal::hash64_t h = internal::fnv1a_hash(k);
+    const std::vector<Literal>& units = setup().units_vec();
+    for (size_t i = cache_n_units_; i < units.size(); ++i) {
+      h ^= internal::fnv1a_hash(units[i]);
+    }
+    return h;
+  }
+
+  void ResetSplitCaches() {
+    split_cache_bool_.clear();
+    split_cache_term_.clear();
+    cache_n_units_ = setup().units_vec().size();
+  }
+
+  std::unordered_map<internal::hash64_t, bool>&        split_cache(bool*)        { return split_cache_bool_; }
+  std::unordered_map<internal::hash64_t, Maybe<Term>>& split_cache(Maybe<Term>*) { return split_cache_term_; }
+
+  static size_t SplitLevelIndex(int k) {
+    return k < int(internal::Stats::kMaxLevel) ? k : internal::Stats::kMaxLevel - 1;
+  }
+
+  // True iff the deadline set by EntailsWithin() has passed. Once hit, the
+  // flag sticks until the next EntailsWithin() call, so the abort propagates
+  // through all pending split levels.
+  bool DeadlineExceeded() {
+    if (deadline_active_ && !deadline_hit_ && std::chrono::steady_clock::now() >= deadline_) {
+      deadline_hit_ = true;
+    }
+    return deadline_hit_;
+  }
+
   template<typename GoalPredicate>
   bool Fix(int k, GoalPredicate goal) {
     if (Subsumes(Clause{})) {
@@ -299,27 +784,55 @@ next_term:
 
   bool Consistent() const {
     if (grounder_.relevance_filter()) {
-      auto clauses = grounder_.relevant_clauses();
-      return Consistent(clauses.begin(), clauses.end(),
-                        [this](const Symbol::Sort sort) { return grounder_.names(sort); });
-    } else {
-      return Consistent([this](const Symbol::Sort sort) { return grounder_.names(sort); });
-    }
-  }
-
-  template<typename UnaryFunction>
-  bool Consistent(UnaryFunction names) const {
-    if (grounder_.setup().contains_empty_clause()) {
-      return false;
-    }
-    std::unordered_set<Literal, Literal::LhsHash> lits;
-    for (Setup::ClauseRange::Index i : grounder_.setup().clauses()) {
-      const Maybe<Clause> c = grounder_.setup().clause(i);
-      if (c) {
-        lits.insert(c.val.begin(), c.val.end());
+      // ConsistentSet() only relates literals that share their lhs, and
+      // distinct components share no lhs terms, so the relevant clauses are
+      // consistent iff the units are and every component is together with the
+      // units on its terms. Solving the components independently keeps the
+      // literal sets small and stops at the first inconsistent component.
+      if (grounder_.setup().contains_empty_clause()) {
+        return false;
       }
+      auto names = [this](const Symbol::Sort sort) { return grounder_.names(sort); };
+      const Literal::LhsSet& units = grounder_.setup().units();
+      if (!ConsistentSet(units, names)) {
+        return false;
+      }
+      std::unordered_map<size_t, std::vector<Literal>> units_of;
+      units.ForEach([this, &units_of](const Literal a) {
+        const Maybe<size_t> r = grounder_.component_of(a.lhs());
+        if (r) {
+          units_of[r.val].push_back(a);
+        }
+      });
+      bool consistent = true;
+      grounder_.TraverseRelevantComponents(
+          [this, &names, &units_of, &consistent](size_t r, const std::vector<Grounder::ClauseIndex>& is) {
+        if (!consistent) {
+          return;
+        }
+        Literal::LhsSet lits;
+        const auto it = units_of.find(r);
+        if (it != units_of.end()) {
+          for (const Literal a : it->second) {
+            lits.Insert(a);
+          }
+        }
+        for (const Grounder::ClauseIndex i : is) {
+          const Maybe<Clause> c = grounder_.setup().clause(i);
+          if (c) {
+            for (const Literal a : c.val) {
+              lits.Insert(a);
+            }
+          }
+        }
+        consistent = ConsistentSet(lits, names);
+      });
+      return consistent;
+    } else {
+      // The setup maintains its complementary-literal count incrementally, so
+      // there is no need to rebuild the literal set at every leaf of Fix().
+      return grounder_.setup().Consistent();
     }
-    return ConsistentSet(lits, names);
   }
 
   template<typename ClauseInputIt, typename UnaryFunction>
@@ -327,36 +840,41 @@ next_term:
     if (grounder_.setup().contains_empty_clause()) {
       return false;
     }
-    std::unordered_set<Literal, Literal::LhsHash> lits = grounder_.setup().units();
+    Literal::LhsSet lits = grounder_.setup().units();
     for (auto it = first_clause; it != last_clause; ++it) {
       const Maybe<Clause> c = grounder_.setup().clause(*it);
       if (c) {
-        lits.insert(c.val.begin(), c.val.end());
+        for (const Literal a : c.val) {
+          lits.Insert(a);
+        }
       }
     }
     return ConsistentSet(lits, names);
   }
 
   template<typename UnaryFunction>
-  static bool ConsistentSet(const std::unordered_set<Literal, Literal::LhsHash>& lits, UnaryFunction names) {
+  static bool ConsistentSet(const Literal::LhsSet& lits, UnaryFunction names) {
     std::unordered_set<Term> lhss;
-    for (const Literal a : lits) {
-      assert(lits.bucket_count() > 0);
-      const size_t bucket = lits.bucket(a);
-      const auto begin = lits.begin(bucket);
-      const auto end = lits.end(bucket);
-      for (auto it = begin; it != end; ++it) {
-        const Literal b = *it;
-        assert(Literal::Complementary(a, b) == Literal::Complementary(b, a));
-        if (Literal::Complementary(a, b)) {
-          return false;
-        }
+    bool consistent = true;
+    lits.ForEach([&lits, &lhss, &consistent](const Literal a) {
+      if (!consistent) {
+        return;
+      }
+      if (lits.AnyWithLhs(a.lhs(), [a](const Literal b) {
+            assert(Literal::Complementary(a, b) == Literal::Complementary(b, a));
+            return Literal::Complementary(a, b);
+          })) {
+        consistent = false;
+        return;
       }
       lhss.insert(a.lhs());
+    });
+    if (!consistent) {
+      return false;
     }
     for (const Term t : lhss) {
       for (const Term n : names(t.sort())) {
-        if (lits.count(Literal::Neq(t, n)) == 0) {
+        if (!lits.Contains(Literal::Neq(t, n))) {
           break;
         }
       }
@@ -364,8 +882,19 @@ next_term:
     return true;
   }
 
+  Symbol::Factory* sf_;
   Term::Factory* tf_;
   Grounder grounder_;
+  size_t n_threads_ = 1;
+  size_t n_processes_ = 1;
+  std::unique_ptr<internal::ThreadPool> pool_;
+  size_t cache_n_units_ = 0;
+  std::unordered_map<Term, Term> reduce_env_;
+  std::chrono::steady_clock::time_point deadline_;
+  bool deadline_active_ = false;
+  bool deadline_hit_ = false;
+  std::unordered_map<internal::hash64_t, bool> split_cache_bool_;
+  std::unordered_map<internal::hash64_t, Maybe<Term>> split_cache_term_;
 };
 
 }  // namespace limbo
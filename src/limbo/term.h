@@ -42,14 +42,32 @@
 // than the number of names, and the number of names is much larger than the
 // number of variables and non-primitive terms, this encoding is
 // space-efficient.
+//
+// Both factories are safe for concurrent use once the singleton instances
+// exist: the symbol counters are atomic, and term interning is sharded with
+// per-shard reader-writer locks, so threads contend only when they intern a
+// new term on the same shard. Instance() itself is not synchronized and must
+// first be called before worker threads are spawned.
+//
+// By default terms are interned forever, but the term factory can be rolled
+// back stack-wise: mark() snapshots the dense id spaces, and Backtrack()
+// bulk-releases every term interned after the snapshot and recycles their
+// ids. This is how long-running systems reclaim the terms that existed only
+// for the duration of a query.
 
 #ifndef LIMBO_TERM_H_
 #define LIMBO_TERM_H_
 
 #include <cassert>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -58,6 +76,7 @@
 #include <limbo/internal/intmap.h>
 #include <limbo/internal/ints.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/memory.h>
 
 namespace limbo {
 
@@ -88,7 +107,7 @@ class Symbol {
     bool operator==(const Sort s) const { return id_ == s.id_; }
     bool operator!=(const Sort s) const { return id_ != s.id_; }
 
-    internal::hash32_t hash() const { return internal::jenkins_hash(id_); }
+    internal::hash64_t hash() const { return internal::splitmix64_hash(id_); }
 
     bool rigid() const { return (id_ & kBitMaskRigid) != 0; }
 
@@ -134,6 +153,21 @@ class Symbol {
     Symbol CreateVariable(Sort sort)              { return CreateVariable(last_variable_++, sort); }
     Symbol CreateFunction(Sort sort, Arity arity) { return CreateFunction(last_function_++, sort, arity); }
 
+    // The counters can be saved and restored so that symbol creation resumes
+    // without collisions after a knowledge base has been reloaded from a
+    // snapshot.
+    Sort::Id last_sort()  const { return last_sort_; }
+    Id last_function()    const { return last_function_; }
+    Id last_name()        const { return last_name_; }
+    Id last_variable()    const { return last_variable_; }
+
+    void Resume(Sort::Id last_sort, Id last_function, Id last_name, Id last_variable) {
+      last_sort_     = std::max(last_sort_.load(), last_sort);
+      last_function_ = std::max(last_function_.load(), last_function);
+      last_name_     = std::max(last_name_.load(), last_name);
+      last_variable_ = std::max(last_variable_.load(), last_variable);
+    }
+
    private:
     Factory() = default;
     Factory(const Factory&) = delete;
@@ -141,10 +175,12 @@ class Symbol {
     Factory(Factory&&) = delete;
     Factory& operator=(Factory&&) = delete;
 
-    Sort::Id last_sort_ = 0;
-    Id last_function_ = 0;
-    Id last_name_ = 0;
-    Id last_variable_ = 0;
+    // The counters are atomic so that symbols can be created concurrently,
+    // for instance by solvers that split in parallel.
+    std::atomic<Sort::Id> last_sort_{0};
+    std::atomic<Id> last_function_{0};
+    std::atomic<Id> last_name_{0};
+    std::atomic<Id> last_variable_{0};
   };
 
   Symbol() = default;
@@ -155,7 +191,7 @@ class Symbol {
   }
   bool operator!=(Symbol s) const { return !(*this == s); }
 
-  internal::hash32_t hash() const { return internal::jenkins_hash(id_); }
+  internal::hash64_t hash() const { return internal::splitmix64_hash(id_); }
 
   bool name()     const { return is_highest(id_, kBitMaskName); }
   bool variable() const { return is_highest(id_, kBitMaskVariable); }
@@ -222,7 +258,22 @@ class Term {
   bool operator<(Term t)  const { return id_ < t.id_; }
   bool operator>(Term t)  const { return id_ > t.id_; }
 
-  internal::hash32_t hash() const { return internal::jenkins_hash(id_); }
+  internal::hash64_t hash() const { return internal::splitmix64_hash(id_); }
+
+  // Term indices are small and dense within each class (primitive, name,
+  // variable, other), which makes them suitable as keys of an IntMap.
+  internal::u32 index() const {
+    if (is_highest(id_, kBitMaskPrimitive)) {
+      return lower(id_, kBitMaskPrimitive);
+    } else if (is_highest(id_, kBitMaskName)) {
+      return lower(id_, kBitMaskName);
+    } else if (is_highest(id_, kBitMaskVariable)) {
+      return lower(id_, kBitMaskVariable);
+    } else {
+      assert(is_highest(id_, kBitMaskOther));
+      return lower(id_, kBitMaskOther);
+    }
+  }
 
   inline Symbol symbol()      const;
   inline const Vector& args() const;
@@ -278,18 +329,6 @@ class Term {
   inline const Data* data() const;
 
   Id id() const { return id_; }
-  Id index() const {
-    if (is_highest(id_, kBitMaskPrimitive)) {
-      return lower(id_, kBitMaskPrimitive);
-    } else if (is_highest(id_, kBitMaskName)) {
-      return lower(id_, kBitMaskName);
-    } else if (is_highest(id_, kBitMaskVariable)) {
-      return lower(id_, kBitMaskVariable);
-    } else {
-      assert(is_highest(id_, kBitMaskOther));
-      return lower(id_, kBitMaskOther);
-    }
-  }
 
   template<bool (Term::*Prop)() const>
   inline bool all_args() const {
@@ -320,8 +359,8 @@ struct Term::Data {
   bool operator==(const Data& d) const { return symbol == d.symbol && args == d.args; }
   bool operator!=(const Data& s) const { return !(*this == s); }
 
-  internal::hash32_t hash() const {
-    internal::hash32_t h = symbol.hash();
+  internal::hash64_t hash() const {
+    internal::hash64_t h = symbol.hash();
     for (const limbo::Term t : args) {
       h ^= t.hash();
     }
@@ -343,64 +382,62 @@ class Term::Factory : private Singleton<Factory> {
 
   static void Reset() { instance = nullptr; }
 
-  ~Factory() {
-    for (Data* data : heap_primitive_) {
-      delete data;
-    }
-    for (Data* data : heap_name_) {
-      delete data;
-    }
-    for (Data* data : heap_variable_) {
-      delete data;
-    }
-    for (Data* data : heap_other_) {
-      delete data;
-    }
-  }
-
   Term CreateTerm(Symbol symbol) { return CreateTerm(symbol, {}); }
 
   Term CreateTerm(Symbol symbol, const Vector& args) {
     assert(!symbol.null() && std::all_of(args.begin(), args.end(), [](const Term t) { return !t.null(); }));
     assert(symbol.arity() == static_cast<Symbol::Arity>(args.size()));
-    Data* d = new Data(symbol, args);
-    DataPtrSet* s = &memory_[symbol.sort()];
-    auto it = s->find(d);
-    if (it == s->end()) {
-      auto all_args = [&args](auto p) {
-        return std::all_of(args.begin(), args.end(), [&p](const Term t) { return p(t); });
-      };
-      const Symbol::Sort sort = symbol.sort();
-      Id id;
-      if (!sort.rigid() && symbol.function() && all_args([](const Term t) { return t.name(); })) {
-        assert(heap_primitive_.size() == lower(heap_primitive_.size(), kBitMaskPrimitive));
-        id = static_cast<Id>(heap_primitive_.size());
-        heap_primitive_.push_back(d);
-        id |= kBitMaskPrimitive;
-      } else if (symbol.name() || (sort.rigid() && symbol.function() &&
-                                   all_args([](const Term t) { return t.name() && !t.function(); }))) {
-        assert(heap_name_.size() == lower(heap_name_.size(), kBitMaskName));
-        id = static_cast<Id>(heap_name_.size());
-        heap_name_.push_back(d);
-        id |= kBitMaskName;
-      } else if (symbol.variable()) {
-        assert(heap_variable_.size() == lower(heap_variable_.size(), kBitMaskVariable));
-        id = static_cast<Id>(heap_variable_.size());
-        heap_variable_.push_back(d);
-        id |= kBitMaskVariable;
-      } else {
-        assert(heap_other_.size() == lower(heap_other_.size(), kBitMaskOther));
-        id = static_cast<Id>(heap_other_.size());
-        heap_other_.push_back(d);
-        id |= kBitMaskOther;
+    // Interning is sharded by the term's hash, and every shard is protected
+    // by a reader-writer lock: looking up an already-interned term -- the
+    // overwhelmingly common case during grounding -- only takes the shared
+    // lock, so concurrent creators serialize only when they actually intern
+    // a new term on the same shard. Lookups through get_data() take no lock
+    // at all: the heaps are chunked so that growing them never moves
+    // existing entries, and a thread can only hold a Term whose id it
+    // obtained through a shard lock (or before the threads were spawned),
+    // so its Data is visible to it.
+    Data probe(symbol, args);
+    Shard& shard = shards_[DataPtrHash()(&probe) & (kNumShards - 1)];
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(shard.mutex);
+      const auto it = shard.terms.find(&probe);
+      if (it != shard.terms.end()) {
+        return Term(it->second);
       }
-      s->insert(std::make_pair(d, id));
-      return Term(id);
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(shard.mutex);
+    const auto it = shard.terms.find(&probe);
+    if (it != shard.terms.end()) {
+      return Term(it->second);
+    }
+    Data* d = new Data(std::move(probe));
+    LIMBO_MEMORY_DO(internal::Memory::Local().term_bytes_allocated +=
+                    sizeof(Data) + d->args.capacity() * sizeof(Term));
+    auto all_args = [d](auto p) {
+      return std::all_of(d->args.begin(), d->args.end(), [&p](const Term t) { return p(t); });
+    };
+    const Symbol::Sort sort = symbol.sort();
+    Id id;
+    if (!sort.rigid() && symbol.function() && all_args([](const Term t) { return t.name(); })) {
+      id = static_cast<Id>(heap_primitive_.PushBack(d));
+      assert(id == lower(id, kBitMaskPrimitive));
+      id |= kBitMaskPrimitive;
+    } else if (symbol.name() || (sort.rigid() && symbol.function() &&
+                                 all_args([](const Term t) { return t.name() && !t.function(); }))) {
+      id = static_cast<Id>(heap_name_.PushBack(d));
+      assert(id == lower(id, kBitMaskName));
+      id |= kBitMaskName;
+    } else if (symbol.variable()) {
+      id = static_cast<Id>(heap_variable_.PushBack(d));
+      assert(id == lower(id, kBitMaskVariable));
+      id |= kBitMaskVariable;
     } else {
-      const Id id = it->second;
-      delete d;
-      return Term(id);
+      id = static_cast<Id>(heap_other_.PushBack(d));
+      assert(id == lower(id, kBitMaskOther));
+      id |= kBitMaskOther;
     }
+    shard.terms.insert(std::make_pair(d, id));
+    return Term(id);
   }
 
   const Data* get_data(Term t) const {
@@ -417,9 +454,272 @@ class Term::Factory : private Singleton<Factory> {
     }
   }
 
+  // Pre-sizes the interning index for n terms, so that interning a theory
+  // of known dimensions rehashes each shard table at most once instead of
+  // once per doubling. The heaps need no pre-sizing: they grow in chunks
+  // that never relocate (see Heap). Counts beyond n just fall back to
+  // incremental growth.
+  void Reserve(size_t n) {
+    const size_t per_shard = (n + kNumShards - 1) / kNumShards;
+    for (Shard& shard : shards_) {
+      std::unique_lock<std::shared_timed_mutex> lock(shard.mutex);
+      shard.terms.reserve(per_shard);
+    }
+  }
+
+  // The bytes held by the term heaps and the interning index (see
+  // internal/memory.h for the accounting overview). The substitution and
+  // mentions memos are not included; they are bounded caches, not heaps.
+  // Meant to be called between queries, not while workers are interning.
+  internal::u64 memory_bytes() const {
+    internal::u64 n = heap_primitive_.memory_bytes() + heap_name_.memory_bytes() +
+                      heap_variable_.memory_bytes() + heap_other_.memory_bytes();
+    for (const Shard& shard : shards_) {
+      n += internal::unordered_memory_bytes(shard.terms);
+    }
+    return n;
+  }
+
+  // A snapshot of the sizes of the dense id spaces. Terms interned when the
+  // mark was taken remain covered by it; terms interned afterwards are not
+  // and can be bulk-released with Backtrack().
+  class Mark {
+   public:
+    Mark() = default;
+
+    // Whether t was already interned when the mark was taken.
+    bool covers(const Term t) const {
+      const size_t i = t.index();
+      return i < (t.primitive() ? primitive_ : t.name() ? name_ : t.variable() ? variable_ : other_);
+    }
+
+   private:
+    friend class Factory;
+
+    size_t primitive_ = 0;
+    size_t name_ = 0;
+    size_t variable_ = 0;
+    size_t other_ = 0;
+  };
+
+  // Snapshots the dense id spaces; see Backtrack(). Like memory_bytes(),
+  // meant to be called between queries, not while workers are interning.
+  Mark mark() const {
+    Mark m;
+    m.primitive_ = heap_primitive_.size();
+    m.name_ = heap_name_.size();
+    m.variable_ = heap_variable_.size();
+    m.other_ = heap_other_.size();
+    return m;
+  }
+
+  // Bulk-releases every term interned after the mark was taken: their
+  // interning entries, their Data, and every memoized substitution or
+  // mentions result that involves them. The freed indices are handed out
+  // again by subsequent CreateTerm() calls, so the id spaces stay dense and
+  // IntMaps indexed by Term::index() do not accumulate dead keys. Surviving
+  // terms keep their ids; renumbering them would be unsound, for the ids are
+  // baked into literals and determine the order of literals in clauses.
+  // The caller must guarantee that no released term is still reachable from
+  // a live Term, Literal, Clause, or Formula; KnowledgeBase::BacktrackTerms()
+  // discharges that obligation for the usual query workload. Must not run
+  // concurrently with interning.
+  void Backtrack(const Mark& mark) {
+    for (Shard& shard : shards_) {
+      std::unique_lock<std::shared_timed_mutex> lock(shard.mutex);
+      for (auto it = shard.terms.begin(); it != shard.terms.end(); ) {
+        it = !mark.covers(Term(it->second)) ? shard.terms.erase(it) : std::next(it);
+      }
+    }
+    {
+      std::unique_lock<std::shared_timed_mutex> lock(substitute_.mutex);
+      for (auto it = substitute_.memo.begin(); it != substitute_.memo.end(); ) {
+        const SubstituteKey& k = it->first;
+        const bool stale = !mark.covers(Term(k.t)) || !mark.covers(Term(k.x)) ||
+                           !mark.covers(Term(k.n)) || !mark.covers(Term(it->second));
+        it = stale ? substitute_.memo.erase(it) : std::next(it);
+      }
+    }
+    {
+      std::unique_lock<std::shared_timed_mutex> lock(mentions_.mutex);
+      for (auto it = mentions_.memo.begin(); it != mentions_.memo.end(); ) {
+        const bool stale = !mark.covers(Term(Id(it->first >> 32))) || !mark.covers(Term(Id(it->first)));
+        it = stale ? mentions_.memo.erase(it) : std::next(it);
+      }
+    }
+    heap_primitive_.Truncate(mark.primitive_);
+    heap_name_.Truncate(mark.name_);
+    heap_variable_.Truncate(mark.variable_);
+    heap_other_.Truncate(mark.other_);
+  }
+
+  // Substitutes x with n in t and memoizes the result. The quantifier
+  // instantiation loops substitute the same variable once per name of the
+  // sort, so without memoization every term in the formula is re-traversed
+  // for every name. The memo shares the work across the iterations: subterms
+  // that do not mention x are recognized in constant time after the first
+  // walk, and a spine that was already rebuilt for the same name is re-used.
+  // Like the interning tables, the memos take a shared lock for lookups and
+  // the exclusive lock only to insert.
+  Term Substitute(Term t, Term x, Term n) {
+    if (t == x) {
+      return n;
+    }
+    if (t.arity() == 0 || !Mentions(t, x)) {
+      return t;
+    }
+    const SubstituteKey key{t.id(), x.id(), n.id()};
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(substitute_.mutex);
+      const auto it = substitute_.memo.find(key);
+      if (it != substitute_.memo.end()) {
+        return Term(it->second);
+      }
+    }
+    const Data* d = get_data(t);
+    Vector args;
+    args.reserve(d->args.size());
+    for (const Term arg : d->args) {
+      args.push_back(Substitute(arg, x, n));
+    }
+    const Term r = CreateTerm(d->symbol, args);
+    std::unique_lock<std::shared_timed_mutex> lock(substitute_.mutex);
+    substitute_.memo.insert(std::make_pair(key, r.id()));
+    return r;
+  }
+
  private:
-  struct DataPtrHash { internal::hash32_t operator()(const Term::Data* d) const { return d->hash(); } };
-  struct DataPtrEquals { bool operator()(const Term::Data* a, const Term::Data* b) const { return *a == *b; } };
+  // Symbol ids are only unique within a sort, and Symbol::operator== compares
+  // just the id, so the sort must take part in hash and equality to keep
+  // equally-indexed symbols of different sorts apart in the flat tables.
+  struct DataPtrHash {
+    internal::hash64_t operator()(const Term::Data* d) const {
+      return d->hash() ^ d->symbol.sort().hash();
+    }
+  };
+  struct DataPtrEquals {
+    bool operator()(const Term::Data* a, const Term::Data* b) const {
+      return a->symbol.sort() == b->symbol.sort() && *a == *b;
+    }
+  };
+
+  // A heap stores the Data of all terms of one class, indexed by Term::index().
+  // It grows in fixed-size chunks so that PushBack() never relocates existing
+  // entries, which allows lock-free concurrent reads while terms are created.
+  // PushBack() locks the heap, for threads holding different shard locks may
+  // intern terms of the same class concurrently.
+  class Heap {
+   public:
+    Heap() : chunks_(kMaxChunks, nullptr) {}
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    ~Heap() {
+      for (size_t i = 0; i < size_; ++i) {
+        delete (*this)[i];
+      }
+      for (Data** chunk : chunks_) {
+        delete[] chunk;
+      }
+    }
+
+    Data* operator[](size_t i) const { return chunks_[i >> kLogChunkSize][i & (kChunkSize - 1)]; }
+
+    // The bytes held by the chunks and the Data they point to. Like all
+    // reads, this walks the heap without a lock, so concurrent interning may
+    // or may not be counted.
+    internal::u64 memory_bytes() const {
+      const size_t size = size_;
+      internal::u64 n = ((size + kChunkSize - 1) >> kLogChunkSize) * kChunkSize * sizeof(Data*);
+      for (size_t i = 0; i < size; ++i) {
+        n += sizeof(Data) + (*this)[i]->args.capacity() * sizeof(Term);
+      }
+      return n;
+    }
+
+    size_t PushBack(Data* d) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if ((size_ & (kChunkSize - 1)) == 0) {
+        chunks_[size_ >> kLogChunkSize] = new Data*[kChunkSize];
+      }
+      chunks_[size_ >> kLogChunkSize][size_ & (kChunkSize - 1)] = d;
+      return size_++;
+    }
+
+    size_t size() const { return size_; }
+
+    // Deletes the entries at index n and beyond and frees the chunks that
+    // become entirely vacant, so the next PushBack() hands out index n again.
+    void Truncate(size_t n) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      assert(n <= size_);
+      if (n >= size_) {
+        return;
+      }
+      for (size_t i = n; i < size_; ++i) {
+        LIMBO_MEMORY_DO(internal::Memory::Local().term_bytes_freed +=
+                        sizeof(Data) + (*this)[i]->args.capacity() * sizeof(Term));
+        delete (*this)[i];
+      }
+      for (size_t k = (n + kChunkSize - 1) >> kLogChunkSize; k <= (size_ - 1) >> kLogChunkSize; ++k) {
+        delete[] chunks_[k];
+        chunks_[k] = nullptr;
+      }
+      size_ = n;
+    }
+
+   private:
+    static constexpr size_t kLogChunkSize = 16;
+    static constexpr size_t kChunkSize = size_t(1) << kLogChunkSize;
+    // Large enough for the largest id space, which is the primitive terms'.
+    static constexpr size_t kMaxChunks = (size_t(1) << (sizeof(Id) * 8 - 2)) >> kLogChunkSize;
+
+    std::vector<Data**> chunks_;
+    size_t size_ = 0;
+    std::mutex mutex_;
+  };
+
+  struct SubstituteKey {
+    bool operator==(const SubstituteKey& k) const { return t == k.t && x == k.x && n == k.n; }
+    Id t;
+    Id x;
+    Id n;
+  };
+  struct SubstituteKeyHash {
+    internal::hash64_t operator()(const SubstituteKey& k) const {
+      return internal::splitmix64_hash(k.t) ^ internal::splitmix64_hash(k.x) ^ internal::splitmix64_hash(k.n);
+    }
+  };
+
+  // Memoized version of Term::Mentions(). The result for a term--variable
+  // pair never changes, for terms are immutable.
+  bool Mentions(Term t, Term x) {
+    if (t == x) {
+      return true;
+    }
+    if (t.arity() == 0) {
+      return false;
+    }
+    const internal::u64 key = (internal::u64(t.id()) << 32) | internal::u64(x.id());
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(mentions_.mutex);
+      const auto it = mentions_.memo.find(key);
+      if (it != mentions_.memo.end()) {
+        return it->second;
+      }
+    }
+    const Data* d = get_data(t);
+    bool yes = false;
+    for (const Term arg : d->args) {
+      if (Mentions(arg, x)) {
+        yes = true;
+        break;
+      }
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(mentions_.mutex);
+    mentions_.memo.insert(std::make_pair(key, yes));
+    return yes;
+  }
 
   Factory() = default;
   Factory(const Factory&) = delete;
@@ -428,11 +728,30 @@ class Term::Factory : private Singleton<Factory> {
   Factory& operator=(Factory&&) = delete;
 
   typedef std::unordered_map<Data*, Id, DataPtrHash, DataPtrEquals> DataPtrSet;
-  internal::IntMap<Symbol::Sort, DataPtrSet> memory_;
-  std::vector<Data*> heap_primitive_;
-  std::vector<Data*> heap_name_;
-  std::vector<Data*> heap_variable_;
-  std::vector<Data*> heap_other_;
+
+  static constexpr size_t kNumShards = 64;
+
+  struct Shard {
+    std::shared_timed_mutex mutex;
+    DataPtrSet terms;
+  };
+
+  struct SubstituteCache {
+    std::shared_timed_mutex mutex;
+    std::unordered_map<SubstituteKey, Id, SubstituteKeyHash> memo;
+  };
+  struct MentionsCache {
+    std::shared_timed_mutex mutex;
+    std::unordered_map<internal::u64, bool> memo;
+  };
+
+  std::array<Shard, kNumShards> shards_;
+  SubstituteCache substitute_;
+  MentionsCache mentions_;
+  Heap heap_primitive_;
+  Heap heap_name_;
+  Heap heap_variable_;
+  Heap heap_other_;
 };
 
 struct Term::Substitution {
@@ -557,7 +876,7 @@ namespace std {
 
 template<>
 struct hash<limbo::Symbol::Sort> {
-  limbo::internal::hash32_t operator()(const limbo::Symbol::Sort s) const { return s.hash(); }
+  limbo::internal::hash64_t operator()(const limbo::Symbol::Sort s) const { return s.hash(); }
 };
 
 template<>
@@ -567,7 +886,7 @@ struct equal_to<limbo::Symbol::Sort> {
 
 template<>
 struct hash<limbo::Symbol> {
-  limbo::internal::hash32_t operator()(const limbo::Symbol s) const { return s.hash(); }
+  limbo::internal::hash64_t operator()(const limbo::Symbol s) const { return s.hash(); }
 };
 
 template<>
@@ -577,7 +896,7 @@ struct equal_to<limbo::Symbol> {
 
 template<>
 struct hash<limbo::Term> {
-  limbo::internal::hash32_t operator()(const limbo::Term t) const { return t.hash(); }
+  limbo::internal::hash64_t operator()(const limbo::Term t) const { return t.hash(); }
 };
 
 template<>
@@ -3,6 +3,10 @@
 
 #include <gtest/gtest.h>
 
+#include <iostream>
+#include <random>
+#include <unordered_set>
+
 #include <limbo/term.h>
 #include <limbo/internal/bloom.h>
 #include <limbo/format/output.h>
@@ -83,17 +87,45 @@ TEST(BloomFilterTest, hash) {
 TEST(BloomFilterTest, hash) {
   const uint64_t x = 0xFF03FF02FF01FF00;
   EXPECT_EQ(BloomFilter::index<0>(x), 0x00u);
-  EXPECT_EQ(BloomFilter::index<1>(x), 0x3Fu);
+  EXPECT_EQ(BloomFilter::index<1>(x), 0xFFu);
   EXPECT_EQ(BloomFilter::index<2>(x), 0x01u);
-  EXPECT_EQ(BloomFilter::index<3>(x), 0x3Fu);
+  EXPECT_EQ(BloomFilter::index<3>(x), 0xFFu);
   EXPECT_EQ(BloomFilter::index<4>(x), 0x02u);
-  EXPECT_EQ(BloomFilter::index<5>(x), 0x3Fu);
+  EXPECT_EQ(BloomFilter::index<5>(x), 0xFFu);
   EXPECT_EQ(BloomFilter::index<6>(x), 0x03u);
-  EXPECT_EQ(BloomFilter::index<7>(x), 0x3Fu);
-  EXPECT_EQ(BloomFilter::index<0>(u64(64)), 0u);
-  EXPECT_EQ(BloomFilter::index<0>(u64(63)), 63u);
-  EXPECT_EQ(BloomFilter::index<7>(u64(64) << (7*8)), 0u);
-  EXPECT_EQ(BloomFilter::index<7>(u64(63) << (7*8)), 63u);
+  EXPECT_EQ(BloomFilter::index<7>(x), 0xFFu);
+  EXPECT_EQ(BloomFilter::index<0>(u64(256)), 0u);
+  EXPECT_EQ(BloomFilter::index<0>(u64(255)), 255u);
+  EXPECT_EQ(BloomFilter::index<7>(u64(256) << (7*8)), 0u);
+  EXPECT_EQ(BloomFilter::index<7>(u64(255) << (7*8)), 255u);
+}
+
+TEST(BloomFilterTest, FalsePositiveRate) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<u32> dist;
+  constexpr int kTrials = 1000;
+  constexpr int kProbes = 100;
+  for (int n : {5, 10, 20, 30}) {
+    int false_positives = 0;
+    for (int t = 0; t < kTrials; ++t) {
+      BloomFilter bf;
+      std::unordered_set<u32> added;
+      for (int i = 0; i < n; ++i) {
+        const u32 x = dist(gen);
+        bf.Add(x);
+        added.insert(x);
+      }
+      for (int i = 0; i < kProbes; ++i) {
+        const u32 x = dist(gen);
+        if (added.count(x) == 0 && bf.Contains(x)) {
+          ++false_positives;
+        }
+      }
+    }
+    const double rate = static_cast<double>(false_positives) / (kTrials * kProbes);
+    std::cout << "n = " << n << ": false-positive rate = " << rate << std::endl;
+    EXPECT_LT(rate, n <= 10 ? 0.005 : n <= 20 ? 0.02 : 0.05);
+  }
 }
 
 }  // namespace internal
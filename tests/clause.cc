@@ -30,7 +30,7 @@ static std::pair<Clause::Result, Clause> PropagateUnits(Clause c, const std::set
   return std::make_pair(r, c);
 }
 
-static std::pair<Clause::Result, Clause> PropagateUnits(Clause c, const std::unordered_set<Literal, Literal::LhsHash>& lits) {
+static std::pair<Clause::Result, Clause> PropagateUnits(Clause c, const Literal::LhsSet& lits) {
   const Clause::Result r = c.PropagateUnits(lits);
   return std::make_pair(r, c);
 }
@@ -110,6 +110,28 @@ TEST(ClauseTest, normalization) {
   EXPECT_EQ(Clause({Literal::Neq(f1,n2), Literal::Eq(f1,n1), Literal::Eq(f2,n1)}), Clause({Literal::Neq(f1,n2), Literal::Eq(f2,n1)}));
 }
 
+TEST(ClauseTest, SubstituteNormally) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateNonrigidSort();
+  const Term n1 = tf.CreateTerm(sf.CreateName(s1));
+  const Term n2 = tf.CreateTerm(sf.CreateName(s1));
+  const Term x1 = tf.CreateTerm(sf.CreateVariable(s1));
+  const Symbol f = sf.CreateFunction(s1, 1);
+  const Symbol g = sf.CreateFunction(s1, 1);
+  const Term fx = tf.CreateTerm(f, {x1});
+  const Term gx = tf.CreateTerm(g, {x1});
+
+  const Clause c({Literal::Eq(fx,n1), Literal::Neq(gx,x1)});
+  EXPECT_TRUE(c.SubstitutesNormally());
+  EXPECT_FALSE(Clause({Literal::Eq(fx,n1), Literal::Eq(fx,n2)}).SubstitutesNormally());
+  EXPECT_FALSE(Clause({Literal::Neq(n1,n2)}).SubstitutesNormally());
+
+  for (const Term n : {n1, n2}) {
+    EXPECT_EQ(c.SubstituteNormally(EqSubstitute(x1, n), &tf), c.Substitute(EqSubstitute(x1, n), &tf));
+  }
+}
+
 
 TEST(ClauseTest, Subsumes) {
   Symbol::Factory& sf = *Symbol::Factory::Instance();
@@ -315,20 +337,20 @@ TEST(ClauseTest, Propagate) {
 
   {
     Clause c({Literal::Eq(f1,n1), Literal::Neq(n1,n1)});
-    auto p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Neq(f1,n1)});
+    auto p = PropagateUnits(c, Literal::LhsSet{Literal::Neq(f1,n1)});
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.empty());
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_EQ(p.second, Clause{Literal::Neq(n1,n1)});
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Eq(f1,n2)});
+    p = PropagateUnits(c, Literal::LhsSet{Literal::Eq(f1,n2)});
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.empty());
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_EQ(p.second, Clause{Literal::Neq(n1,n1)});
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Eq(f1,n1)});
+    p = PropagateUnits(c, Literal::LhsSet{Literal::Eq(f1,n1)});
     EXPECT_EQ(p.first, Clause::kSubsumed);
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Eq(f3,n3)});
+    p = PropagateUnits(c, Literal::LhsSet{Literal::Eq(f3,n3)});
     EXPECT_EQ(p.first, Clause::kUnchanged);
   }
 
@@ -338,7 +360,7 @@ TEST(ClauseTest, Propagate) {
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_EQ(p.second, Clause{Literal::Neq(f3,n3)});
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Neq(f1,n1)});
+    p = PropagateUnits(c, Literal::LhsSet{Literal::Neq(f1,n1)});
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_EQ(p.second, Clause{Literal::Neq(f3,n3)});
@@ -346,25 +368,25 @@ TEST(ClauseTest, Propagate) {
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_EQ(p.second, Clause{Literal::Neq(f3,n3)});
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Eq(f1,n2)});
+    p = PropagateUnits(c, Literal::LhsSet{Literal::Eq(f1,n2)});
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_EQ(p.second, Clause{Literal::Neq(f3,n3)});
     p = PropagateUnits(c, std::set<Literal>{Literal::Eq(f1,n1)});
     EXPECT_EQ(p.first, Clause::kSubsumed);
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Eq(f1,n1)});
+    p = PropagateUnits(c, Literal::LhsSet{Literal::Eq(f1,n1)});
     EXPECT_EQ(p.first, Clause::kSubsumed);
     p = PropagateUnits(c, std::set<Literal>{Literal::Eq(f3,n3)});
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_EQ(p.second, Clause{Literal::Eq(f1,n1)});
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Eq(f3,n3)});
+    p = PropagateUnits(c, Literal::LhsSet{Literal::Eq(f3,n3)});
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_EQ(p.second, Clause{Literal::Eq(f1,n1)});
     p = PropagateUnits(c, std::set<Literal>{Literal::Eq(f3,n4)});
     EXPECT_EQ(p.first, Clause::kSubsumed);
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>{Literal::Eq(f3,n4)});
+    p = PropagateUnits(c, Literal::LhsSet{Literal::Eq(f3,n4)});
     EXPECT_EQ(p.first, Clause::kSubsumed);
   }
 
@@ -375,7 +397,7 @@ TEST(ClauseTest, Propagate) {
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_TRUE(p.second.empty());
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>(lits.begin(), lits.end()));
+    p = PropagateUnits(c, Literal::LhsSet(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_TRUE(p.second.empty());
@@ -396,7 +418,7 @@ TEST(ClauseTest, Propagate) {
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_TRUE(p.second.empty());
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>(lits.begin(), lits.end()));
+    p = PropagateUnits(c, Literal::LhsSet(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kPropagated);
     EXPECT_TRUE(p.second.Subsumes(c));
     EXPECT_TRUE(p.second.empty());
@@ -407,7 +429,7 @@ TEST(ClauseTest, Propagate) {
     Clause c({Literal::Eq(f1,n1), Literal::Neq(f3,n4)});
     auto p = PropagateUnits(c, std::set<Literal>(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>(lits.begin(), lits.end()));
+    p = PropagateUnits(c, Literal::LhsSet(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
   }
 
@@ -416,7 +438,7 @@ TEST(ClauseTest, Propagate) {
     Clause c({Literal::Eq(f1,n1), Literal::Neq(f3,n4)});
     auto p = PropagateUnits(c, std::set<Literal>(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>(lits.begin(), lits.end()));
+    p = PropagateUnits(c, Literal::LhsSet(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
   }
 
@@ -425,7 +447,7 @@ TEST(ClauseTest, Propagate) {
     Clause c({Literal::Eq(f1,n1), Literal::Neq(f3,n4)});
     auto p = PropagateUnits(c, std::set<Literal>(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>(lits.begin(), lits.end()));
+    p = PropagateUnits(c, Literal::LhsSet(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
   }
 
@@ -434,7 +456,7 @@ TEST(ClauseTest, Propagate) {
     Clause c({Literal::Eq(f1,n1), Literal::Neq(f3,n4)});
     auto p = PropagateUnits(c, std::set<Literal>(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>(lits.begin(), lits.end()));
+    p = PropagateUnits(c, Literal::LhsSet(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
   }
 
@@ -443,7 +465,7 @@ TEST(ClauseTest, Propagate) {
     Clause c({Literal::Eq(f1,n2), Literal::Neq(f3,n3)});
     auto p = PropagateUnits(c, std::set<Literal>(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
-    p = PropagateUnits(c, std::unordered_set<Literal, Literal::LhsHash>(lits.begin(), lits.end()));
+    p = PropagateUnits(c, Literal::LhsSet(lits.begin(), lits.end()));
     EXPECT_EQ(p.first, Clause::kSubsumed);
   }
 }
@@ -120,5 +120,65 @@ TEST(Formula, NF) {
   }
 }
 
+TEST(FormulaTest, hash) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateNonrigidSort();
+  const Term n1 = tf.CreateTerm(sf.CreateName(s1));
+  const Term x1 = tf.CreateTerm(sf.CreateVariable(s1));
+  const Symbol a = sf.CreateFunction(s1, 0);
+  const Term f1 = tf.CreateTerm(a, {});
+
+  const Formula::Ref phi = F::Exists(x1, F::Atomic(Clause{Literal::Eq(f1, x1)}));
+  const Formula::Ref psi = F::Not(phi->Clone());
+  // Clones are structurally equal and hash alike.
+  EXPECT_TRUE(*phi == *phi->Clone());
+  EXPECT_EQ(phi->hash(), phi->Clone()->hash());
+  EXPECT_EQ(psi->hash(), psi->Clone()->hash());
+  EXPECT_NE(phi->hash(), psi->hash());
+  // The belief level distinguishes otherwise identical modal formulas.
+  const Formula::Ref k0 = F::Know(0, phi->Clone());
+  const Formula::Ref k1 = F::Know(1, phi->Clone());
+  EXPECT_FALSE(*k0 == *k1);
+  EXPECT_NE(k0->hash(), k1->hash());
+  EXPECT_EQ(k1->hash(), k1->Clone()->hash());
+  // A substitution mutates the formula in place and drops the memoized hash.
+  const Formula::Ref chi = phi->Clone();
+  EXPECT_EQ(chi->hash(), phi->hash());
+  chi->SubstituteFree(Term::Substitution(f1, n1), &tf);
+  EXPECT_NE(chi->hash(), phi->hash());
+  EXPECT_EQ(chi->hash(), F::Exists(x1, F::Atomic(Clause{Literal::Eq(n1, x1)}))->hash());
+}
+
+TEST(Formula, NFIdentityForNormal) {
+  Context ctx;
+  Term::Factory& tf = *ctx.tf();
+  auto BOOL = ctx.CreateNonrigidSort();
+  auto True = ctx.CreateName(BOOL);                 REGISTER_SYMBOL(True);
+  auto HUMAN = ctx.CreateNonrigidSort();
+  auto Father = ctx.CreateFunction(HUMAN, 1);       REGISTER_SYMBOL(Father);
+  auto IsParentOf = ctx.CreateFunction(BOOL, 2);    REGISTER_SYMBOL(IsParentOf);
+  auto n = ctx.CreateName(HUMAN);                   REGISTER_SYMBOL(n);
+  auto x = ctx.CreateVariable(HUMAN);               REGISTER_SYMBOL(x);
+  {
+    // NF() of an NF() output is just a copy. Without the normal-form flag,
+    // the second call would flatten Father(x) with a fresh temporary
+    // variable again and the results would not be structurally equal.
+    auto phi = *Fa(x, IsParentOf(Father(x), x) == True);
+    auto nf1 = phi->NF(ctx.sf(), ctx.tf());
+    auto nf2 = nf1->NF(ctx.sf(), ctx.tf());
+    EXPECT_EQ(*nf1, *nf2);
+  }
+  {
+    // A ground clause of primitive literals is recognized as normal on
+    // construction, and a substitution drops the flag with the other memos.
+    auto phi = F::Atomic(Clause{Literal::Eq(tf.CreateTerm(Father, {n}), n)});
+    EXPECT_EQ(*phi->NF(ctx.sf(), ctx.tf()), *phi);
+    auto psi = F::Atomic(Clause{Literal::Eq(tf.CreateTerm(Father, {x}), n)});
+    psi->SubstituteFree(Term::Substitution(x, n), &tf);
+    EXPECT_EQ(*psi->NF(ctx.sf(), ctx.tf()), *phi);
+  }
+}
+
 }  // namespace limbo
 
@@ -189,6 +189,133 @@ TEST(GrounderTest, Ground_SplitTerms_Names_Consolidated) {
   }
 }
 
+TEST(GrounderTest, ParallelGrounding) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sa = sf.CreateNonrigidSort();          RegisterSort(sa, "");
+  const Term m1 = tf.CreateTerm(sf.CreateName(sa));         RegisterSymbol(m1.symbol(), "m1");
+  const Term m2 = tf.CreateTerm(sf.CreateName(sa));         RegisterSymbol(m2.symbol(), "m2");
+  const Term x1 = tf.CreateTerm(sf.CreateVariable(sa));     RegisterSymbol(x1.symbol(), "x1");
+  const Term x2 = tf.CreateTerm(sf.CreateVariable(sa));     RegisterSymbol(x2.symbol(), "x2");
+  const Symbol s_f = sf.CreateFunction(sa, 1);              RegisterSymbol(s_f, "f");
+  const Symbol s_g = sf.CreateFunction(sa, 1);              RegisterSymbol(s_g, "g");
+  const Term fm1 = tf.CreateTerm(s_f, {m1});
+  const Term gm1 = tf.CreateTerm(s_g, {m1});
+  const Term fx1 = tf.CreateTerm(s_f, {x1});
+  const Term gx2 = tf.CreateTerm(s_g, {x2});
+
+  // The parallel grounder must produce the same ground instances as the
+  // sequential one, both for the initial batch and when old clauses are
+  // reground with the names of a later ply. The setups cannot be compared
+  // clause by clause since each grounder picks its own plus-names, but they
+  // must have the same size and agree on the instances over mentioned names.
+  Grounder g(&sf, &tf);
+  Grounder h(&sf, &tf);
+  h.set_n_threads(4);
+  const std::vector<Clause> cs1{Clause{Literal::Eq(fx1, m1), Literal::Eq(gx2, m1)}};
+  const std::vector<Clause> cs2{Clause{Literal::Neq(fx1, m2)}};
+  g.AddClauses(cs1.begin(), cs1.end());
+  h.AddClauses(cs1.begin(), cs1.end());
+  EXPECT_EQ(unique_length(g.setup()), unique_length(h.setup()));
+  EXPECT_EQ(S(h.setup()).count(Clause({Literal::Eq(fm1, m1), Literal::Eq(gm1, m1)})), 1u);
+  g.AddClauses(cs2.begin(), cs2.end());
+  h.AddClauses(cs2.begin(), cs2.end());
+  EXPECT_EQ(unique_length(g.setup()), unique_length(h.setup()));
+  EXPECT_TRUE(h.setup().Subsumes(Clause({Literal::Neq(fm1, m2)})));
+  EXPECT_EQ(S(g.names(sa)).size(), S(h.names(sa)).size());
+}
+
+TEST(GrounderTest, GroundInstanceCache) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sa = sf.CreateNonrigidSort();          RegisterSort(sa, "");
+  const Term m1 = tf.CreateTerm(sf.CreateName(sa));         RegisterSymbol(m1.symbol(), "m1");
+  const Term m2 = tf.CreateTerm(sf.CreateName(sa));         RegisterSymbol(m2.symbol(), "m2");
+  const Term x1 = tf.CreateTerm(sf.CreateVariable(sa));     RegisterSymbol(x1.symbol(), "x1");
+  const Term x2 = tf.CreateTerm(sf.CreateVariable(sa));     RegisterSymbol(x2.symbol(), "x2");
+  const Symbol s_f = sf.CreateFunction(sa, 1);              RegisterSymbol(s_f, "f");
+  const Symbol s_g = sf.CreateFunction(sa, 1);              RegisterSymbol(s_g, "g");
+  const Term fx1 = tf.CreateTerm(s_f, {x1});
+  const Term gx2 = tf.CreateTerm(s_g, {x2});
+
+  // Repeating a query re-creates the same plus-names, so the regrounded
+  // instances come from the cache; the setup must look exactly as if they
+  // had been derived from scratch, and undoing the query ply must still
+  // restore the original setup.
+  Grounder g(&sf, &tf);
+  g.AddClause(Clause{Literal::Eq(fx1, m1), Literal::Neq(fx1, m2)});
+  const ClauseSet base = S(g.setup());
+  const auto phi = Formula::Factory::Exists(x2, Formula::Factory::Atomic(Clause{Literal::Eq(gx2, m1)}))->NF(&sf, &tf);
+  ClauseSet first;
+  for (int i = 0; i < 3; ++i) {
+    Grounder::Undo undo;
+    g.PrepareForQuery(*phi, &undo);
+    if (i == 0) {
+      first = S(g.setup());
+    } else {
+      EXPECT_EQ(S(g.setup()), first);
+    }
+  }
+  EXPECT_EQ(S(g.setup()), base);
+}
+
+TEST(GrounderTest, LazyGrounding) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sa = sf.CreateNonrigidSort();          RegisterSort(sa, "");
+  const Term m1 = tf.CreateTerm(sf.CreateName(sa));         RegisterSymbol(m1.symbol(), "m1");
+  const Term x1 = tf.CreateTerm(sf.CreateVariable(sa));     RegisterSymbol(x1.symbol(), "x1");
+  const Symbol s_f1 = sf.CreateFunction(sa, 1);             RegisterSymbol(s_f1, "f1");
+  const Symbol s_f2 = sf.CreateFunction(sa, 1);             RegisterSymbol(s_f2, "f2");
+  const Symbol s_g1 = sf.CreateFunction(sa, 1);             RegisterSymbol(s_g1, "g1");
+  const Symbol s_g2 = sf.CreateFunction(sa, 1);             RegisterSymbol(s_g2, "g2");
+  const Symbol s_h1 = sf.CreateFunction(sa, 1);             RegisterSymbol(s_h1, "h1");
+  const Term f1m1 = tf.CreateTerm(s_f1, {m1});
+  const Term f2m1 = tf.CreateTerm(s_f2, {m1});
+  const Term g1m1 = tf.CreateTerm(s_g1, {m1});
+  const Term g2m1 = tf.CreateTerm(s_g2, {m1});
+  const Term h1m1 = tf.CreateTerm(s_h1, {m1});
+  const Term f1x1 = tf.CreateTerm(s_f1, {x1});
+  const Term f2x1 = tf.CreateTerm(s_f2, {x1});
+  const Term g1x1 = tf.CreateTerm(s_g1, {x1});
+  const Term g2x1 = tf.CreateTerm(s_g2, {x1});
+  const Term h1x1 = tf.CreateTerm(s_h1, {x1});
+
+  const Clause cf = Clause({Literal::Eq(f1x1, m1), Literal::Eq(f2x1, m1)});
+  const Clause cg = Clause({Literal::Eq(g1x1, m1), Literal::Eq(g2x1, m1)});
+  const Clause ch = Clause({Literal::Eq(h1x1, m1)});
+  const Clause cf_m1 = Clause({Literal::Eq(f1m1, m1), Literal::Eq(f2m1, m1)});
+  const Clause cg_m1 = Clause({Literal::Eq(g1m1, m1), Literal::Eq(g2m1, m1)});
+  const auto phi_f = Formula::Factory::Atomic(Clause{Literal::Eq(f2m1, m1)});
+  const auto phi_g = Formula::Factory::Atomic(Clause{Literal::Eq(g1m1, m1)});
+
+  Grounder g(&sf, &tf);
+  g.set_lazy(true);
+  g.AddClause(cf);
+  g.AddClause(cg);
+  g.AddClause(ch);
+  // Nothing is ground until a query needs it.
+  EXPECT_EQ(unique_length(g.setup()), 0u);
+  {
+    // Under a consistency guarantee, only the clauses connected to the query
+    // by shared function symbols are flushed.
+    Grounder::Undo u1, u2;
+    g.GuaranteeConsistency(*phi_f, &u1);
+    g.PrepareForQuery(*phi_f, &u2);
+    EXPECT_EQ(S(g.setup()).count(cf_m1), 1u);
+    EXPECT_EQ(S(g.setup()).count(cg_m1), 0u);
+  }
+  // The flushed clauses persist beyond the query's Undo.
+  EXPECT_EQ(S(g.setup()).count(cf_m1), 1u);
+  {
+    // Without a guarantee, everything still pending is flushed.
+    Grounder::Undo u;
+    g.PrepareForQuery(*phi_g, &u);
+    EXPECT_EQ(S(g.setup()).count(cg_m1), 1u);
+    EXPECT_TRUE(g.setup().Subsumes(Clause({Literal::Eq(h1m1, m1)})));
+  }
+}
+
 #if 0
 TEST(GrounderTest, Ground_SplitTerms_Names) {
   Symbol::Factory& sf = *Symbol::Factory::Instance();
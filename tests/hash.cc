@@ -30,6 +30,30 @@ TEST(HashTest, hash) {
   }
 }
 
+TEST(HashTest, splitmix64) {
+  // The finalizer is a bijection, so full 64 bit hashes of distinct inputs
+  // never collide.
+  for (uint64_t i = 0, n = 1; i <= 19; ++i, n *= 10UL) {
+    uint64_t copy = n;
+    EXPECT_EQ(splitmix64_hash(n), splitmix64_hash(copy));
+    EXPECT_NE(splitmix64_hash(0UL + n), splitmix64_hash(1UL + n));
+  }
+
+  // Term and literal ids are small and dense, and hash tables only see the
+  // hash modulo their bucket count. For 2^16 sequential ids thrown into 2^16
+  // buckets, a well-mixed hash occupies about (1 - 1/e) = 63% of the buckets.
+  constexpr uint64_t n = uint64_t(1) << 16;
+  std::vector<bool> occupied(n, false);
+  uint64_t distinct = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+    const uint64_t b = splitmix64_hash(i) & (n - 1);
+    distinct += !occupied[b];
+    occupied[b] = true;
+  }
+  EXPECT_GE(distinct, n * 60 / 100);
+  EXPECT_LE(distinct, n * 66 / 100);
+}
+
 }  // namespace internal
 }  // namespace limbo
 
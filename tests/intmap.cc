@@ -50,6 +50,23 @@ TEST(IntMapTest, general) {
   EXPECT_EQ(map[4], "four");
 }
 
+TEST(IntMapTest, FitForKeys) {
+  IntMap<int, std::string> map;
+  map.set_null_value("null");
+  map.FitForKeys(3);
+  EXPECT_EQ(map.n_keys(), 3u);
+  EXPECT_EQ(map[0], "null");
+  EXPECT_EQ(map[2], "null");
+  map[1] = "one";
+  map.FitForKeys(2);  // shrinks nothing
+  EXPECT_EQ(map.n_keys(), 3u);
+  EXPECT_EQ(map[1], "one");
+  map.FitForKeys(5);
+  EXPECT_EQ(map.n_keys(), 5u);
+  EXPECT_EQ(map[1], "one");
+  EXPECT_EQ(map[4], "null");
+}
+
 }  // namespace internal
 }  // namespace limbo
 
@@ -3,6 +3,8 @@
 
 #include <gtest/gtest.h>
 
+#include <sstream>
+
 #include <limbo/knowledge_base.h>
 #include <limbo/format/output.h>
 #include <limbo/format/cpp/syntax.h>
@@ -68,11 +70,190 @@ TEST(KnowledgeBaseTest, ECAI2016Sound_NoGuarantee) {
   EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(Italian != T), *(Aussie == T))));
   EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(Meat(roo) != T), *(T != T))));
   EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(~Fa(x, (Veggie == T && Meat(x) == T) >> (Eats(x) != T))), *(T != T))));
+  // The first round of queries is evaluated concurrently; the second round
+  // re-asks the same formulas single-threadedly, which hits the query cache
+  // and must return the same verdicts.
+  kb.set_n_threads(4);
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Bel(0, 0, *(Italian != T), *(Veggie != T))));
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Bel(0, 1, *(Italian != T), *(Veggie != T))));
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Bel(1, 0, *(Italian != T), *(Veggie != T))));
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Bel(1, 1, *(Italian != T), *(Veggie != T))));
+  kb.set_n_threads(1);
   EXPECT_FALSE(kb.Entails(*Formula::Factory::Bel(0, 0, *(Italian != T), *(Veggie != T))));
   EXPECT_FALSE(kb.Entails(*Formula::Factory::Bel(0, 1, *(Italian != T), *(Veggie != T))));
   EXPECT_FALSE(kb.Entails(*Formula::Factory::Bel(1, 0, *(Italian != T), *(Veggie != T))));
   EXPECT_TRUE(kb.Entails(*Formula::Factory::Bel(1, 1, *(Italian != T), *(Veggie != T))));
 }
 
+TEST(KnowledgeBaseTest, QueryCache) {
+  Context ctx;
+  KnowledgeBase kb(ctx.sf(), ctx.tf());
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  Formula::Ref query = Formula::Factory::Know(0, *(Veggie == T));
+  EXPECT_FALSE(kb.Entails(*query));
+  EXPECT_FALSE(kb.Entails(*query));
+  // Add() bumps the mutation epoch, which invalidates the cached verdict.
+  kb.Add((Veggie == T).as_clause());
+  EXPECT_TRUE(kb.Entails(*query));
+  EXPECT_TRUE(kb.Entails(*query));
+}
+
+TEST(KnowledgeBaseTest, QueryCacheRevalidation) {
+  Context ctx;
+  KnowledgeBase kb(ctx.sf(), ctx.tf());
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  auto Italian = ctx.CreateFunction(Bool, 0)();   REGISTER_SYMBOL(Italian);
+  kb.Add((Aussie != T || Veggie == T).as_clause());
+  Formula::Ref query = Formula::Factory::Know(1, *(Veggie == T));
+  EXPECT_FALSE(kb.Entails(*query));
+  // Italian shares no symbol with the query's component, so the cached
+  // verdict survives the addition.
+  kb.Add((Italian == T).as_clause());
+  EXPECT_FALSE(kb.Entails(*query));
+  // Aussie is in the support through the clause above, so this addition
+  // invalidates the cached verdict, and re-evaluation flips it.
+  kb.Add((Aussie == T).as_clause());
+  EXPECT_TRUE(kb.Entails(*query));
+}
+
+TEST(KnowledgeBaseTest, IncrementalSpheres) {
+  Context ctx;
+  KnowledgeBase kb(ctx.sf(), ctx.tf());
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto Food = ctx.CreateNonrigidSort();           RegisterSort(Food, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Italian = ctx.CreateFunction(Bool, 0)();   REGISTER_SYMBOL(Italian);
+  auto Eats = ctx.CreateFunction(Bool, 1);        REGISTER_SYMBOL(Eats);
+  auto Meat = ctx.CreateFunction(Bool, 1);        REGISTER_SYMBOL(Meat);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  auto Sunny = ctx.CreateFunction(Bool, 0)();     REGISTER_SYMBOL(Sunny);
+  auto roo = ctx.CreateName(Food);                REGISTER_SYMBOL(roo);
+  auto x = ctx.CreateVariable(Food);              REGISTER_SYMBOL(x);
+  Formula::belief_level k = 1;
+  Formula::belief_level l = 1;
+  EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(Aussie == T), *(Italian != T))));
+  EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(Italian == T), *(Aussie != T))));
+  EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(Aussie == T), *(Eats(roo) == T))));
+  EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(T == T), *(Italian == T || Veggie == T))));
+  EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(Italian != T), *(Aussie == T))));
+  EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(Meat(roo) != T), *(T != T))));
+  EXPECT_TRUE(kb.Add(*Formula::Factory::Bel(k, l, *(~Fa(x, (Veggie == T && Meat(x) == T) >> (Eats(x) != T))), *(T != T))));
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Bel(1, 1, *(Italian != T), *(Veggie != T))));
+  const KnowledgeBase::sphere_index n = kb.n_spheres();
+  // Sunny is disconnected from every conditional, so the sphere structure
+  // stands and the new clause joins the existing spheres.
+  kb.Add((Sunny == T).as_clause());
+  EXPECT_EQ(kb.n_spheres(), n);
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(0, *(Sunny == T))));
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Bel(1, 1, *(Italian != T), *(Veggie != T))));
+  // Eats is in the conditionals' support, so this addition rebuilds the
+  // sphere system; the verdicts must be unchanged either way.
+  kb.Add((Eats(roo) == T).as_clause());
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Bel(1, 1, *(Italian != T), *(Veggie != T))));
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(0, *(Sunny == T))));
+}
+
+TEST(KnowledgeBaseTest, AddClauses) {
+  Context ctx;
+  KnowledgeBase kb(ctx.sf(), ctx.tf());
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  const std::vector<Clause> cs{(Aussie == T).as_clause(), (Aussie != T || Veggie == T).as_clause()};
+  kb.Reserve(cs.size());
+  kb.AddClauses(cs.begin(), cs.end());
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Know(1, *(Veggie != T))));
+}
+
+TEST(KnowledgeBaseTest, ReserveDimensions) {
+  Context ctx;
+  KnowledgeBase kb(ctx.sf(), ctx.tf());
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  kb.Reserve(1, 1, 2, 2);
+  kb.Add((Aussie == T).as_clause());
+  kb.Add((Aussie != T || Veggie == T).as_clause());
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Know(1, *(Veggie != T))));
+}
+
+TEST(KnowledgeBaseTest, SaveLoad) {
+  Context ctx;
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  std::stringstream ss;
+  {
+    KnowledgeBase kb(ctx.sf(), ctx.tf());
+    kb.Add((Aussie == T).as_clause());
+    kb.Add((Aussie != T || Veggie == T).as_clause());
+    EXPECT_TRUE(kb.Save(&ss));
+  }
+  KnowledgeBase kb(ctx.sf(), ctx.tf());
+  EXPECT_TRUE(kb.Load(&ss));
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Know(1, *(Veggie != T))));
+}
+
+TEST(KnowledgeBaseTest, BacktrackTerms) {
+  Context ctx;
+  KnowledgeBase kb(ctx.sf(), ctx.tf());
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  kb.Add((Aussie == T).as_clause());
+  kb.Add((Aussie != T || Veggie == T).as_clause());
+  const Term::Factory::Mark mark = kb.MarkTerms();
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Know(1, *(Veggie != T))));
+  // The queries' by-products -- plus-names, groundings, reduced formulas --
+  // are released; re-asking re-interns them and reproduces the verdicts.
+  kb.BacktrackTerms(mark);
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Know(1, *(Veggie != T))));
+  // The mark survives a release cycle, so one snapshot serves forever.
+  kb.BacktrackTerms(mark);
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+}
+
+TEST(KnowledgeBaseTest, SaveEmbedded) {
+  Context ctx;
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  std::stringstream snapshot;
+  std::stringstream source;
+  {
+    KnowledgeBase kb(ctx.sf(), ctx.tf());
+    kb.Add((Aussie == T).as_clause());
+    kb.Add((Aussie != T || Veggie == T).as_clause());
+    EXPECT_TRUE(kb.Save(&snapshot));
+    EXPECT_TRUE(kb.SaveEmbedded(&source, "kb_data"));
+  }
+  // The generated translation unit defines the array and its size.
+  EXPECT_NE(source.str().find("extern const unsigned char kb_data[]"), std::string::npos);
+  EXPECT_NE(source.str().find("extern const unsigned long long kb_data_size"), std::string::npos);
+  // The embedded bytes are the Save() snapshot; restoring from memory must
+  // behave like Load() from a stream.
+  const std::string bytes = snapshot.str();
+  KnowledgeBase kb(ctx.sf(), ctx.tf());
+  EXPECT_TRUE(kb.Load(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size()));
+  EXPECT_TRUE(kb.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+  EXPECT_FALSE(kb.Entails(*Formula::Factory::Know(1, *(Veggie != T))));
+}
+
 }  // namespace limbo
 
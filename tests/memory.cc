@@ -0,0 +1,56 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+
+// The allocation counters are compiled out by default; since limbo is
+// header-only, this translation unit can switch them on for itself.
+#define LIMBO_MEMORY
+
+#include <gtest/gtest.h>
+
+#include <limbo/solver.h>
+#include <limbo/format/output.h>
+#include <limbo/format/cpp/syntax.h>
+
+namespace limbo {
+
+using namespace limbo::format;
+using namespace limbo::format::cpp;
+
+#define REGISTER_SYMBOL(x)    RegisterSymbol(x, #x)
+
+inline void RegisterSymbol(Term t, const std::string& n) {
+  RegisterSymbol(t.symbol(), n);
+}
+
+TEST(MemoryTest, Profile) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  auto Bool = ctx.CreateNonrigidSort();             RegisterSort(Bool, "");
+  auto True = ctx.CreateName(Bool);                 REGISTER_SYMBOL(True);
+  auto Human = ctx.CreateNonrigidSort();            RegisterSort(Human, "");
+  auto Sonny = ctx.CreateName(Human);               REGISTER_SYMBOL(Sonny);
+  auto f = ctx.CreateFunction(Human, 0);            REGISTER_SYMBOL(f);
+  auto g = ctx.CreateFunction(Bool, 0);             REGISTER_SYMBOL(g);
+  const internal::MemoryProfile before = solver.memory_profile();
+  solver.grounder().AddClause(( f() != Sonny || g() == True ).as_clause());
+  solver.grounder().AddClause(( f() == Sonny || g() == True ).as_clause());
+  auto phi = (g() == True)->NF(ctx.sf(), ctx.tf());
+  EXPECT_TRUE(solver.Entails(1, *phi));
+  const internal::MemoryProfile after = solver.memory_profile();
+  EXPECT_GT(after.term_factory_bytes, 0u);
+  EXPECT_GT(after.grounder_bytes, 0u);
+  EXPECT_GT(after.setup_bytes, 0u);
+  EXPECT_GT(after.total(), before.total());
+}
+
+TEST(MemoryTest, AllocationCounters) {
+  const internal::u64 before = internal::Memory::Local().term_bytes_allocated;
+  Context ctx;
+  auto Human = ctx.CreateNonrigidSort();
+  auto Sonny = ctx.CreateName(Human);
+  auto f = ctx.CreateFunction(Human, 1);
+  f(Sonny);  // interns the term f(Sonny)
+  EXPECT_GT(internal::Memory::Local().term_bytes_allocated, before);
+}
+
+}  // namespace limbo
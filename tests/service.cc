@@ -0,0 +1,70 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <limbo/service.h>
+#include <limbo/format/output.h>
+#include <limbo/format/cpp/syntax.h>
+
+namespace limbo {
+
+using namespace limbo::format;
+using namespace limbo::format::cpp;
+
+#define REGISTER_SYMBOL(x)    RegisterSymbol(x, #x)
+
+inline void RegisterSymbol(Term t, const std::string& n) {
+  RegisterSymbol(t.symbol(), n);
+}
+
+TEST(ServiceTest, Epochs) {
+  Context ctx;
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  KnowledgeBaseService service(ctx.sf(), ctx.tf());
+  service.Add((Aussie == T).as_clause());
+  service.Add((Aussie != T || Veggie == T).as_clause());
+  // Nothing published yet, so the query runs against the initial empty epoch.
+  EXPECT_FALSE(service.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+  EXPECT_TRUE(service.Publish());
+  EXPECT_TRUE(service.Entails(*Formula::Factory::Know(1, *(Veggie == T))));
+  EXPECT_FALSE(service.Entails(*Formula::Factory::Know(1, *(Veggie != T))));
+}
+
+TEST(ServiceTest, ConcurrentReaders) {
+  Context ctx;
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  KnowledgeBaseService service(ctx.sf(), ctx.tf());
+  service.Add((Aussie == T).as_clause());
+  service.Add((Aussie != T || Veggie == T).as_clause());
+  EXPECT_TRUE(service.Publish());
+  auto pos = Formula::Factory::Know(1, *(Veggie == T));
+  auto neg = Formula::Factory::Know(1, *(Veggie != T));
+  std::atomic<int> wrong{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&]() {
+      for (int j = 0; j < 10; ++j) {
+        if (!service.Entails(*pos) || service.Entails(*neg)) {
+          ++wrong;
+        }
+      }
+    });
+  }
+  for (std::thread& t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(wrong.load(), 0);
+}
+
+}  // namespace limbo
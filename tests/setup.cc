@@ -65,14 +65,15 @@ TEST(SetupTest, Subsumes_clauses) {
 
     {
       limbo::Setup& s1 = s0;
-      EXPECT_EQ(s1.AddClause(Clause({Literal::Neq(fn,n), Literal::Eq(fm,m)})), limbo::Setup::kOk);
-      EXPECT_EQ(s1.AddClause(Clause({Literal::Neq(gn,n), Literal::Eq(gm,m)})), limbo::Setup::kOk);
+      // Exact duplicates are detected by the fingerprint table and skipped.
+      EXPECT_EQ(s1.AddClause(Clause({Literal::Neq(fn,n), Literal::Eq(fm,m)})), limbo::Setup::kSubsumed);
+      EXPECT_EQ(s1.AddClause(Clause({Literal::Neq(gn,n), Literal::Eq(gm,m)})), limbo::Setup::kSubsumed);
       EXPECT_EQ(s1.AddClause(Clause({Literal::Neq(a,n), Literal::Eq(fn,n)})), limbo::Setup::kOk);
       EXPECT_EQ(s1.AddClause(Clause({Literal::Neq(a,n), Literal::Eq(gn,n)})), limbo::Setup::kOk);
-      EXPECT_EQ(length(s1), 6u);
+      EXPECT_EQ(length(s1), 4u);
       EXPECT_EQ(unique_length(s1), 4u);
       s1.Minimize();
-      EXPECT_EQ(length(s1), 6u);
+      EXPECT_EQ(length(s1), 4u);
       EXPECT_EQ(unique_length(s1), 4u);
       for (const auto i : s1.clauses()) {
         EXPECT_TRUE(s1.clause(i));
@@ -83,7 +84,7 @@ TEST(SetupTest, Subsumes_clauses) {
       {
         limbo::Setup& s2 = s1;
         EXPECT_EQ(s2.AddClause(Clause({Literal::Eq(a,m), Literal::Eq(a,n)})), limbo::Setup::kOk);
-        EXPECT_EQ(length(s2), 7u);
+        EXPECT_EQ(length(s2), 5u);
         EXPECT_EQ(unique_length(s2), 5u);
         for (const auto i : s2.clauses()) {
           EXPECT_TRUE(s2.clause(i));
@@ -104,5 +105,107 @@ TEST(SetupTest, Subsumes_clauses) {
   }
 }
 
+TEST(SetupTest, Consistent) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateNonrigidSort();    RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(Symbol::Factory::CreateName(1, s1));
+  const Term m = tf.CreateTerm(Symbol::Factory::CreateName(2, s1));
+  const Term a = tf.CreateTerm(Symbol::Factory::CreateFunction(1, s1, 0), {});
+  const Term b = tf.CreateTerm(Symbol::Factory::CreateFunction(2, s1, 0), {});
+  const Term fn = tf.CreateTerm(Symbol::Factory::CreateFunction(3, s1, 1), {n});
+
+  limbo::Setup s0;
+  EXPECT_TRUE(s0.Consistent());
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(a,n), Literal::Eq(fn,n)})), limbo::Setup::kOk);
+  EXPECT_TRUE(s0.Consistent());
+  // fn = n and fn = m are complementary, so the check fails.
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(b,n), Literal::Eq(fn,m)})), limbo::Setup::kOk);
+  EXPECT_FALSE(s0.Consistent());
+
+  // a = n resolves the conflict: the first clause is subsumed by the derived
+  // unit fn = n, which in turn falsifies fn = m, and the remaining b != n
+  // subsumes the second clause. Killing the ShallowCopy restores the conflict.
+  {
+    limbo::Setup::ShallowCopy sc = s0.shallow_copy();
+    EXPECT_EQ(sc.AddUnit(Literal::Eq(a,n)), limbo::Setup::kOk);
+    EXPECT_TRUE(s0.Subsumes(Clause({Literal::Eq(fn,n)})));
+    EXPECT_TRUE(s0.Consistent());
+  }
+  EXPECT_FALSE(s0.Consistent());
+
+  // A spawned setup inherits the index and diverges independently.
+  limbo::Setup t = s0.Spawn();
+  EXPECT_FALSE(t.Consistent());
+  EXPECT_EQ(t.AddUnit(Literal::Eq(a,n)), limbo::Setup::kOk);
+  EXPECT_TRUE(t.Consistent());
+  EXPECT_FALSE(s0.Consistent());
+
+  // A single clause with two complementary literals also fails the check.
+  limbo::Setup u;
+  EXPECT_EQ(u.AddClause(Clause({Literal::Eq(fn,n), Literal::Eq(fn,m)})), limbo::Setup::kOk);
+  EXPECT_FALSE(u.Consistent());
+  u.Minimize();
+  EXPECT_FALSE(u.Consistent());
+}
+
+TEST(SetupTest, Activity) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateNonrigidSort();    RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(Symbol::Factory::CreateName(1, s1));
+  const Term a = tf.CreateTerm(Symbol::Factory::CreateFunction(1, s1, 0), {});
+  const Term fn = tf.CreateTerm(Symbol::Factory::CreateFunction(3, s1, 1), {n});
+
+  limbo::Setup s0;
+  EXPECT_EQ(s0.activity(a), 0.0);
+  EXPECT_EQ(s0.activity(fn), 0.0);
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(a,n), Literal::Eq(fn,n)})), limbo::Setup::kOk);
+  // Adding a = n propagates fn = n, which bumps both terms.
+  EXPECT_EQ(s0.AddUnit(Literal::Eq(a,n)), limbo::Setup::kOk);
+  EXPECT_GT(s0.activity(a), 0.0);
+  EXPECT_GT(s0.activity(fn), 0.0);
+}
+
+TEST(SetupTest, Spawn) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateNonrigidSort();    RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(Symbol::Factory::CreateName(1, s1));
+  const Term m = tf.CreateTerm(Symbol::Factory::CreateName(2, s1));
+  const Term a = tf.CreateTerm(Symbol::Factory::CreateFunction(1, s1, 0), {});
+  const Term fn = tf.CreateTerm(Symbol::Factory::CreateFunction(3, s1, 1), {n});
+  const Term gn = tf.CreateTerm(Symbol::Factory::CreateFunction(4, s1, 1), {n});
+
+  limbo::Setup s0;
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(a,n), Literal::Eq(fn,n)})), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(a,n), Literal::Eq(gn,n)})), limbo::Setup::kOk);
+  s0.Minimize();
+  const ClauseSet base = S(s0);
+
+  limbo::Setup t1 = s0.Spawn();
+  limbo::Setup t2 = s0.Spawn();
+  EXPECT_EQ(S(t1), base);
+  EXPECT_EQ(S(t2), base);
+
+  // The spawned setups diverge without affecting each other or the base.
+  EXPECT_EQ(t1.AddClause(Clause({Literal::Eq(a,n)})), limbo::Setup::kOk);
+  EXPECT_EQ(t2.AddClause(Clause({Literal::Neq(a,n)})), limbo::Setup::kOk);
+  EXPECT_TRUE(t1.Subsumes(Clause({Literal::Eq(fn,n)})));
+  EXPECT_TRUE(t1.Subsumes(Clause({Literal::Eq(gn,n)})));
+  EXPECT_FALSE(t2.Subsumes(Clause({Literal::Eq(fn,n)})));
+  EXPECT_FALSE(t1.Subsumes(Clause({Literal::Neq(a,n)})));
+  EXPECT_TRUE(t2.Subsumes(Clause({Literal::Neq(a,n)})));
+  EXPECT_EQ(S(s0), base);
+
+  // ShallowCopy backtracking still works on a spawned setup.
+  {
+    limbo::Setup::ShallowCopy sc = t2.shallow_copy();
+    EXPECT_EQ(sc.AddUnit(Literal::Eq(fn,m)), limbo::Setup::kOk);
+    EXPECT_TRUE(t2.Subsumes(Clause({Literal::Eq(fn,m)})));
+  }
+  EXPECT_FALSE(t2.Subsumes(Clause({Literal::Eq(fn,m)})));
+}
+
 }  // namespace limbo
 
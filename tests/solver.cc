@@ -99,6 +99,103 @@ TEST(SolverTest, Entails) {
   }
 }
 
+TEST(SolverTest, EntailsAll) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  auto Bool = ctx.CreateNonrigidSort();        RegisterSort(Bool, "");
+  auto True = ctx.CreateName(Bool);            REGISTER_SYMBOL(True);
+  auto Human = ctx.CreateNonrigidSort();       RegisterSort(Human, "");
+  auto Sonny = ctx.CreateName(Human);          REGISTER_SYMBOL(Sonny);
+  auto Mary = ctx.CreateName(Human);           REGISTER_SYMBOL(Mary);
+  auto Fred = ctx.CreateName(Human);           REGISTER_SYMBOL(Fred);
+  auto Father = ctx.CreateFunction(Human, 1);       REGISTER_SYMBOL(Father);
+  auto IsParentOf = ctx.CreateFunction(Bool, 2);    REGISTER_SYMBOL(IsParentOf);
+  auto x = ctx.CreateVariable(Human);               REGISTER_SYMBOL(x);
+  auto y = ctx.CreateVariable(Human);               REGISTER_SYMBOL(y);
+  solver.grounder().AddClause(( Father(x) != y || x == y || IsParentOf(y,x) == True ).as_clause());
+  solver.grounder().AddClause(( Father(Sonny) == Mary || Father(Sonny) == Fred ).as_clause());
+  auto phi = Ex(x, Ex(y, IsParentOf(y,x) == True))->NF(ctx.sf(), ctx.tf());
+  auto psi = (Father(Sonny) == Mary || Father(Sonny) == Fred)->NF(ctx.sf(), ctx.tf());
+  auto xi = (IsParentOf(Mary,Sonny) != True)->NF(ctx.sf(), ctx.tf());
+  const Formula* queries[] = {phi.get(), psi.get(), xi.get()};
+
+  // The batched answers agree with the individual ones.
+  {
+    const std::vector<bool> entailed = solver.EntailsAll(0, queries, queries + 3);
+    ASSERT_EQ(entailed.size(), 3u);
+    EXPECT_FALSE(entailed[0]);
+    EXPECT_TRUE(entailed[1]);
+    EXPECT_FALSE(entailed[2]);
+    EXPECT_EQ(entailed[0], solver.Entails(0, *phi));
+    EXPECT_EQ(entailed[1], solver.Entails(0, *psi));
+    EXPECT_EQ(entailed[2], solver.Entails(0, *xi));
+  }
+  {
+    const std::vector<bool> entailed = solver.EntailsAll(1, queries, queries + 3);
+    ASSERT_EQ(entailed.size(), 3u);
+    EXPECT_TRUE(entailed[0]);
+    EXPECT_TRUE(entailed[1]);
+    EXPECT_FALSE(entailed[2]);
+    EXPECT_EQ(entailed[0], solver.Entails(1, *phi));
+    EXPECT_EQ(entailed[1], solver.Entails(1, *psi));
+    EXPECT_EQ(entailed[2], solver.Entails(1, *xi));
+  }
+
+  // The query plies are popped again, so further queries are unaffected.
+  EXPECT_FALSE(solver.Entails(0, *phi, Solver::kConsistencyGuarantee));
+  EXPECT_TRUE(solver.Entails(1, *phi, Solver::kConsistencyGuarantee));
+}
+
+TEST(SolverTest, EntailsWithin) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  auto Bool = ctx.CreateNonrigidSort();        RegisterSort(Bool, "");
+  auto True = ctx.CreateName(Bool);            REGISTER_SYMBOL(True);
+  auto Human = ctx.CreateNonrigidSort();       RegisterSort(Human, "");
+  auto Sonny = ctx.CreateName(Human);          REGISTER_SYMBOL(Sonny);
+  auto Mary = ctx.CreateName(Human);           REGISTER_SYMBOL(Mary);
+  auto Fred = ctx.CreateName(Human);           REGISTER_SYMBOL(Fred);
+  auto Father = ctx.CreateFunction(Human, 1);       REGISTER_SYMBOL(Father);
+  auto IsParentOf = ctx.CreateFunction(Bool, 2);    REGISTER_SYMBOL(IsParentOf);
+  auto x = ctx.CreateVariable(Human);               REGISTER_SYMBOL(x);
+  auto y = ctx.CreateVariable(Human);               REGISTER_SYMBOL(y);
+  solver.grounder().AddClause(( Father(x) != y || x == y || IsParentOf(y,x) == True ).as_clause());
+  solver.grounder().AddClause(( Father(Sonny) == Mary || Father(Sonny) == Fred ).as_clause());
+  auto phi = Ex(x, Ex(y, IsParentOf(y,x) == True))->NF(ctx.sf(), ctx.tf());
+  auto psi = (Father(Sonny) == Mary || Father(Sonny) == Fred)->NF(ctx.sf(), ctx.tf());
+
+  // With a generous deadline, the deepening stops at the first entailed level.
+  {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    const Solver::AnytimeResult r = solver.EntailsWithin(deadline, 3, *phi);
+    EXPECT_TRUE(r.entailed);
+    EXPECT_EQ(r.k, 1u);
+  }
+  {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    const Solver::AnytimeResult r = solver.EntailsWithin(deadline, 3, *psi);
+    EXPECT_TRUE(r.entailed);
+    EXPECT_EQ(r.k, 0u);
+  }
+
+  // With an expired deadline, only level 0 is completed.
+  {
+    const auto deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+    const Solver::AnytimeResult r = solver.EntailsWithin(deadline, 3, *phi);
+    EXPECT_FALSE(r.entailed);
+    EXPECT_EQ(r.k, 0u);
+  }
+  {
+    const auto deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+    const Solver::AnytimeResult r = solver.EntailsWithin(deadline, 3, *psi);
+    EXPECT_TRUE(r.entailed);
+    EXPECT_EQ(r.k, 0u);
+  }
+
+  // Deadlines do not leak into subsequent queries.
+  EXPECT_TRUE(solver.Entails(1, *phi));
+}
+
 TEST(SolverTest, Consistent) {
   {
     Context ctx;
@@ -126,6 +223,38 @@ TEST(SolverTest, Consistent) {
   }
 }
 
+TEST(SolverTest, ConsistentComponents) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto Food = ctx.CreateNonrigidSort();           RegisterSort(Food, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Italian = ctx.CreateFunction(Bool, 0)();   REGISTER_SYMBOL(Italian);
+  auto Eats = ctx.CreateFunction(Bool, 1);        REGISTER_SYMBOL(Eats);
+  auto Meat = ctx.CreateFunction(Bool, 1);        REGISTER_SYMBOL(Meat);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  auto Sunny = ctx.CreateFunction(Bool, 0)();     REGISTER_SYMBOL(Sunny);
+  auto Rainy = ctx.CreateFunction(Bool, 0)();     REGISTER_SYMBOL(Rainy);
+  auto roo = ctx.CreateName(Food);                REGISTER_SYMBOL(roo);
+  auto x = ctx.CreateVariable(Food);              REGISTER_SYMBOL(x);
+  // The ECAI2016 theory plus a second, disconnected component {Sunny, Rainy}.
+  // The verdicts must match ECAI2016Complete's even though the consistency
+  // check now solves the components independently.
+  solver.grounder().AddClause(( Meat(roo) == T ).as_clause());
+  solver.grounder().AddClause(( Meat(x) != T || Eats(x) != T || Veggie != T ).as_clause());
+  solver.grounder().AddClause(( Aussie != T || Italian != T ).as_clause());
+  solver.grounder().AddClause(( Aussie == T || Italian == T ).as_clause());
+  solver.grounder().AddClause(( Aussie != T || Eats(roo) == T ).as_clause());
+  solver.grounder().AddClause(( Italian == T || Veggie == T ).as_clause());
+  solver.grounder().AddClause(( Sunny == T || Rainy == T ).as_clause());
+  solver.grounder().AddClause(( Sunny != T || Rainy != T ).as_clause());
+  EXPECT_FALSE(solver.Consistent(0, *(Italian == T)->NF(ctx.sf(), ctx.tf()), Solver::kConsistencyGuarantee));
+  EXPECT_TRUE(solver.Consistent(1, *(Italian == T)->NF(ctx.sf(), ctx.tf()), Solver::kConsistencyGuarantee));
+  EXPECT_TRUE(solver.Consistent(1, *(Sunny == T)->NF(ctx.sf(), ctx.tf()), Solver::kConsistencyGuarantee));
+  EXPECT_TRUE(solver.Consistent(1, *(Rainy == T)->NF(ctx.sf(), ctx.tf()), Solver::kConsistencyGuarantee));
+}
+
 TEST(SolverTest, KR2016) {
   Context ctx;
   Solver& solver = *ctx.solver();
@@ -226,6 +355,70 @@ TEST(SolverTest, Bool) {
   }
 }
 
+TEST(SolverTest, EntailsParallel) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  solver.set_n_threads(4);
+  EXPECT_EQ(solver.n_threads(), 4u);
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto Food = ctx.CreateNonrigidSort();           RegisterSort(Food, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Italian = ctx.CreateFunction(Bool, 0)();   REGISTER_SYMBOL(Italian);
+  auto Eats = ctx.CreateFunction(Bool, 1);        REGISTER_SYMBOL(Eats);
+  auto Meat = ctx.CreateFunction(Bool, 1);        REGISTER_SYMBOL(Meat);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  auto roo = ctx.CreateName(Food);                REGISTER_SYMBOL(roo);
+  auto x = ctx.CreateVariable(Food);              REGISTER_SYMBOL(x);
+  solver.grounder().AddClause(( Meat(roo) == T ).as_clause());
+  solver.grounder().AddClause(( Meat(x) != T ||  Eats(x) != T ||  Veggie != T ).as_clause());
+  solver.grounder().AddClause(( Aussie != T ||  Italian != T ).as_clause());
+  solver.grounder().AddClause(( Aussie == T ||  Italian == T ).as_clause());
+  solver.grounder().AddClause(( Aussie != T ||  Eats(roo) == T ).as_clause());
+  solver.grounder().AddClause(( Italian == T ||  Veggie == T ).as_clause());
+  // Same queries as in ECAI2016Sound; the answers must not depend on the
+  // number of threads.
+  EXPECT_FALSE(solver.Entails(0, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kConsistencyGuarantee));
+  EXPECT_FALSE(solver.Entails(0, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kNoConsistencyGuarantee));
+  EXPECT_TRUE(solver.Entails(1, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kConsistencyGuarantee));
+  EXPECT_TRUE(solver.Entails(1, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kNoConsistencyGuarantee));
+  EXPECT_TRUE(solver.Entails(2, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kNoConsistencyGuarantee));
+  solver.set_n_threads(1);
+  EXPECT_TRUE(solver.Entails(1, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kNoConsistencyGuarantee));
+}
+
+TEST(SolverTest, EntailsDistributed) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  solver.set_n_processes(2);
+  EXPECT_EQ(solver.n_processes(), 2u);
+  auto Bool = ctx.CreateNonrigidSort();           RegisterSort(Bool, "");
+  auto Food = ctx.CreateNonrigidSort();           RegisterSort(Food, "");
+  auto T = ctx.CreateName(Bool);                  REGISTER_SYMBOL(T);
+  auto Aussie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Aussie);
+  auto Italian = ctx.CreateFunction(Bool, 0)();   REGISTER_SYMBOL(Italian);
+  auto Eats = ctx.CreateFunction(Bool, 1);        REGISTER_SYMBOL(Eats);
+  auto Meat = ctx.CreateFunction(Bool, 1);        REGISTER_SYMBOL(Meat);
+  auto Veggie = ctx.CreateFunction(Bool, 0)();    REGISTER_SYMBOL(Veggie);
+  auto roo = ctx.CreateName(Food);                REGISTER_SYMBOL(roo);
+  auto x = ctx.CreateVariable(Food);              REGISTER_SYMBOL(x);
+  solver.grounder().AddClause(( Meat(roo) == T ).as_clause());
+  solver.grounder().AddClause(( Meat(x) != T ||  Eats(x) != T ||  Veggie != T ).as_clause());
+  solver.grounder().AddClause(( Aussie != T ||  Italian != T ).as_clause());
+  solver.grounder().AddClause(( Aussie == T ||  Italian == T ).as_clause());
+  solver.grounder().AddClause(( Aussie != T ||  Eats(roo) == T ).as_clause());
+  solver.grounder().AddClause(( Italian == T ||  Veggie == T ).as_clause());
+  // Same queries as in EntailsParallel; the answers must not depend on the
+  // number of worker processes.
+  EXPECT_FALSE(solver.Entails(0, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kConsistencyGuarantee));
+  EXPECT_FALSE(solver.Entails(0, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kNoConsistencyGuarantee));
+  EXPECT_TRUE(solver.Entails(1, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kConsistencyGuarantee));
+  EXPECT_TRUE(solver.Entails(1, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kNoConsistencyGuarantee));
+  EXPECT_TRUE(solver.Entails(2, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kNoConsistencyGuarantee));
+  solver.set_n_processes(1);
+  EXPECT_TRUE(solver.Entails(1, *(Aussie != T)->NF(ctx.sf(), ctx.tf()), Solver::kNoConsistencyGuarantee));
+}
+
 TEST(SolverTest, Constants) {
   UnregisterAll();
   Context ctx;
@@ -0,0 +1,76 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+
+// The counters are compiled out by default; since limbo is header-only, this
+// translation unit can switch them on for itself.
+#define LIMBO_STATS
+
+#include <gtest/gtest.h>
+
+#include <limbo/solver.h>
+#include <limbo/format/output.h>
+#include <limbo/format/cpp/syntax.h>
+
+namespace limbo {
+
+using namespace limbo::format;
+using namespace limbo::format::cpp;
+
+#define REGISTER_SYMBOL(x)    RegisterSymbol(x, #x)
+
+inline void RegisterSymbol(Term t, const std::string& n) {
+  RegisterSymbol(t.symbol(), n);
+}
+
+TEST(StatsTest, Entails) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  auto Bool = ctx.CreateNonrigidSort();             RegisterSort(Bool, "");
+  auto True = ctx.CreateName(Bool);                 REGISTER_SYMBOL(True);
+  auto Human = ctx.CreateNonrigidSort();            RegisterSort(Human, "");
+  auto Sonny = ctx.CreateName(Human);               REGISTER_SYMBOL(Sonny);
+  auto f = ctx.CreateFunction(Human, 0);            REGISTER_SYMBOL(f);
+  auto g = ctx.CreateFunction(Bool, 0);             REGISTER_SYMBOL(g);
+  solver.grounder().AddClause(( f() != Sonny || g() == True ).as_clause());
+  solver.grounder().AddClause(( f() == Sonny || g() == True ).as_clause());
+  auto phi = (g() == True)->NF(ctx.sf(), ctx.tf());
+  auto xi = (f() == Sonny || g() == True)->NF(ctx.sf(), ctx.tf());
+
+  // At level 0 the non-unit query is answered by subsumption without splits.
+  EXPECT_TRUE(solver.Entails(0, *xi));
+  const internal::Stats& stats = solver.stats();
+  EXPECT_EQ(stats.splits[1], 0u);
+  EXPECT_GT(stats.subsumption_tests, 0u);
+
+  // At level 0 the unit query fails and no splits are tried.
+  EXPECT_FALSE(solver.Entails(0, *phi));
+  EXPECT_EQ(stats.splits[1], 0u);
+
+  // At level 1 the query succeeds by splitting f.
+  EXPECT_TRUE(solver.Entails(1, *phi));
+  EXPECT_GT(stats.splits[1], 0u);
+  EXPECT_EQ(stats.splits[2], 0u);
+  EXPECT_GT(stats.unit_propagations, 0u);
+}
+
+TEST(StatsTest, ResetPerQuery) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  auto Bool = ctx.CreateNonrigidSort();             RegisterSort(Bool, "");
+  auto True = ctx.CreateName(Bool);                 REGISTER_SYMBOL(True);
+  auto Human = ctx.CreateNonrigidSort();            RegisterSort(Human, "");
+  auto Sonny = ctx.CreateName(Human);               REGISTER_SYMBOL(Sonny);
+  auto f = ctx.CreateFunction(Human, 0);            REGISTER_SYMBOL(f);
+  auto g = ctx.CreateFunction(Bool, 0);             REGISTER_SYMBOL(g);
+  solver.grounder().AddClause(( f() != Sonny || g() == True ).as_clause());
+  solver.grounder().AddClause(( f() == Sonny || g() == True ).as_clause());
+  auto phi = (g() == True)->NF(ctx.sf(), ctx.tf());
+
+  EXPECT_TRUE(solver.Entails(1, *phi));
+  EXPECT_GT(solver.stats().splits[1], 0u);
+  EXPECT_FALSE(solver.Entails(0, *phi));
+  EXPECT_EQ(solver.stats().splits[1], 0u);
+}
+
+}  // namespace limbo
+
@@ -129,6 +129,42 @@ TEST(TermTest, Unify) {
   { auto u = Term::Unify<Term::kUnifyTwoWay | Term::kOccursCheck>(fxy, fgyx); EXPECT_FALSE(bool(u)); }
 }
 
+TEST(TermTest, Backtrack) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s = sf.CreateNonrigidSort();
+
+  const Term n1 = tf.CreateTerm(sf.CreateName(s));
+  const Term x = tf.CreateTerm(sf.CreateVariable(s));
+  const Symbol f = sf.CreateFunction(s, 1);
+  const Term fx = tf.CreateTerm(f, {x});
+
+  const Term::Factory::Mark mark = tf.mark();
+  EXPECT_TRUE(mark.covers(n1) && mark.covers(x) && mark.covers(fx));
+
+  const Term n2 = tf.CreateTerm(sf.CreateName(s));
+  const Term fn2 = tf.Substitute(fx, x, n2);
+  EXPECT_FALSE(mark.covers(n2));
+  EXPECT_FALSE(mark.covers(fn2));
+  EXPECT_EQ(fn2.arg(0), n2);
+
+  tf.Backtrack(mark);
+
+  // The released indices are handed out again, so the id spaces stay dense:
+  // a name interned now takes n2's place. The substitution memo was purged,
+  // so the substitution with the recycled id yields the new term, not fn2.
+  const Term n3 = tf.CreateTerm(sf.CreateName(s));
+  EXPECT_EQ(n3.index(), n2.index());
+  const Term fn3 = tf.Substitute(fx, x, n3);
+  EXPECT_EQ(fn3.symbol(), f);
+  EXPECT_EQ(fn3.arg(0), n3);
+
+  // Terms interned before the mark survive with their ids and their Data.
+  EXPECT_EQ(tf.CreateTerm(f, {x}), fx);
+  EXPECT_EQ(n1.sort(), s);
+  EXPECT_EQ(fx.arg(0), x);
+}
+
 TEST(TermTest, Isomorphic) {
   Symbol::Factory& sf = *Symbol::Factory::Instance();
   Term::Factory& tf = *Term::Factory::Instance();
@@ -0,0 +1,66 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+
+// The timers are compiled out by default; since limbo is header-only, this
+// translation unit can switch them on for itself.
+#define LIMBO_TIMERS
+
+#include <gtest/gtest.h>
+
+#include <limbo/solver.h>
+#include <limbo/format/output.h>
+#include <limbo/format/cpp/syntax.h>
+
+namespace limbo {
+
+using namespace limbo::format;
+using namespace limbo::format::cpp;
+
+#define REGISTER_SYMBOL(x)    RegisterSymbol(x, #x)
+
+inline void RegisterSymbol(Term t, const std::string& n) {
+  RegisterSymbol(t.symbol(), n);
+}
+
+TEST(TimersTest, Entails) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  auto Bool = ctx.CreateNonrigidSort();             RegisterSort(Bool, "");
+  auto True = ctx.CreateName(Bool);                 REGISTER_SYMBOL(True);
+  auto Human = ctx.CreateNonrigidSort();            RegisterSort(Human, "");
+  auto Sonny = ctx.CreateName(Human);               REGISTER_SYMBOL(Sonny);
+  auto f = ctx.CreateFunction(Human, 0);            REGISTER_SYMBOL(f);
+  auto g = ctx.CreateFunction(Bool, 0);             REGISTER_SYMBOL(g);
+  solver.grounder().AddClause(( f() != Sonny || g() == True ).as_clause());
+  solver.grounder().AddClause(( f() == Sonny || g() == True ).as_clause());
+  auto phi = (g() == True)->NF(ctx.sf(), ctx.tf());
+
+  // At level 1 the query splits f, so every phase is entered.
+  EXPECT_TRUE(solver.Entails(1, *phi));
+  const internal::Timers& timers = solver.timers();
+  EXPECT_GT(timers.ticks(internal::Timers::kGround), 0u);
+  EXPECT_GT(timers.ticks(internal::Timers::kPropagate), 0u);
+  EXPECT_GT(timers.ticks(internal::Timers::kSubsume), 0u);
+  EXPECT_GT(timers.ticks(internal::Timers::kSplit), 0u);
+}
+
+TEST(TimersTest, ResetPerQuery) {
+  Context ctx;
+  Solver& solver = *ctx.solver();
+  auto Bool = ctx.CreateNonrigidSort();             RegisterSort(Bool, "");
+  auto True = ctx.CreateName(Bool);                 REGISTER_SYMBOL(True);
+  auto Human = ctx.CreateNonrigidSort();            RegisterSort(Human, "");
+  auto Sonny = ctx.CreateName(Human);               REGISTER_SYMBOL(Sonny);
+  auto f = ctx.CreateFunction(Human, 0);            REGISTER_SYMBOL(f);
+  auto g = ctx.CreateFunction(Bool, 0);             REGISTER_SYMBOL(g);
+  solver.grounder().AddClause(( f() != Sonny || g() == True ).as_clause());
+  solver.grounder().AddClause(( f() == Sonny || g() == True ).as_clause());
+  auto phi = (g() == True)->NF(ctx.sf(), ctx.tf());
+
+  EXPECT_TRUE(solver.Entails(1, *phi));
+  EXPECT_GT(solver.timers().ticks(internal::Timers::kSplit), 0u);
+  EXPECT_FALSE(solver.Entails(0, *phi));
+  EXPECT_EQ(solver.timers().ticks(internal::Timers::kSplit), 0u);
+}
+
+}  // namespace limbo